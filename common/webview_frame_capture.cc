@@ -0,0 +1,174 @@
+#include "webview_frame_capture.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace webview_cef
+{
+	// Larger output sizes are rejected rather than allocated.
+	static const int kMaxCaptureSize = 16384;
+
+	WebviewFrameCapture::~WebviewFrameCapture()
+	{
+		std::unordered_map<int, std::vector<Request>> pending;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+			pending.swap(pending_);
+		}
+		for (const auto &browser : pending)
+		{
+			for (const Request &request : browser.second)
+			{
+				request.done(std::vector<uint8_t>());
+			}
+		}
+		wake_.notify_one();
+		if (thread_.joinable())
+		{
+			thread_.join();
+		}
+	}
+
+	void WebviewFrameCapture::request(int browserId, Request request)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_[browserId].push_back(std::move(request));
+	}
+
+	void WebviewFrameCapture::onFrame(int browserId, const WebviewFrame &frame)
+	{
+		std::vector<Request> requests;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = pending_.find(browserId);
+			if (it == pending_.end())
+			{
+				return;
+			}
+			requests = std::move(it->second);
+			pending_.erase(it);
+		}
+		capture(frame, std::move(requests));
+	}
+
+	void WebviewFrameCapture::cancel(int browserId)
+	{
+		std::vector<Request> requests;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = pending_.find(browserId);
+			if (it == pending_.end())
+			{
+				return;
+			}
+			requests = std::move(it->second);
+			pending_.erase(it);
+		}
+		for (const Request &request : requests)
+		{
+			request.done(std::vector<uint8_t>());
+		}
+	}
+
+	void WebviewFrameCapture::capture(const WebviewFrame &frame, std::vector<Request> requests)
+	{
+		const CefRect bounds(0, 0, frame.width, frame.height);
+		CefRect copied;
+		std::vector<Request> valid;
+		for (Request &request : requests)
+		{
+			request.region = request.region.IsEmpty() ? bounds : IntersectRect(request.region, bounds);
+			if (frame.buffer == nullptr || request.region.IsEmpty())
+			{
+				request.done(std::vector<uint8_t>());
+				continue;
+			}
+			copied = UnionRect(copied, request.region);
+			valid.push_back(std::move(request));
+		}
+		if (valid.empty())
+		{
+			return;
+		}
+
+		// One copy of the area covered by all requests; regions become
+		// relative to it.
+		Job job;
+		job.stride = copied.width * 4;
+		job.pixels.resize((size_t)job.stride * copied.height);
+		for (int row = 0; row < copied.height; row++)
+		{
+			memcpy(job.pixels.data() + (size_t)row * job.stride,
+				   (const uint8_t *)frame.buffer + (size_t)(copied.y + row) * frame.stride + (size_t)copied.x * 4,
+				   job.stride);
+		}
+		for (Request &request : valid)
+		{
+			request.region.x -= copied.x;
+			request.region.y -= copied.y;
+		}
+		job.requests = std::move(valid);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!thread_.joinable())
+			{
+				thread_ = std::thread(&WebviewFrameCapture::workerLoop, this);
+			}
+			queue_.push_back(std::move(job));
+		}
+		wake_.notify_one();
+	}
+
+	void WebviewFrameCapture::workerLoop()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [this]
+						   { return stopping_ || !queue_.empty(); });
+				if (queue_.empty())
+				{
+					break;
+				}
+				job = std::move(queue_.front());
+				queue_.pop_front();
+			}
+
+			for (const Request &request : job.requests)
+			{
+				const CefRect &region = request.region;
+				int width = request.width;
+				int height = request.height;
+				if (width <= 0 && height <= 0)
+				{
+					width = region.width;
+					height = region.height;
+				}
+				else if (width <= 0)
+				{
+					width = std::max(1, (int)((int64_t)region.width * height / region.height));
+				}
+				else if (height <= 0)
+				{
+					height = std::max(1, (int)((int64_t)region.height * width / region.width));
+				}
+				if (width > kMaxCaptureSize || height > kMaxCaptureSize)
+				{
+					request.done(std::vector<uint8_t>());
+					continue;
+				}
+				WebviewImage image = scaleBgraRegion(job.pixels.data(), job.stride, {region.x, region.y, region.width, region.height}, width, height);
+				if (request.consume)
+				{
+					request.consume(image);
+					continue;
+				}
+				request.done(request.format == kFormatQoi ? encodeQoi(image) : encodePng(image));
+			}
+		}
+	}
+}
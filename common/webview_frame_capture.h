@@ -0,0 +1,74 @@
+#ifndef WEBVIEW_FRAME_CAPTURE_H
+#define WEBVIEW_FRAME_CAPTURE_H
+
+#include "webview_image.h"
+#include "webview_plugin.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace webview_cef {
+    // Encodes snapshots of painted frames on a background thread. Requests
+    // wait for their browser's next paint; onFrame() then only copies the
+    // requested pixels, and the scaling and encoding happen on the capture
+    // thread, which also calls each request's |done|.
+    class WebviewFrameCapture {
+    public:
+        enum Format {
+            kFormatPng,
+            kFormatQoi,
+        };
+
+        struct Request {
+            // Part of the frame to capture; empty means the whole frame.
+            CefRect region;
+            // Output size. 0 for both keeps the region size; 0 for one of
+            // them keeps the aspect ratio.
+            int width = 0;
+            int height = 0;
+            Format format = kFormatPng;
+            // Receives the encoded image, or an empty vector on failure.
+            std::function<void(const std::vector<uint8_t>&)> done;
+            // When set, receives the scaled image instead of it being
+            // encoded, and |done| is only called on failure.
+            std::function<void(const WebviewImage&)> consume;
+        };
+
+        WebviewFrameCapture() {}
+        // Finishes the queued captures.
+        ~WebviewFrameCapture();
+
+        // Queues |request| for the next paint of |browserId|. Safe to call
+        // from any thread.
+        void request(int browserId, Request request);
+        // Paint callback: captures the pending requests of |browserId|.
+        void onFrame(int browserId, const WebviewFrame& frame);
+        // Fails the pending requests of a closed browser.
+        void cancel(int browserId);
+
+    private:
+        struct Job {
+            std::vector<uint8_t> pixels;
+            int stride = 0;
+            std::vector<Request> requests;
+        };
+
+        void capture(const WebviewFrame& frame, std::vector<Request> requests);
+        void workerLoop();
+
+        std::thread thread_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::deque<Job> queue_;
+        std::unordered_map<int, std::vector<Request>> pending_;
+        bool stopping_ = false;
+    };
+}
+
+#endif //WEBVIEW_FRAME_CAPTURE_H
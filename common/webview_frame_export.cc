@@ -0,0 +1,170 @@
+#include "webview_frame_export.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace webview_cef
+{
+	static size_t pixelsOffset()
+	{
+		// Keep pixel rows cache-line aligned for readers that use SIMD.
+		return (sizeof(WebviewExportHeader) + 63) & ~(size_t)63;
+	}
+
+	std::string WebviewFrameExporter::defaultName(int browserId)
+	{
+#ifdef _WIN32
+		return std::string();
+#else
+		return "/webview_cef." + std::to_string(getpid()) + "." + std::to_string(browserId);
+#endif
+	}
+
+	int WebviewFrameExporter::processId()
+	{
+#ifdef _WIN32
+		return 0;
+#else
+		return (int)getpid();
+#endif
+	}
+
+	WebviewFrameExporter::~WebviewFrameExporter()
+	{
+#ifndef _WIN32
+		if (header_ != nullptr)
+		{
+			munmap(header_, mappedSize_);
+		}
+		if (fd_ >= 0)
+		{
+			close(fd_);
+			shm_unlink(name_.c_str());
+		}
+#endif
+	}
+
+	bool WebviewFrameExporter::open(const std::string &name)
+	{
+#ifdef _WIN32
+		std::cerr << "Frame export is not supported on Windows" << std::endl;
+		return false;
+#else
+		fd_ = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd_ < 0)
+		{
+			std::cerr << "Frame export: shm_open(" << name << ") failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+		name_ = name;
+		return resize(0);
+#endif
+	}
+
+	bool WebviewFrameExporter::resize(size_t slotCapacity)
+	{
+#ifdef _WIN32
+		return false;
+#else
+		const size_t size = pixelsOffset() + slotCapacity * kFrameExportSlots;
+		if (ftruncate(fd_, (off_t)size) != 0)
+		{
+			std::cerr << "Frame export: ftruncate failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+		void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (mapped == MAP_FAILED)
+		{
+			std::cerr << "Frame export: mmap failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+		if (header_ != nullptr)
+		{
+			munmap(header_, mappedSize_);
+		}
+		header_ = (WebviewExportHeader *)mapped;
+		mappedSize_ = size;
+		slotCapacity_ = slotCapacity;
+
+		if (header_->magic != kFrameExportMagic)
+		{
+			// A fresh segment is zero filled.
+			header_->magic = kFrameExportMagic;
+			header_->version = kFrameExportVersion;
+			header_->slotCount = kFrameExportSlots;
+		}
+		for (int i = 0; i < kFrameExportSlots; i++)
+		{
+			header_->slots[i].offset = pixelsOffset() + slotCapacity * i;
+		}
+		header_->segmentSize.store(size, std::memory_order_release);
+		return true;
+#endif
+	}
+
+	void WebviewFrameExporter::publish(const WebviewFrame &frame)
+	{
+		if (header_ == nullptr || frame.buffer == nullptr || frame.width <= 0 || frame.height <= 0)
+		{
+			return;
+		}
+		const size_t bytes = (size_t)frame.stride * frame.height;
+		bool full = false;
+		if (bytes > slotCapacity_)
+		{
+			// Grow with headroom so a window being dragged larger does not
+			// remap on every frame. Slot offsets move, so every slot is stale.
+			if (!resize(bytes + bytes / 4))
+			{
+				return;
+			}
+			full = true;
+		}
+
+		const uint64_t sequence = ++sequence_;
+		const int index = (int)(sequence % kFrameExportSlots);
+		WebviewExportSlot &slot = header_->slots[index];
+		slot.lock.store(sequence * 2 - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy((uint8_t *)header_ + slot.offset, frame.buffer, bytes);
+		slot.sequence = sequence;
+		slot.timestampMicros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+								   std::chrono::steady_clock::now().time_since_epoch())
+								   .count();
+		slot.width = frame.width;
+		slot.height = frame.height;
+		slot.stride = frame.stride;
+		slot.damageCount = 0;
+		if (!full && frame.dirtyRects.size() <= (size_t)kFrameExportMaxDamage)
+		{
+			for (const CefRect &rect : frame.dirtyRects)
+			{
+				int32_t *damage = slot.damage[slot.damageCount++];
+				damage[0] = rect.x;
+				damage[1] = rect.y;
+				damage[2] = rect.width;
+				damage[3] = rect.height;
+			}
+		}
+
+		slot.lock.store(sequence * 2, std::memory_order_release);
+		header_->latestSlot.store(index, std::memory_order_release);
+		header_->latestSequence.store(sequence, std::memory_order_release);
+		header_->notify.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+		syscall(SYS_futex, &header_->notify, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+#endif
+	}
+}
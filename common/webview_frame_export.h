@@ -0,0 +1,91 @@
+#ifndef WEBVIEW_FRAME_EXPORT_H
+#define WEBVIEW_FRAME_EXPORT_H
+
+#include "webview_plugin.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace webview_cef {
+    // Layout of an exported frame segment. Readers shm_open() the segment by
+    // name and map it read-only; pixels are CEF's premultiplied BGRA.
+    //
+    // To read the newest frame, take slots[latestSlot], load |lock|, and use
+    // the slot if the value is even. The pixels can be read in place. Then
+    // load |lock| again: if it changed, the writer reused the slot meanwhile
+    // and the frame must be dropped. Re-check |segmentSize| first: the
+    // segment grows (and must be remapped) when frames get larger.
+    const uint32_t kFrameExportMagic = 0x58465657; // "WVFX"
+    const uint32_t kFrameExportVersion = 1;
+    const int kFrameExportSlots = 3;
+    const int kFrameExportMaxDamage = 16;
+
+    struct WebviewExportSlot {
+        // Twice the frame's sequence number, odd while it is being written.
+        std::atomic<uint64_t> lock;
+        uint64_t sequence;
+        // Microseconds on the exporting process's steady clock.
+        uint64_t timestampMicros;
+        // Byte offset of the pixels from the start of the segment.
+        uint64_t offset;
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        // Rects (x, y, width, height) changed since frame |sequence| - 1. Zero
+        // rects means the whole frame.
+        uint32_t damageCount;
+        int32_t damage[kFrameExportMaxDamage][4];
+    };
+
+    struct WebviewExportHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t reserved;
+        std::atomic<uint64_t> segmentSize;
+        std::atomic<uint64_t> latestSequence;
+        std::atomic<uint32_t> latestSlot;
+        // Bumped after every frame. To wait for the next one, load |notify|,
+        // check |latestSequence|, then on Linux call
+        //   syscall(SYS_futex, &header->notify, FUTEX_WAIT, seen, timeout, 0, 0)
+        // without FUTEX_PRIVATE_FLAG: the writer wakes shared waiters, so
+        // this works across processes on the read-only mapping. Elsewhere
+        // poll |latestSequence|.
+        std::atomic<uint32_t> notify;
+        WebviewExportSlot slots[kFrameExportSlots];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+    // Publishes one browser's frames into a POSIX shared-memory ring so other
+    // local processes can read them without copies. Not available on Windows.
+    class WebviewFrameExporter {
+    public:
+        WebviewFrameExporter() {}
+        ~WebviewFrameExporter();
+
+        // Creates the segment as |name| (a shm_open name such as
+        // "/webview_cef.1234.1"). Returns false and logs on failure.
+        bool open(const std::string& name);
+        void publish(const WebviewFrame& frame);
+
+        // "/webview_cef.<pid>.<browserId>", or empty where export is unsupported.
+        static std::string defaultName(int browserId);
+        static int processId();
+
+        const std::string& name() const { return name_; }
+
+    private:
+        bool resize(size_t slotCapacity);
+
+        std::string name_;
+        int fd_ = -1;
+        WebviewExportHeader* header_ = nullptr;
+        size_t mappedSize_ = 0;
+        size_t slotCapacity_ = 0;
+        uint64_t sequence_ = 0;
+    };
+}
+
+#endif //WEBVIEW_FRAME_EXPORT_H
@@ -0,0 +1,676 @@
+#include "webview_frame_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace webview_cef
+{
+	static void copyRect(uint8_t *dest, const uint8_t *src, int stride, const CefRect &rect)
+	{
+		for (int row = rect.y; row < rect.y + rect.height; row++)
+		{
+			const size_t offset = (size_t)row * stride + (size_t)rect.x * 4;
+			memcpy(dest + offset, src + offset, (size_t)rect.width * 4);
+		}
+	}
+
+	// Appends the parts of |rect| outside |hole| (at most four) to |out|.
+	static void subtractRect(const CefRect &rect, const CefRect &hole, std::vector<CefRect> &out)
+	{
+		const CefRect overlap = IntersectRect(rect, hole);
+		if (overlap.IsEmpty())
+		{
+			out.push_back(rect);
+			return;
+		}
+		if (overlap.y > rect.y)
+		{
+			out.push_back(CefRect(rect.x, rect.y, rect.width, overlap.y - rect.y));
+		}
+		if (overlap.y + overlap.height < rect.y + rect.height)
+		{
+			out.push_back(CefRect(rect.x, overlap.y + overlap.height, rect.width,
+								  rect.y + rect.height - overlap.y - overlap.height));
+		}
+		if (overlap.x > rect.x)
+		{
+			out.push_back(CefRect(rect.x, overlap.y, overlap.x - rect.x, overlap.height));
+		}
+		if (overlap.x + overlap.width < rect.x + rect.width)
+		{
+			out.push_back(CefRect(overlap.x + overlap.width, overlap.y,
+								  rect.x + rect.width - overlap.x - overlap.width, overlap.height));
+		}
+	}
+
+	// Maps |area| (left, top, right, bottom as fractions) onto a width x
+	// height frame, rounding outwards so partly visible pixels are included.
+	static CefRect areaToPixels(const float area[4], int width, int height)
+	{
+		const int left = (int)std::floor(area[0] * width);
+		const int top = (int)std::floor(area[1] * height);
+		const int right = (int)std::ceil(area[2] * width);
+		const int bottom = (int)std::ceil(area[3] * height);
+		return IntersectRect(CefRect(left, top, right - left, bottom - top), CefRect(0, 0, width, height));
+	}
+
+	static inline uint64_t rotl64(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	// XXH64-style hash of the pixels in |tile|. The four lanes over 32-byte
+	// blocks do not depend on each other, so their multiplies can overlap in
+	// the pipeline; the loop stays scalar.
+	static uint64_t hashTile(const uint8_t *src, int stride, const CefRect &tile)
+	{
+		const uint64_t prime1 = 11400714785074694791ULL;
+		const uint64_t prime2 = 14029467366897019727ULL;
+		const uint64_t prime3 = 1609587929392839161ULL;
+		uint64_t lanes[4] = {prime1 + prime2, prime2, 0, 0 - prime1};
+		for (int row = tile.y; row < tile.y + tile.height; row++)
+		{
+			const uint8_t *p = src + (size_t)row * stride + (size_t)tile.x * 4;
+			size_t len = (size_t)tile.width * 4;
+			for (; len >= 32; p += 32, len -= 32)
+			{
+				for (int lane = 0; lane < 4; lane++)
+				{
+					uint64_t word;
+					memcpy(&word, p + lane * 8, 8);
+					lanes[lane] = rotl64(lanes[lane] + word * prime2, 31) * prime1;
+				}
+			}
+			for (; len >= 4; p += 4, len -= 4)
+			{
+				uint32_t pixel;
+				memcpy(&pixel, p, 4);
+				lanes[0] = rotl64(lanes[0] ^ (pixel * prime1), 23) * prime2 + prime3;
+			}
+		}
+		uint64_t hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+		hash ^= hash >> 33;
+		hash *= prime2;
+		hash ^= hash >> 29;
+		hash *= prime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	WebviewFramePool::WebviewFramePool()
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			fullyStale_[i] = true;
+		}
+	}
+
+	bool WebviewFramePool::produce(const WebviewFrame &frame)
+	{
+		if (frame.buffer == nullptr || frame.width <= 0 || frame.height <= 0)
+		{
+			return false;
+		}
+		produced_++;
+		const auto paintTime = std::chrono::steady_clock::now();
+
+		const bool hashing = skipIdenticalFrames_.load(std::memory_order_acquire);
+		if (hashing != producerHashing_)
+		{
+			// Hashes from before the flag was set may be out of date.
+			producerHashing_ = hashing;
+			hashedWidth_ = hashedHeight_ = 0;
+		}
+		WebviewFrame changed;
+		if (hashing)
+		{
+			changed.buffer = frame.buffer;
+			changed.width = frame.width;
+			changed.height = frame.height;
+			changed.stride = frame.stride;
+			changed.inputTime = frame.inputTime;
+			if (!filterUnchanged(frame, changed.dirtyRects))
+			{
+				suppressed_++;
+				return false;
+			}
+		}
+		return publish(hashing ? changed : frame, paintTime);
+	}
+
+	bool WebviewFramePool::publish(const WebviewFrame &frame, std::chrono::steady_clock::time_point paintTime)
+	{
+		const bool deferred = convertOnConsume_.load(std::memory_order_acquire);
+		if (deferred != producerDeferred_)
+		{
+			producerDeferred_ = deferred;
+			for (int i = 0; i < 3; i++)
+			{
+				fullyStale_[i] = true;
+				staleRects_[i].clear();
+			}
+			// Whichever path takes over has missed frames, so it restarts from a
+			// full conversion.
+			std::lock_guard<std::mutex> lock(stagingMutex_);
+			stagingWidth_ = stagingHeight_ = 0;
+			stagingCatchUp_.clear();
+			stagingCatchUpFull_ = false;
+			pendingRects_.clear();
+			pending_ = false;
+			pendingInputTime_ = std::chrono::steady_clock::time_point();
+		}
+		if (deferred)
+		{
+			stage(frame, paintTime);
+			return true;
+		}
+
+		Surface &surface = surfaces_[back_];
+		if (surface.width != frame.width || surface.height != frame.height)
+		{
+			surface.pixels.resize((size_t)frame.stride * frame.height);
+			surface.width = frame.width;
+			surface.height = frame.height;
+			surface.stride = frame.stride;
+			fullyStale_[back_] = true;
+		}
+
+		const CefRect bounds(0, 0, frame.width, frame.height);
+		const CefRect visible = visibleRect(frame.width, frame.height, coversBounds(frame.dirtyRects, bounds));
+		std::vector<CefRect> offscreen;
+		const auto conversionStart = std::chrono::steady_clock::now();
+		if (fullyStale_[back_] && visible == bounds)
+		{
+			SwapBufferFromBgraToRgba(surface.pixels.data(), frame.buffer, frame.width, frame.height);
+		}
+		else
+		{
+			// The back surface last saw an older frame, so it also needs every
+			// region repainted since then.
+			std::vector<CefRect> needed;
+			if (fullyStale_[back_])
+			{
+				needed.push_back(bounds);
+			}
+			else
+			{
+				needed = frame.dirtyRects;
+				needed.insert(needed.end(), staleRects_[back_].begin(), staleRects_[back_].end());
+			}
+			WebviewFrame damage = frame;
+			damage.dirtyRects.clear();
+			splitByVisible(needed, bounds, visible, damage.dirtyRects, offscreen);
+			if (damage.dirtyRects.empty())
+			{
+				// Nothing on screen changed: keep showing the current surface
+				// and leave the damage for when it scrolls into view.
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					if (!fullyStale_[i])
+					{
+						addStale(staleRects_[i], frame.dirtyRects);
+					}
+				}
+				std::lock_guard<std::mutex> lock(visibleMutex_);
+				if (latestWidth_ == frame.width && latestHeight_ == frame.height)
+				{
+					addStale(latestStale_, frame.dirtyRects);
+				}
+				else
+				{
+					latestStale_.assign(1, bounds);
+					latestWidth_ = frame.width;
+					latestHeight_ = frame.height;
+				}
+				offscreen_++;
+				return false;
+			}
+			SwapDirtyRectsFromBgraToRgba(surface.pixels.data(), damage);
+		}
+		conversionTime_.record(std::chrono::steady_clock::now() - conversionStart);
+		surface.paintTime = paintTime;
+		surface.inputTime = frame.inputTime;
+		markStale(back_, frame.dirtyRects);
+		addStale(staleRects_[back_], offscreen);
+		setLatestStale(staleRects_[back_], frame.width, frame.height);
+		converted_++;
+
+		uint32_t previous = middle_.exchange(back_ | kFreshBit, std::memory_order_acq_rel);
+		back_ = previous & kIndexMask;
+		if (previous & kFreshBit)
+		{
+			skipped_++;
+			// The frame that replaced it answers its input too.
+			const std::chrono::steady_clock::time_point inputTime = surfaces_[back_].inputTime;
+			if (inputTime != std::chrono::steady_clock::time_point())
+			{
+				int64_t expected = 0;
+				skippedInputTime_.compare_exchange_strong(expected, int64_t(inputTime.time_since_epoch().count()));
+			}
+		}
+		return true;
+	}
+
+	bool WebviewFramePool::filterUnchanged(const WebviewFrame &frame, std::vector<CefRect> &damage)
+	{
+		const int cols = (frame.width + kTileSize - 1) / kTileSize;
+		const int rows = (frame.height + kTileSize - 1) / kTileSize;
+		const bool resized = hashedWidth_ != frame.width || hashedHeight_ != frame.height;
+		if (resized)
+		{
+			tileHashes_.assign((size_t)cols * rows, 0);
+			hashedWidth_ = frame.width;
+			hashedHeight_ = frame.height;
+		}
+
+		// Only tiles under the damage are hashed; the rest cannot have changed.
+		std::vector<bool> touched(resized ? 0 : (size_t)cols * rows, false);
+		if (!resized)
+		{
+			const CefRect bounds(0, 0, frame.width, frame.height);
+			for (const CefRect &dirty : frame.dirtyRects)
+			{
+				CefRect rect = IntersectRect(dirty, bounds);
+				if (rect.IsEmpty())
+				{
+					continue;
+				}
+				for (int row = rect.y / kTileSize; row <= (rect.y + rect.height - 1) / kTileSize; row++)
+				{
+					for (int col = rect.x / kTileSize; col <= (rect.x + rect.width - 1) / kTileSize; col++)
+					{
+						touched[(size_t)row * cols + col] = true;
+					}
+				}
+			}
+		}
+
+		for (int row = 0; row < rows; row++)
+		{
+			// Adjacent changed tiles in a row are merged into one rect.
+			CefRect run;
+			for (int col = 0; col < cols; col++)
+			{
+				const size_t index = (size_t)row * cols + col;
+				bool changed = false;
+				if (resized || touched[index])
+				{
+					const CefRect tile(col * kTileSize, row * kTileSize,
+									   std::min(kTileSize, frame.width - col * kTileSize),
+									   std::min(kTileSize, frame.height - row * kTileSize));
+					const uint64_t hash = hashTile((const uint8_t *)frame.buffer, frame.stride, tile);
+					changed = resized || hash != tileHashes_[index];
+					tileHashes_[index] = hash;
+					if (changed)
+					{
+						run = UnionRect(run, tile);
+					}
+				}
+				if (!changed && !run.IsEmpty())
+				{
+					damage.push_back(run);
+					run = CefRect();
+				}
+			}
+			if (!run.IsEmpty())
+			{
+				damage.push_back(run);
+			}
+		}
+		return !damage.empty();
+	}
+
+	void WebviewFramePool::stage(const WebviewFrame &frame, std::chrono::steady_clock::time_point paintTime)
+	{
+		std::lock_guard<std::mutex> lock(stagingMutex_);
+		if (pending_)
+		{
+			skipped_++;
+		}
+		pending_ = true;
+		pendingPaintTime_ = paintTime;
+		if (pendingInputTime_ == std::chrono::steady_clock::time_point())
+		{
+			// Keep the oldest input until a consume presents it.
+			pendingInputTime_ = frame.inputTime;
+		}
+
+		if (stagingWidth_ != frame.width || stagingHeight_ != frame.height)
+		{
+			staging_.resize((size_t)frame.stride * frame.height);
+			memcpy(staging_.data(), frame.buffer, staging_.size());
+			stagingWidth_ = frame.width;
+			stagingHeight_ = frame.height;
+			stagingCatchUp_.clear();
+			stagingCatchUpFull_ = false;
+			pendingFull_ = true;
+			pendingRects_.clear();
+			return;
+		}
+
+		// The buffer consume() handed back lacks what was staged into the
+		// other one since the swap before.
+		if (stagingCatchUpFull_)
+		{
+			staging_.resize((size_t)frame.stride * frame.height);
+			memcpy(staging_.data(), frame.buffer, staging_.size());
+			stagingCatchUpFull_ = false;
+		}
+		else
+		{
+			for (const CefRect &rect : stagingCatchUp_)
+			{
+				copyRect(staging_.data(), (const uint8_t *)frame.buffer, frame.stride, rect);
+			}
+		}
+		stagingCatchUp_.clear();
+
+		const CefRect bounds(0, 0, frame.width, frame.height);
+		for (const CefRect &dirty : frame.dirtyRects)
+		{
+			CefRect rect = IntersectRect(dirty, bounds);
+			if (rect.IsEmpty())
+			{
+				continue;
+			}
+			copyRect(staging_.data(), (const uint8_t *)frame.buffer, frame.stride, rect);
+			if (!pendingFull_)
+			{
+				pendingRects_.push_back(rect);
+			}
+		}
+		if (pendingRects_.size() > kMaxStaleRects)
+		{
+			CefRect united;
+			for (const CefRect &rect : pendingRects_)
+			{
+				united = UnionRect(united, rect);
+			}
+			pendingRects_.assign(1, united);
+		}
+	}
+
+	const WebviewFramePool::Surface *WebviewFramePool::consume()
+	{
+		const bool deferred = convertOnConsume_.load(std::memory_order_acquire);
+		if (deferred != consumerDeferred_)
+		{
+			// A surface converted before the mode last changed is out of date.
+			consumerDeferred_ = deferred;
+			deferred_ = Surface();
+			deferredStale_.clear();
+		}
+		if (deferred)
+		{
+			bool fresh = false;
+			bool full = false;
+			int width = 0;
+			int height = 0;
+			std::vector<CefRect> pendingRects;
+			std::chrono::steady_clock::time_point paintTime;
+			std::chrono::steady_clock::time_point inputTime;
+			{
+				std::lock_guard<std::mutex> lock(stagingMutex_);
+				if (pending_)
+				{
+					fresh = true;
+					staging_.swap(converting_);
+					width = stagingWidth_;
+					height = stagingHeight_;
+					full = pendingFull_;
+					pendingRects.swap(pendingRects_);
+					if (full)
+					{
+						stagingCatchUpFull_ = true;
+					}
+					else
+					{
+						stagingCatchUp_ = pendingRects;
+					}
+					pendingFull_ = false;
+					pending_ = false;
+					paintTime = pendingPaintTime_;
+					inputTime = pendingInputTime_;
+					pendingInputTime_ = std::chrono::steady_clock::time_point();
+				}
+			}
+			if (fresh)
+			{
+				// A resize is painted whole, like a repaint.
+				const bool repainted = full || coversBounds(pendingRects, CefRect(0, 0, width, height));
+				const int stride = width * 4;
+				if (deferred_.width != width || deferred_.height != height)
+				{
+					deferred_.pixels.resize((size_t)stride * height);
+					deferred_.width = width;
+					deferred_.height = height;
+					deferred_.stride = stride;
+					full = true;
+				}
+				const CefRect bounds(0, 0, width, height);
+				const CefRect visible = visibleRect(width, height, repainted);
+				const auto conversionStart = std::chrono::steady_clock::now();
+				if (full && visible == bounds)
+				{
+					SwapBufferFromBgraToRgba(deferred_.pixels.data(), converting_.data(), width, height);
+					deferredStale_.clear();
+				}
+				else
+				{
+					// |converting_| mirrors the whole CEF frame, so regions left
+					// stale by earlier consumes can be converted now.
+					std::vector<CefRect> needed;
+					if (full)
+					{
+						needed.push_back(bounds);
+					}
+					else
+					{
+						needed = pendingRects;
+						needed.insert(needed.end(), deferredStale_.begin(), deferredStale_.end());
+					}
+					WebviewFrame damage;
+					damage.buffer = converting_.data();
+					damage.width = width;
+					damage.height = height;
+					damage.stride = stride;
+					std::vector<CefRect> offscreen;
+					splitByVisible(needed, bounds, visible, damage.dirtyRects, offscreen);
+					SwapDirtyRectsFromBgraToRgba(deferred_.pixels.data(), damage);
+					deferredStale_.clear();
+					addStale(deferredStale_, offscreen);
+				}
+				const auto now = std::chrono::steady_clock::now();
+				conversionTime_.record(now - conversionStart);
+				setLatestStale(deferredStale_, width, height);
+				converted_++;
+				deferred_.paintTime = paintTime;
+				deferred_.inputTime = inputTime;
+				presentLatency_.record(now - deferred_.paintTime);
+				if (deferred_.inputTime != std::chrono::steady_clock::time_point())
+				{
+					inputLatency_.record(now - deferred_.inputTime);
+				}
+				presented_++;
+			}
+			if (!deferred_.pixels.empty())
+			{
+				return &deferred_;
+			}
+		}
+
+		if (middle_.load(std::memory_order_acquire) & kFreshBit)
+		{
+			front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+			const auto now = std::chrono::steady_clock::now();
+			presentLatency_.record(now - surfaces_[front_].paintTime);
+			std::chrono::steady_clock::time_point inputTime = surfaces_[front_].inputTime;
+			const int64_t skippedInput = skippedInputTime_.exchange(0);
+			if (skippedInput != 0)
+			{
+				inputTime = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(skippedInput));
+			}
+			if (inputTime != std::chrono::steady_clock::time_point())
+			{
+				inputLatency_.record(now - inputTime);
+			}
+			presented_++;
+		}
+		const Surface &surface = surfaces_[front_];
+		if (surface.pixels.empty())
+		{
+			return nullptr;
+		}
+		return &surface;
+	}
+
+	void WebviewFramePool::markStale(uint32_t written, const std::vector<CefRect> &damage)
+	{
+		staleRects_[written].clear();
+		fullyStale_[written] = false;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			if (i == written || fullyStale_[i])
+			{
+				continue;
+			}
+			addStale(staleRects_[i], damage);
+		}
+	}
+
+	void WebviewFramePool::addStale(std::vector<CefRect> &stale, const std::vector<CefRect> &damage)
+	{
+		stale.insert(stale.end(), damage.begin(), damage.end());
+		if (stale.size() > kMaxStaleRects)
+		{
+			CefRect bounds;
+			for (const CefRect &rect : stale)
+			{
+				bounds = UnionRect(bounds, rect);
+			}
+			stale.assign(1, bounds);
+		}
+	}
+
+	CefRect WebviewFramePool::visibleRect(int width, int height, bool fullRepaint)
+	{
+		std::lock_guard<std::mutex> lock(visibleMutex_);
+		if (fillStale_)
+		{
+			fillStale_ = !fullRepaint;
+			return CefRect(0, 0, width, height);
+		}
+		return areaToPixels(visible_, width, height);
+	}
+
+	bool WebviewFramePool::coversBounds(const std::vector<CefRect> &rects, const CefRect &bounds)
+	{
+		for (const CefRect &rect : rects)
+		{
+			if (IntersectRect(rect, bounds) == bounds)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WebviewFramePool::splitByVisible(const std::vector<CefRect> &needed, const CefRect &bounds, const CefRect &visible,
+										  std::vector<CefRect> &inside, std::vector<CefRect> &outside)
+	{
+		for (const CefRect &dirty : needed)
+		{
+			const CefRect rect = IntersectRect(dirty, bounds);
+			if (rect.IsEmpty())
+			{
+				continue;
+			}
+			const CefRect shown = IntersectRect(rect, visible);
+			if (!shown.IsEmpty())
+			{
+				inside.push_back(shown);
+			}
+			subtractRect(rect, visible, outside);
+		}
+	}
+
+	void WebviewFramePool::setLatestStale(const std::vector<CefRect> &stale, int width, int height)
+	{
+		std::lock_guard<std::mutex> lock(visibleMutex_);
+		latestStale_ = stale;
+		latestWidth_ = width;
+		latestHeight_ = height;
+	}
+
+	bool WebviewFramePool::setVisibleArea(float left, float top, float right, float bottom)
+	{
+		std::lock_guard<std::mutex> lock(visibleMutex_);
+		visible_[0] = std::max(0.0f, left);
+		visible_[1] = std::max(0.0f, top);
+		visible_[2] = std::min(1.0f, right);
+		visible_[3] = std::min(1.0f, bottom);
+		if (fillStale_)
+		{
+			// The repaint asked for last time has not arrived yet.
+			return false;
+		}
+		const CefRect shown = areaToPixels(visible_, latestWidth_, latestHeight_);
+		for (const CefRect &stale : latestStale_)
+		{
+			if (!IntersectRect(stale, shown).IsEmpty())
+			{
+				fillStale_ = true;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WebviewFramePool::setConvertOnConsume(bool enabled)
+	{
+		convertOnConsume_.store(enabled, std::memory_order_release);
+	}
+
+	bool WebviewFramePool::convertOnConsume() const
+	{
+		return convertOnConsume_.load(std::memory_order_acquire);
+	}
+
+	void WebviewFramePool::setSkipIdenticalFrames(bool enabled)
+	{
+		skipIdenticalFrames_.store(enabled, std::memory_order_release);
+	}
+
+	bool WebviewFramePool::skipIdenticalFrames() const
+	{
+		return skipIdenticalFrames_.load(std::memory_order_acquire);
+	}
+
+	WebviewFramePool::Stats WebviewFramePool::stats() const
+	{
+		Stats stats;
+		stats.produced = produced_.load(std::memory_order_relaxed);
+		stats.converted = converted_.load(std::memory_order_relaxed);
+		stats.skipped = skipped_.load(std::memory_order_relaxed);
+		stats.suppressed = suppressed_.load(std::memory_order_relaxed);
+		stats.offscreen = offscreen_.load(std::memory_order_relaxed);
+		stats.presented = presented_.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	WebviewDurationHistogram::Snapshot WebviewFramePool::conversionTimes() const
+	{
+		return conversionTime_.snapshot();
+	}
+
+	WebviewDurationHistogram::Snapshot WebviewFramePool::presentLatencies() const
+	{
+		return presentLatency_.snapshot();
+	}
+
+	WebviewDurationHistogram::Snapshot WebviewFramePool::inputLatencies() const
+	{
+		return inputLatency_.snapshot();
+	}
+}
@@ -0,0 +1,187 @@
+#ifndef WEBVIEW_FRAME_POOL_H
+#define WEBVIEW_FRAME_POOL_H
+
+#include "webview_plugin.h"
+#include "webview_render_stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace webview_cef {
+    // Triple-buffered RGBA surfaces shared by one producer (the CEF paint
+    // callback) and one consumer (Flutter's texture pull on the raster thread).
+    // Surfaces are reused across frames and only reallocated when the frame
+    // size changes. The newest surface is handed over with an atomic exchange,
+    // so neither side holds a lock while converting or uploading pixels.
+    class WebviewFramePool {
+    public:
+        struct Surface {
+            std::vector<uint8_t> pixels;
+            int width = 0;
+            int height = 0;
+            int stride = 0;
+            // When the newest paint in the surface reached produce().
+            std::chrono::steady_clock::time_point paintTime;
+            // WebviewFrame::inputTime of that paint.
+            std::chrono::steady_clock::time_point inputTime;
+        };
+
+        struct Stats {
+            uint64_t produced = 0;
+            uint64_t converted = 0;
+            // Frames that were replaced by a newer one before the consumer
+            // pulled them.
+            uint64_t skipped = 0;
+            // Paints dropped because their damage matched the previous frame.
+            uint64_t suppressed = 0;
+            // Paints not converted because their damage was outside the
+            // visible area.
+            uint64_t offscreen = 0;
+            // Fresh surfaces handed to the consumer.
+            uint64_t presented = 0;
+        };
+
+        WebviewFramePool();
+
+        // Producer side. Converts the part of |frame| that is stale in the back
+        // surface and publishes it as the newest frame. In convert-on-consume
+        // mode it only copies the damaged BGRA pixels aside. Returns false when
+        // nothing was published, so the texture need not be marked dirty.
+        bool produce(const WebviewFrame& frame);
+
+        // Consumer side. Returns the newest published surface, or nullptr before
+        // the first frame. The pointer stays valid until the next consume().
+        const Surface* consume();
+
+        // Defers the swizzle to consume(), so frames CEF paints faster than
+        // Flutter pulls them are never converted. Safe to call from any thread.
+        void setConvertOnConsume(bool enabled);
+        bool convertOnConsume() const;
+
+        // Hashes the tiles under each paint's damage and drops the paint if
+        // none of them changed, or narrows the damage to the tiles that did.
+        // Safe to call from any thread.
+        void setSkipIdenticalFrames(bool enabled);
+        bool skipIdenticalFrames() const;
+
+        // Limits conversion to the part of the frame that is on screen, given
+        // as fractions of the frame size. Damage outside it is remembered
+        // and converted by the first paint that covers it while visible.
+        // Returns true if part of the new area is out of date, in which case
+        // the browser should be invalidated so it repaints. Conversions then
+        // cover the whole frame until that full repaint has been converted,
+        // so scrolling further needs no repaint of its own, and no other
+        // repaint is asked for meanwhile. Safe to call from any thread.
+        bool setVisibleArea(float left, float top, float right, float bottom);
+
+        Stats stats() const;
+        // How long BGRA to RGBA conversions take, on either side.
+        WebviewDurationHistogram::Snapshot conversionTimes() const;
+        // From a paint reaching produce() to its surface being consumed.
+        WebviewDurationHistogram::Snapshot presentLatencies() const;
+        // From the input a paint answers to its surface being consumed.
+        // Skipped paints hand their input time to the frame that replaced
+        // them; suppressed ones drop it.
+        WebviewDurationHistogram::Snapshot inputLatencies() const;
+
+    private:
+        static const uint32_t kIndexMask = 0x3;
+        static const uint32_t kFreshBit = 0x4;
+        // Above this many pending rects a surface's damage is collapsed to
+        // their bounding box.
+        static const size_t kMaxStaleRects = 16;
+
+        static constexpr int kTileSize = 64;
+
+        bool publish(const WebviewFrame& frame, std::chrono::steady_clock::time_point paintTime);
+        void markStale(uint32_t written, const std::vector<CefRect>& damage);
+        void addStale(std::vector<CefRect>& stale, const std::vector<CefRect>& damage);
+        // The area of a width x height frame to convert, in pixels: the
+        // visible area, or the whole frame while a repaint asked for by
+        // setVisibleArea() is outstanding. |fullRepaint| tells that CEF
+        // painted the whole frame, as it does for that repaint.
+        CefRect visibleRect(int width, int height, bool fullRepaint);
+        static bool coversBounds(const std::vector<CefRect>& rects, const CefRect& bounds);
+        // Splits |needed| into the parts inside and outside |visible|.
+        static void splitByVisible(const std::vector<CefRect>& needed, const CefRect& bounds, const CefRect& visible,
+                                   std::vector<CefRect>& inside, std::vector<CefRect>& outside);
+        // Records what the newest frame handed to the consumer is missing.
+        void setLatestStale(const std::vector<CefRect>& stale, int width, int height);
+        // Replaces |damage| with the tiles whose hash changed. Returns false
+        // if none did.
+        bool filterUnchanged(const WebviewFrame& frame, std::vector<CefRect>& damage);
+
+        Surface surfaces_[3];
+        // Producer-only bookkeeping: what each surface is missing compared to
+        // the latest CEF frame.
+        std::vector<CefRect> staleRects_[3];
+        bool fullyStale_[3];
+
+        uint32_t back_ = 0;
+        uint32_t front_ = 1;
+        std::atomic<uint32_t> middle_{2};
+
+        // Convert-on-consume state. |staging_| mirrors the CEF buffer and is
+        // guarded by |stagingMutex_|, which is only held for damage-sized
+        // copies and to swap buffers. consume() swaps the mirror into
+        // |converting_| and converts from there after unlocking; the next
+        // stage() first copies |stagingCatchUp_| into the buffer it got back.
+        void stage(const WebviewFrame& frame, std::chrono::steady_clock::time_point paintTime);
+        std::atomic<bool> convertOnConsume_{false};
+        bool producerDeferred_ = false;
+        std::mutex stagingMutex_;
+        std::vector<uint8_t> staging_;
+        int stagingWidth_ = 0;
+        int stagingHeight_ = 0;
+        std::vector<CefRect> stagingCatchUp_;
+        bool stagingCatchUpFull_ = false;
+        std::vector<CefRect> pendingRects_;
+        bool pendingFull_ = false;
+        std::chrono::steady_clock::time_point pendingPaintTime_;
+        std::chrono::steady_clock::time_point pendingInputTime_;
+        bool pending_ = false;
+
+        // Consumer-only.
+        bool consumerDeferred_ = false;
+        std::vector<uint8_t> converting_;
+        // Staged damage that was outside the visible area at consume time.
+        std::vector<CefRect> deferredStale_;
+        Surface deferred_;
+
+        // Identical frame detection, producer-only apart from the flag.
+        std::atomic<bool> skipIdenticalFrames_{false};
+        bool producerHashing_ = false;
+        std::vector<uint64_t> tileHashes_;
+        int hashedWidth_ = 0;
+        int hashedHeight_ = 0;
+
+        // Visible area in fractions of the frame, and what the newest
+        // surface is missing, in pixels of a latestWidth_ x latestHeight_
+        // frame.
+        std::mutex visibleMutex_;
+        float visible_[4] = {0, 0, 1, 1};
+        std::vector<CefRect> latestStale_;
+        int latestWidth_ = 0;
+        int latestHeight_ = 0;
+        // setVisibleArea() asked for a repaint to fill what scrolled into view.
+        bool fillStale_ = false;
+
+        std::atomic<uint64_t> produced_{0};
+        std::atomic<uint64_t> converted_{0};
+        std::atomic<uint64_t> skipped_{0};
+        std::atomic<uint64_t> suppressed_{0};
+        std::atomic<uint64_t> offscreen_{0};
+        std::atomic<uint64_t> presented_{0};
+        WebviewDurationHistogram conversionTime_;
+        WebviewDurationHistogram presentLatency_;
+        WebviewDurationHistogram inputLatency_;
+        // Input time of the oldest skipped surface since the last consume,
+        // as steady_clock ticks, or 0.
+        std::atomic<int64_t> skippedInputTime_{0};
+    };
+}
+
+#endif //WEBVIEW_FRAME_POOL_H
@@ -0,0 +1,240 @@
+#include "webview_frame_recorder.h"
+#include "webview_swizzle.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace webview_cef
+{
+	WebviewFrameRecorder::~WebviewFrameRecorder()
+	{
+		stop();
+	}
+
+	bool WebviewFrameRecorder::start(const std::string &path, Format format, int frameRate)
+	{
+		if (file_ != nullptr)
+		{
+			return false;
+		}
+		file_ = fopen(path.c_str(), "wb");
+		if (file_ == nullptr)
+		{
+			std::cerr << "Frame recorder: cannot open " << path << ": " << strerror(errno) << std::endl;
+			return false;
+		}
+		if (format == kFormatRaw)
+		{
+			timestamps_ = fopen((path + ".timestamps").c_str(), "w");
+			if (timestamps_ == nullptr)
+			{
+				std::cerr << "Frame recorder: cannot open " << path << ".timestamps: " << strerror(errno) << std::endl;
+				fclose(file_);
+				file_ = nullptr;
+				return false;
+			}
+			fputs("# timecode format v2\n", timestamps_);
+		}
+		format_ = format;
+		frameRate_ = std::max(1, std::min(frameRate, 240));
+		thread_ = std::thread(&WebviewFrameRecorder::writerLoop, this);
+		return true;
+	}
+
+	void WebviewFrameRecorder::push(const WebviewFrame &frame)
+	{
+		if (frame.buffer == nullptr || frame.width <= 0 || frame.height <= 0)
+		{
+			return;
+		}
+		const uint64_t micros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+									std::chrono::steady_clock::now().time_since_epoch())
+									.count();
+		std::vector<uint8_t> pixels;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (stopping_ || file_ == nullptr || stats_.failed)
+			{
+				return;
+			}
+			const bool resized = stats_.width != 0 && (stats_.width != frame.width || stats_.height != frame.height);
+			if (resized || queue_.size() >= kMaxPending)
+			{
+				stats_.dropped++;
+				return;
+			}
+			stats_.width = frame.width;
+			stats_.height = frame.height;
+			if (!free_.empty())
+			{
+				pixels.swap(free_.back());
+				free_.pop_back();
+			}
+		}
+
+		// Only this copy happens on the UI thread.
+		const size_t rowBytes = (size_t)frame.width * 4;
+		pixels.resize(rowBytes * frame.height);
+		for (int row = 0; row < frame.height; row++)
+		{
+			memcpy(pixels.data() + row * rowBytes, (const uint8_t *)frame.buffer + (size_t)row * frame.stride, rowBytes);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			Pending pending;
+			pending.pixels.swap(pixels);
+			pending.width = frame.width;
+			pending.height = frame.height;
+			pending.micros = micros;
+			queue_.push_back(std::move(pending));
+			stats_.recorded++;
+		}
+		wake_.notify_one();
+	}
+
+	void WebviewFrameRecorder::writerLoop()
+	{
+		bool first = true;
+		bool failed = false;
+		uint64_t firstMicros = 0;
+		// Y4M keeps the newest frame back until the next one shows how long it
+		// stayed on screen.
+		Pending held;
+		uint64_t heldIndex = 0;
+		while (true)
+		{
+			Pending frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [this]
+						   { return stopping_ || !queue_.empty(); });
+				if (queue_.empty())
+				{
+					break;
+				}
+				frame = std::move(queue_.front());
+				queue_.pop_front();
+			}
+			if (failed)
+			{
+				recycle(frame);
+				continue;
+			}
+
+			if (first)
+			{
+				first = false;
+				firstMicros = frame.micros;
+				if (format_ == kFormatY4M)
+				{
+					// C420jpeg: chroma is sited between the four luma samples it averages.
+					fprintf(file_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", frame.width, frame.height, frameRate_);
+				}
+			}
+
+			if (format_ == kFormatRaw)
+			{
+				failed = !write(frame, 1);
+				fprintf(timestamps_, "%.3f\n", (frame.micros - firstMicros) / 1000.0);
+				recycle(frame);
+				continue;
+			}
+
+			const uint64_t index = ((frame.micros - firstMicros) * frameRate_ + 500000) / 1000000;
+			if (!held.pixels.empty() && index > heldIndex)
+			{
+				const uint64_t repeats = std::min<uint64_t>(index - heldIndex, (uint64_t)kMaxRepeatSeconds * frameRate_);
+				failed = !write(held, repeats);
+				heldIndex = index;
+			}
+			// A frame replaced before its slot came up is never written.
+			recycle(held);
+			held = std::move(frame);
+		}
+		if (!failed && !held.pixels.empty())
+		{
+			write(held, 1);
+		}
+	}
+
+	bool WebviewFrameRecorder::write(const Pending &frame, uint64_t repeats)
+	{
+		const size_t lumaSize = (size_t)frame.width * frame.height;
+		const size_t chromaSize = (size_t)((frame.width + 1) / 2) * ((frame.height + 1) / 2);
+		planes_.resize(lumaSize + chromaSize * 2);
+		uint8_t *y = planes_.data();
+		convertBgraToI420(frame.pixels.data(), frame.width * 4, frame.width, frame.height,
+						  y, y + lumaSize, y + lumaSize + chromaSize);
+
+		uint64_t bytes = 0;
+		bool ok = true;
+		for (uint64_t i = 0; i < repeats && ok; i++)
+		{
+			if (format_ == kFormatY4M)
+			{
+				ok = fputs("FRAME\n", file_) >= 0;
+				bytes += 6;
+			}
+			ok = ok && fwrite(planes_.data(), 1, planes_.size(), file_) == planes_.size();
+			bytes += planes_.size();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!ok)
+		{
+			std::cerr << "Frame recorder: write failed: " << strerror(errno) << std::endl;
+			stats_.failed = true;
+			return false;
+		}
+		stats_.written += repeats;
+		stats_.bytes += bytes;
+		return true;
+	}
+
+	void WebviewFrameRecorder::recycle(Pending &frame)
+	{
+		if (frame.pixels.empty())
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (free_.size() <= kMaxPending)
+		{
+			free_.push_back(std::move(frame.pixels));
+		}
+		frame.pixels = std::vector<uint8_t>();
+	}
+
+	void WebviewFrameRecorder::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		if (thread_.joinable())
+		{
+			thread_.join();
+		}
+		if (file_ != nullptr)
+		{
+			fclose(file_);
+			file_ = nullptr;
+		}
+		if (timestamps_ != nullptr)
+		{
+			fclose(timestamps_);
+			timestamps_ = nullptr;
+		}
+	}
+
+	WebviewFrameRecorder::Stats WebviewFrameRecorder::stats()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return stats_;
+	}
+}
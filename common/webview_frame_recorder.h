@@ -0,0 +1,94 @@
+#ifndef WEBVIEW_FRAME_RECORDER_H
+#define WEBVIEW_FRAME_RECORDER_H
+
+#include "webview_plugin.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace webview_cef {
+    // Records one browser's paints to disk as I420 video. push() runs on the
+    // CEF UI thread and only copies the frame into a recycled buffer; the
+    // conversion and file writes happen on the recorder's own thread. When
+    // that thread falls behind, new frames are dropped rather than queued.
+    //
+    // Y4M files are constant frame rate: each frame is repeated until the
+    // next paint is due, so static pages play back in real time. Raw files
+    // hold each paint once, with a "timecode format v2" sidecar
+    // (<path>.timestamps) giving its time in milliseconds.
+    //
+    // The size of the first frame is kept for the whole recording; paints of
+    // another size are dropped.
+    class WebviewFrameRecorder {
+    public:
+        enum Format {
+            kFormatY4M,
+            kFormatRaw,
+        };
+
+        struct Stats {
+            // Paints accepted from CEF.
+            uint64_t recorded = 0;
+            // Paints dropped because the queue was full or the size changed.
+            uint64_t dropped = 0;
+            // Frames written to the file, counting Y4M repeats.
+            uint64_t written = 0;
+            uint64_t bytes = 0;
+            int width = 0;
+            int height = 0;
+            bool failed = false;
+        };
+
+        WebviewFrameRecorder() {}
+        ~WebviewFrameRecorder();
+
+        // Opens |path| and starts the writer thread. Returns false and logs on
+        // failure. |frameRate| is only used by Y4M.
+        bool start(const std::string& path, Format format, int frameRate);
+        void push(const WebviewFrame& frame);
+        // Writes what is still queued and closes the file.
+        void stop();
+
+        Stats stats();
+
+    private:
+        struct Pending {
+            std::vector<uint8_t> pixels;
+            int width = 0;
+            int height = 0;
+            uint64_t micros = 0;
+        };
+
+        static const size_t kMaxPending = 3;
+        // Y4M repeats at most this much time for an idle page.
+        static const int kMaxRepeatSeconds = 10;
+
+        void writerLoop();
+        bool write(const Pending& frame, uint64_t repeats);
+        void recycle(Pending& frame);
+
+        Format format_ = kFormatY4M;
+        int frameRate_ = 30;
+        FILE* file_ = nullptr;
+        FILE* timestamps_ = nullptr;
+        std::thread thread_;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::deque<Pending> queue_;
+        std::vector<std::vector<uint8_t>> free_;
+        bool stopping_ = false;
+        Stats stats_;
+
+        // I420 scratch planes, writer thread only.
+        std::vector<uint8_t> planes_;
+    };
+}
+
+#endif //WEBVIEW_FRAME_RECORDER_H
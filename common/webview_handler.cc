@@ -3,6 +3,7 @@
 // can be found in the LICENSE file.
 
 #include "webview_handler.h"
+#include "webview_plugin.h"
 
 #include <sstream>
 #include <string>
@@ -10,7 +11,9 @@
 #include <chrono>
 #include <unordered_map>
 #include <cstdint>
+#include <algorithm>
 #include <cmath> // Para std::abs
+#include <cstring>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -65,6 +68,31 @@ namespace
                    .ToString();
     }
 
+    // Copies |rect| (in |dest| coordinates) from a BGRA buffer whose origin
+    // sits at |srcOrigin| in |dest|.
+    void copyBgraRect(uint8_t *dest, int destWidth, const uint8_t *src, int srcWidth, const CefRect &srcOrigin, const CefRect &rect)
+    {
+        for (int row = rect.y; row < rect.y + rect.height; row++)
+        {
+            const uint8_t *from = src + ((size_t)(row - srcOrigin.y) * srcWidth + (rect.x - srcOrigin.x)) * 4;
+            memcpy(dest + ((size_t)row * destWidth + rect.x) * 4, from, (size_t)rect.width * 4);
+        }
+    }
+
+    // The popup's rect in view pixels. OnPopupSize reports view coordinates
+    // while the popup paint is in device pixels, so the scale is taken from
+    // the buffer itself.
+    CefRect popupPixelRect(const browser_info &info)
+    {
+        if (info.popup_rect.IsEmpty() || info.popup_buffer_width <= 0)
+        {
+            return CefRect();
+        }
+        double scale = (double)info.popup_buffer_width / info.popup_rect.width;
+        return CefRect((int)std::lround(info.popup_rect.x * scale), (int)std::lround(info.popup_rect.y * scale),
+                       info.popup_buffer_width, info.popup_buffer_height);
+    }
+
 } // namespace
 
 WebviewHandler::WebviewHandler()
@@ -208,6 +236,7 @@ void WebviewHandler::OnAfterCreated(CefRefPtr<CefBrowser> browser)
 
 bool WebviewHandler::DoClose(CefRefPtr<CefBrowser> browser)
 {
+#ifdef _WIN32
     // Obtener el handle de la ventana del navegador
     HWND hwnd = browser->GetHost()->GetWindowHandle();
 
@@ -217,6 +246,10 @@ bool WebviewHandler::DoClose(CefRefPtr<CefBrowser> browser)
     // Devolver true para indicar que nosotros manejamos el cierre
     // y evitar que WM_CLOSE se propague a la ventana principal
     return true;
+#else
+    // Sin ventana nativa que destruir; CEF cierra el navegador
+    return false;
+#endif
 }
 
 void WebviewHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser)
@@ -230,6 +263,21 @@ void WebviewHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser)
         it->second.browser = nullptr;
         browser_map_.erase(it);
     }
+    {
+        std::lock_guard<std::mutex> lock(move_counters_mutex_);
+        move_counters_.erase(browser->GetIdentifier());
+    }
+    for (auto callback = devtools_callbacks_.begin(); callback != devtools_callbacks_.end();)
+    {
+        if (callback->first.first != browser->GetIdentifier())
+        {
+            ++callback;
+            continue;
+        }
+        auto pending = callback->second;
+        callback = devtools_callbacks_.erase(callback);
+        pending(false, std::string());
+    }
 
     // Si este es el último navegador, notificar que todos están cerrados
     if (browser_map_.empty())
@@ -652,21 +700,22 @@ void createCacheDirectory(const std::string &cachePath)
     }
 }
 
-void WebviewHandler::createBrowser(std::string url, std::string profileId, std::function<void(int)> callback)
+void WebviewHandler::createBrowser(std::string url, std::string profileId, bool externalBeginFrame, std::function<void(int)> callback)
 {
 #ifndef OS_MAC
     if (!CefCurrentlyOn(TID_UI))
     {
-        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::createBrowser, this, url, profileId, callback));
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::createBrowser, this, url, profileId, externalBeginFrame, callback));
         return;
     }
 #endif
     CefBrowserSettings browser_settings;
-    browser_settings.windowless_frame_rate = 30;
+    browser_settings.windowless_frame_rate = browser_info::kDefaultFrameRate;
     browser_settings.javascript = STATE_ENABLED;
 
     CefWindowInfo window_info;
     window_info.SetAsWindowless(0);
+    window_info.external_begin_frame_enabled = externalBeginFrame;
 
     // Obtener contexto de solicitud utilizando la función existente
     CefRefPtr<CefRequestContext> context = GetRequestContextForProfile(profileId);
@@ -676,14 +725,18 @@ void WebviewHandler::createBrowser(std::string url, std::string profileId, std::
     // extra_info->SetString("user-agent", user_agent);
 
     // Crear el navegador con el contexto específico del perfil
-    callback(CefBrowserHost::CreateBrowserSync(
-                 window_info,
-                 this,
-                 url,
-                 browser_settings,
-                 extra_info,
-                 context)
-                 ->GetIdentifier());
+    int browserId = CefBrowserHost::CreateBrowserSync(
+                        window_info,
+                        this,
+                        url,
+                        browser_settings,
+                        extra_info,
+                        context)
+                        ->GetIdentifier();
+    // OnAfterCreated only fills in the browser, so this also works if it has
+    // not run yet.
+    browser_map_[browserId].external_begin_frame = externalBeginFrame;
+    callback(browserId);
 }
 
 // Método para obtener o crear un contexto de solicitud para un perfil específico
@@ -710,7 +763,6 @@ CefRefPtr<CefRequestContext> WebviewHandler::GetRequestContextForProfile(const s
     CefRequestContextSettings settings;
 
     // Configurar rutas específicas para el perfil
-#ifdef _WIN32
     // Usar directamente el ID del perfil (limitado a 20 caracteres por seguridad)
     std::string safeProfileId = profileId;
     if (safeProfileId.length() > 20)
@@ -729,6 +781,7 @@ CefRefPtr<CefRequestContext> WebviewHandler::GetRequestContextForProfile(const s
     std::replace(safeProfileId.begin(), safeProfileId.end(), '>', '_');
     std::replace(safeProfileId.begin(), safeProfileId.end(), '|', '_');
 
+#ifdef _WIN32
     // Construir una ruta absoluta completa
     char tempPath[MAX_PATH];
     GetTempPathA(MAX_PATH, tempPath);
@@ -785,10 +838,18 @@ CefRefPtr<CefRequestContext> WebviewHandler::GetRequestContextForProfile(const s
 
 void WebviewHandler::sendScrollEvent(int browserId, int x, int y, int deltaX, int deltaY)
 {
-
+    // Input is handled on the UI thread, where the move coalescing state lives
+    // and the order of events is kept.
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::sendScrollEvent, this, browserId, x, y, deltaX, deltaY));
+        return;
+    }
     auto it = browser_map_.find(browserId);
     if (it != browser_map_.end())
     {
+        sendPendingMove(it->second);
+        it->second.idle_begin_frames = 0;
         CefMouseEvent ev;
         ev.x = x;
         ev.y = y;
@@ -818,13 +879,68 @@ void WebviewHandler::sendScrollEvent(int browserId, int x, int y, int deltaX, in
 
 void WebviewHandler::changeSize(int browserId, float a_dpi, int w, int h)
 {
+    // The resize state is shared with the delayed flushResize task.
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::changeSize, this, browserId, a_dpi, w, h));
+        return;
+    }
     auto it = browser_map_.find(browserId);
-    if (it != browser_map_.end())
+    if (it == browser_map_.end())
+    {
+        return;
+    }
+    browser_info &info = it->second;
+    const uint32_t width = (uint32_t)std::max(w, 1);
+    const uint32_t height = (uint32_t)std::max(h, 1);
+    if (info.dpi == a_dpi && info.width == width && info.height == height)
+    {
+        return;
+    }
+    info.screen_info_changed |= info.dpi != a_dpi;
+    info.dpi = a_dpi;
+    info.width = width;
+    info.height = height;
+    info.idle_begin_frames = 0;
+    if (info.resize_scheduled)
+    {
+        // The pending flush applies the new size.
+        return;
+    }
+    const auto interval = std::chrono::microseconds(1000000 / std::max(info.frame_rate, 1));
+    const auto elapsed = std::chrono::steady_clock::now() - info.last_resize_time;
+    if (elapsed >= interval)
+    {
+        applyResize(info);
+        return;
+    }
+    info.resize_scheduled = true;
+    const int64_t delayMs = std::chrono::duration_cast<std::chrono::milliseconds>(interval - elapsed).count() + 1;
+    CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::flushResize, this, browserId), delayMs);
+}
+
+void WebviewHandler::applyResize(browser_info &info)
+{
+    info.resize_scheduled = false;
+    info.last_resize_time = std::chrono::steady_clock::now();
+    if (!info.browser.get())
+    {
+        return;
+    }
+    if (info.screen_info_changed)
     {
-        it->second.dpi = a_dpi;
-        it->second.width = w;
-        it->second.height = h;
-        it->second.browser->GetHost()->WasResized();
+        info.screen_info_changed = false;
+        info.browser->GetHost()->NotifyScreenInfoChanged();
+    }
+    info.browser->GetHost()->WasResized();
+}
+
+void WebviewHandler::flushResize(int browserId)
+{
+    auto it = browser_map_.find(browserId);
+    if (it != browser_map_.end() && it->second.resize_scheduled)
+    {
+        applyResize(it->second);
     }
 }
 
@@ -845,9 +961,16 @@ uint32_t convertKeyModifiers(KeyboardModifiers modifiers)
 
 void WebviewHandler::cursorClick(int browserId, int x, int y, bool up, int button)
 {
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::cursorClick, this, browserId, x, y, up, button));
+        return;
+    }
     auto it = browser_map_.find(browserId);
     if (it != browser_map_.end())
     {
+        sendPendingMove(it->second);
+        it->second.idle_begin_frames = 0;
         CefMouseEvent ev;
         ev.x = x;
         ev.y = y;
@@ -1013,38 +1136,150 @@ void WebviewHandler::cursorClick(int browserId, int x, int y, bool up, int butto
 
 void WebviewHandler::cursorMove(int browserId, int x, int y, bool dragging)
 {
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::cursorMove, this, browserId, x, y, dragging));
+        return;
+    }
     auto it = browser_map_.find(browserId);
-    if (it != browser_map_.end())
+    if (it == browser_map_.end())
     {
-        CefMouseEvent ev;
-        ev.x = x;
-        ev.y = y;
-        if (dragging)
+        return;
+    }
+    browser_info &info = it->second;
+    info.idle_begin_frames = 0;
+    const bool coalesced = info.move_pending && info.pending_move_dragging == dragging;
+    {
+        std::lock_guard<std::mutex> lock(move_counters_mutex_);
+        MoveCounters &counters = move_counters_[browserId];
+        counters.received++;
+        counters.coalesced += coalesced;
+    }
+    if (info.move_pending)
+    {
+        if (coalesced)
         {
-            ev.modifiers = EVENTFLAG_LEFT_MOUSE_BUTTON;
+            // The scheduled flush sends the latest sample.
+            info.pending_move_x = x;
+            info.pending_move_y = y;
+            return;
         }
+        // A drag starts or ends: the waiting sample belongs before it.
+        sendPendingMove(info);
+    }
+    const auto interval = std::chrono::microseconds(1000000 / std::max(info.frame_rate, 1));
+    const auto elapsed = std::chrono::steady_clock::now() - info.last_move_time;
+    if (elapsed >= interval)
+    {
+        sendMove(info, x, y, dragging);
+        return;
+    }
+    info.move_pending = true;
+    info.pending_move_x = x;
+    info.pending_move_y = y;
+    info.pending_move_dragging = dragging;
+    if (!info.move_scheduled)
+    {
+        info.move_scheduled = true;
+        const int64_t delayMs = std::chrono::duration_cast<std::chrono::milliseconds>(interval - elapsed).count() + 1;
+        CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::flushMove, this, browserId), delayMs);
+    }
+}
 
-        // Generar un evento intermedio de inicio de desplazamiento para evitar errores de is_in_gesture_scroll_
-        // Solo en caso de desplazamiento
-        static bool last_dragging_state = false;
-        if (dragging && !last_dragging_state)
-        {
-            // Iniciar el estado de desplazamiento con un evento de rueda simulado
-            CefMouseEvent scroll_ev;
-            scroll_ev.x = x;
-            scroll_ev.y = y;
-            it->second.browser->GetHost()->SendMouseWheelEvent(scroll_ev, 0, 0);
-        }
-        last_dragging_state = dragging;
+void WebviewHandler::sendTouchEvent(int browserId, int id, int x, int y, cef_touch_event_type_t type, float pressure)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::sendTouchEvent, this, browserId, id, x, y, type, pressure));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        return;
+    }
+    sendPendingMove(it->second);
+    it->second.idle_begin_frames = 0;
+    CefTouchEvent ev;
+    ev.id = id;
+    ev.x = (float)x;
+    ev.y = (float)y;
+    ev.radius_x = 0;
+    ev.radius_y = 0;
+    ev.rotation_angle = 0;
+    ev.pressure = pressure;
+    ev.type = type;
+    ev.modifiers = EVENTFLAG_NONE;
+    ev.pointer_type = CEF_POINTER_TYPE_TOUCH;
+    it->second.browser->GetHost()->SendTouchEvent(ev);
+}
 
-        if (it->second.is_dragging && dragging)
-        {
-            it->second.browser->GetHost()->DragTargetDragOver(ev, DRAG_OPERATION_EVERY);
-        }
-        else
-        {
-            it->second.browser->GetHost()->SendMouseMoveEvent(ev, false);
-        }
+void WebviewHandler::sendPendingMove(browser_info &info)
+{
+    if (info.move_pending)
+    {
+        sendMove(info, info.pending_move_x, info.pending_move_y, info.pending_move_dragging);
+    }
+}
+
+void WebviewHandler::flushMove(int browserId)
+{
+    auto it = browser_map_.find(browserId);
+    if (it != browser_map_.end())
+    {
+        it->second.move_scheduled = false;
+        sendPendingMove(it->second);
+    }
+}
+
+bool WebviewHandler::getInputCounters(int browserId, uint64_t &movesReceived, uint64_t &movesCoalesced)
+{
+    std::lock_guard<std::mutex> lock(move_counters_mutex_);
+    auto it = move_counters_.find(browserId);
+    if (it == move_counters_.end())
+    {
+        return false;
+    }
+    movesReceived = it->second.received;
+    movesCoalesced = it->second.coalesced;
+    return true;
+}
+
+void WebviewHandler::sendMove(browser_info &info, int x, int y, bool dragging)
+{
+    info.move_pending = false;
+    info.last_move_time = std::chrono::steady_clock::now();
+    if (!info.browser.get())
+    {
+        return;
+    }
+    CefMouseEvent ev;
+    ev.x = x;
+    ev.y = y;
+    if (dragging)
+    {
+        ev.modifiers = EVENTFLAG_LEFT_MOUSE_BUTTON;
+    }
+
+    // Generar un evento intermedio de inicio de desplazamiento para evitar errores de is_in_gesture_scroll_
+    // Solo en caso de desplazamiento
+    if (dragging && !info.last_move_dragging)
+    {
+        // Iniciar el estado de desplazamiento con un evento de rueda simulado
+        CefMouseEvent scroll_ev;
+        scroll_ev.x = x;
+        scroll_ev.y = y;
+        info.browser->GetHost()->SendMouseWheelEvent(scroll_ev, 0, 0);
+    }
+    info.last_move_dragging = dragging;
+
+    if (info.is_dragging && dragging)
+    {
+        info.browser->GetHost()->DragTargetDragOver(ev, DRAG_OPERATION_EVERY);
+    }
+    else
+    {
+        info.browser->GetHost()->SendMouseMoveEvent(ev, false);
     }
 }
 
@@ -1110,9 +1345,30 @@ void WebviewHandler::sendKeyEvent(CefKeyEvent &ev)
     {
         return;
     }
+    auto it = browser_map_.find(browser->GetIdentifier());
+    if (it != browser_map_.end())
+    {
+        it->second.idle_begin_frames = 0;
+    }
     browser->GetHost()->SendKeyEvent(ev);
 }
 
+void WebviewHandler::sendKeyEventTo(int browserId, CefKeyEvent ev)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::sendKeyEventTo, this, browserId, ev));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        return;
+    }
+    it->second.idle_begin_frames = 0;
+    it->second.browser->GetHost()->SendKeyEvent(ev);
+}
+
 void WebviewHandler::loadUrl(int browserId, std::string url)
 {
     auto it = browser_map_.find(browserId);
@@ -1218,6 +1474,447 @@ void WebviewHandler::setClientFocus(int browserId, bool focus)
     it->second.browser->GetHost()->SetFocus(focus);
 }
 
+void WebviewHandler::setFrameRate(int browserId, int frameRate)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::setFrameRate, this, browserId, frameRate));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        return;
+    }
+    // CEF clamps windowless rendering to 1-60 fps.
+    it->second.frame_rate = std::max(1, std::min(frameRate, 60));
+    if (!it->second.hidden)
+    {
+        it->second.browser->GetHost()->SetWindowlessFrameRate(it->second.frame_rate);
+    }
+}
+
+void WebviewHandler::setVisibility(int browserId, bool visible)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::setVisibility, this, browserId, visible));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get() || it->second.hidden == !visible)
+    {
+        return;
+    }
+    it->second.hidden = !visible;
+    it->second.frame_requested = false;
+    it->second.idle_begin_frames = 0;
+
+    CefRefPtr<CefBrowserHost> host = it->second.browser->GetHost();
+    CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
+    params->SetDouble("rate", visible ? 1 : kHiddenCpuThrottlingRate);
+    host->ExecuteDevToolsMethod(0, "Emulation.setCPUThrottlingRate", params);
+    host->SetWindowlessFrameRate(visible ? it->second.frame_rate : kHiddenFrameRate);
+    host->WasHidden(!visible);
+    if (visible)
+    {
+        // Paints were dropped while hidden, so the texture needs a full frame.
+        host->Invalidate(PET_VIEW);
+    }
+}
+
+void WebviewHandler::sendExternalBeginFrames()
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::sendExternalBeginFrames, this));
+        return;
+    }
+    begin_frame_count_++;
+    for (auto &entry : browser_map_)
+    {
+        browser_info &info = entry.second;
+        if (!info.external_begin_frame || (info.hidden && !info.frame_requested) || !info.browser.get())
+        {
+            continue;
+        }
+        if (info.idle_begin_frames >= kIdleBeginFrameThreshold && begin_frame_count_ % kIdleBeginFrameInterval != 0)
+        {
+            continue;
+        }
+        info.idle_begin_frames++;
+        info.browser->GetHost()->SendExternalBeginFrame();
+    }
+}
+
+void WebviewHandler::setPaintBudget(int browserId, double budgetMs)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::setPaintBudget, this, browserId, budgetMs));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        return;
+    }
+    it->second.paint_budget_ms = std::max(0.0, budgetMs);
+    it->second.over_budget_paints = it->second.under_budget_paints = 0;
+    if (budgetMs <= 0)
+    {
+        applyRenderScale(it->second, 0);
+    }
+}
+
+void WebviewHandler::setFullResolutionPinned(int browserId, bool pinned)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::setFullResolutionPinned, this, browserId, pinned));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        return;
+    }
+    it->second.scale_pinned = pinned;
+    if (pinned)
+    {
+        applyRenderScale(it->second, 0);
+    }
+}
+
+void WebviewHandler::invalidate(int browserId)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::invalidate, this, browserId));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        return;
+    }
+    it->second.browser->GetHost()->Invalidate(PET_VIEW);
+}
+
+void WebviewHandler::setRenderStatsInterval(int intervalMs)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::setRenderStatsInterval, this, intervalMs));
+        return;
+    }
+    render_stats_interval_ms_ = std::max(intervalMs, 0);
+    render_stats_generation_++;
+    if (render_stats_interval_ms_ > 0)
+    {
+        CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::renderStatsTick, this, render_stats_generation_),
+                           render_stats_interval_ms_);
+    }
+}
+
+void WebviewHandler::replayInput(int browserId, std::vector<webview_cef::WebviewInputEvent> events, double speed)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::replayInput, this, browserId, std::move(events), speed));
+        return;
+    }
+    finishInputReplay(browserId, false);
+    InputReplay &replay = input_replays_[browserId];
+    replay.events = std::move(events);
+    replay.speed = std::max(0.01, std::min(speed, 100.0));
+    replay.start = std::chrono::steady_clock::now();
+    replay.generation = ++input_replay_generation_;
+    inputReplayTick(browserId, replay.generation);
+}
+
+void WebviewHandler::stopInputReplay(int browserId)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::stopInputReplay, this, browserId));
+        return;
+    }
+    finishInputReplay(browserId, false);
+}
+
+void WebviewHandler::inputReplayTick(int browserId, int generation)
+{
+    auto it = input_replays_.find(browserId);
+    if (it == input_replays_.end() || it->second.generation != generation)
+    {
+        return;
+    }
+    if (browser_map_.find(browserId) == browser_map_.end())
+    {
+        finishInputReplay(browserId, false);
+        return;
+    }
+    InputReplay &replay = it->second;
+    // Every event that is due goes out in this tick, so a slow UI thread
+    // delays events but never drops them.
+    const double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - replay.start).count() * replay.speed;
+    while (replay.next < replay.events.size() && replay.events[replay.next].micros <= elapsedUs)
+    {
+        if (onInputReplayEvent)
+        {
+            onInputReplayEvent(browserId, replay.events[replay.next]);
+        }
+        replay.next++;
+    }
+    if (replay.next >= replay.events.size())
+    {
+        finishInputReplay(browserId, true);
+        return;
+    }
+    const double waitUs = (replay.events[replay.next].micros - elapsedUs) / replay.speed;
+    CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::inputReplayTick, this, browserId, generation),
+                       (int64_t)std::ceil(waitUs / 1000.0));
+}
+
+void WebviewHandler::finishInputReplay(int browserId, bool completed)
+{
+    auto it = input_replays_.find(browserId);
+    if (it == input_replays_.end())
+    {
+        return;
+    }
+    const size_t dispatched = it->second.next;
+    const double durationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - it->second.start).count();
+    input_replays_.erase(it);
+    if (onInputReplayFinished)
+    {
+        onInputReplayFinished(browserId, dispatched, completed, durationMs);
+    }
+}
+
+void WebviewHandler::renderStatsTick(int generation)
+{
+    if (generation != render_stats_generation_)
+    {
+        return;
+    }
+    if (onRenderStatsTimer)
+    {
+        onRenderStatsTimer();
+    }
+    CefPostDelayedTask(TID_UI, base::BindOnce(&WebviewHandler::renderStatsTick, this, generation),
+                       render_stats_interval_ms_);
+}
+
+void WebviewHandler::requestFrame(int browserId, std::chrono::milliseconds minHiddenWakeInterval)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::requestFrame, this, browserId, minHiddenWakeInterval));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        return;
+    }
+    CefRefPtr<CefBrowserHost> host = it->second.browser->GetHost();
+    if (it->second.hidden && !it->second.frame_requested)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (it->second.last_hidden_wake != std::chrono::steady_clock::time_point() &&
+            now - it->second.last_hidden_wake < minHiddenWakeInterval)
+        {
+            return;
+        }
+        it->second.last_hidden_wake = now;
+        it->second.frame_requested = true;
+        host->WasHidden(false);
+    }
+    host->Invalidate(PET_VIEW);
+    if (it->second.external_begin_frame)
+    {
+        host->SendExternalBeginFrame();
+    }
+}
+
+namespace
+{
+    class WebviewDevToolsObserver : public CefDevToolsMessageObserver
+    {
+    public:
+        explicit WebviewDevToolsObserver(WebviewHandler *handler) : handler_(handler) {}
+
+        void OnDevToolsMethodResult(CefRefPtr<CefBrowser> browser, int message_id, bool success,
+                                    const void *result, size_t result_size) override
+        {
+            handler_->onDevToolsMethodResult(browser->GetIdentifier(), message_id, success,
+                                             std::string((const char *)result, result_size));
+        }
+
+    private:
+        WebviewHandler *handler_;
+        IMPLEMENT_REFCOUNTING(WebviewDevToolsObserver);
+    };
+
+    double jsonNumber(CefRefPtr<CefDictionaryValue> dict, const char *key)
+    {
+        if (!dict || !dict->HasKey(key))
+        {
+            return 0;
+        }
+        return dict->GetType(key) == VTYPE_INT ? dict->GetInt(key) : dict->GetDouble(key);
+    }
+}
+
+void WebviewHandler::executeDevToolsMethod(int browserId, const std::string &method, CefRefPtr<CefDictionaryValue> params,
+                                           std::function<void(bool success, const std::string &result)> callback)
+{
+    if (!CefCurrentlyOn(TID_UI))
+    {
+        CefPostTask(TID_UI, base::BindOnce(&WebviewHandler::executeDevToolsMethod, this, browserId, method, params, callback));
+        return;
+    }
+    auto it = browser_map_.find(browserId);
+    if (it == browser_map_.end() || !it->second.browser.get())
+    {
+        callback(false, std::string());
+        return;
+    }
+    CefRefPtr<CefBrowserHost> host = it->second.browser->GetHost();
+    if (!it->second.devtools_registration)
+    {
+        it->second.devtools_registration = host->AddDevToolsMessageObserver(new WebviewDevToolsObserver(this));
+    }
+    int messageId = host->ExecuteDevToolsMethod(0, method, params);
+    if (messageId == 0)
+    {
+        callback(false, std::string());
+        return;
+    }
+    devtools_callbacks_[std::make_pair(browserId, messageId)] = callback;
+}
+
+void WebviewHandler::onDevToolsMethodResult(int browserId, int messageId, bool success, const std::string &result)
+{
+    auto it = devtools_callbacks_.find(std::make_pair(browserId, messageId));
+    if (it == devtools_callbacks_.end())
+    {
+        return;
+    }
+    auto callback = it->second;
+    devtools_callbacks_.erase(it);
+    callback(success, result);
+}
+
+void WebviewHandler::captureFullPage(int browserId, int targetWidth, std::function<void(const std::string &png)> callback)
+{
+    executeDevToolsMethod(browserId, "Page.getLayoutMetrics", nullptr, [=](bool success, const std::string &result)
+    {
+        CefRefPtr<CefValue> metrics = success ? CefParseJSON(result, JSON_PARSER_RFC) : nullptr;
+        if (!metrics || metrics->GetType() != VTYPE_DICTIONARY)
+        {
+            callback(std::string());
+            return;
+        }
+        CefRefPtr<CefDictionaryValue> content = metrics->GetDictionary()->GetDictionary("cssContentSize");
+        const double width = jsonNumber(content, "width");
+        const double height = jsonNumber(content, "height");
+        if (width <= 0 || height <= 0)
+        {
+            callback(std::string());
+            return;
+        }
+
+        CefRefPtr<CefDictionaryValue> clip = CefDictionaryValue::Create();
+        clip->SetDouble("x", 0);
+        clip->SetDouble("y", 0);
+        clip->SetDouble("width", width);
+        clip->SetDouble("height", height);
+        clip->SetDouble("scale", targetWidth > 0 ? targetWidth / width : 1.0);
+        CefRefPtr<CefDictionaryValue> params = CefDictionaryValue::Create();
+        params->SetString("format", "png");
+        params->SetBool("captureBeyondViewport", true);
+        params->SetDictionary("clip", clip);
+        executeDevToolsMethod(browserId, "Page.captureScreenshot", params, [=](bool captured, const std::string &screenshot)
+        {
+            CefRefPtr<CefValue> value = captured ? CefParseJSON(screenshot, JSON_PARSER_RFC) : nullptr;
+            if (!value || value->GetType() != VTYPE_DICTIONARY)
+            {
+                callback(std::string());
+                return;
+            }
+            CefRefPtr<CefBinaryValue> png = CefBase64Decode(value->GetDictionary()->GetString("data"));
+            if (!png || png->GetSize() == 0)
+            {
+                callback(std::string());
+                return;
+            }
+            std::string bytes(png->GetSize(), '\0');
+            png->GetData(&bytes[0], bytes.size(), 0);
+            callback(bytes);
+        });
+    });
+}
+
+void WebviewHandler::updateRenderScale(browser_info &info, double costMs)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const bool wasIdle = info.last_paint_time.time_since_epoch().count() != 0 &&
+                         now - info.last_paint_time > std::chrono::seconds(1);
+    info.last_paint_time = now;
+    if (info.scale_pinned || info.paint_budget_ms <= 0)
+    {
+        return;
+    }
+    if (wasIdle && info.render_scale_step > 0)
+    {
+        // Whatever overloaded the browser has stopped; retry a finer step
+        // instead of waiting for a long run of cheap paints.
+        info.paint_cost_ms = 0;
+        applyRenderScale(info, info.render_scale_step - 1);
+        return;
+    }
+
+    info.paint_cost_ms = info.paint_cost_ms == 0 ? costMs : info.paint_cost_ms * 0.8 + costMs * 0.2;
+    if (info.paint_cost_ms > info.paint_budget_ms)
+    {
+        info.under_budget_paints = 0;
+        const int coarsest = (int)(sizeof(kRenderScales) / sizeof(kRenderScales[0])) - 1;
+        if (++info.over_budget_paints >= kScaleDownPaints && info.render_scale_step < coarsest)
+        {
+            applyRenderScale(info, info.render_scale_step + 1);
+        }
+    }
+    else if (info.paint_cost_ms < info.paint_budget_ms * kScaleUpBudgetRatio)
+    {
+        info.over_budget_paints = 0;
+        if (++info.under_budget_paints >= kScaleUpPaints && info.render_scale_step > 0)
+        {
+            applyRenderScale(info, info.render_scale_step - 1);
+        }
+    }
+    else
+    {
+        info.over_budget_paints = info.under_budget_paints = 0;
+    }
+}
+
+void WebviewHandler::applyRenderScale(browser_info &info, int step)
+{
+    info.over_budget_paints = info.under_budget_paints = 0;
+    if (info.render_scale_step == step || !info.browser.get())
+    {
+        return;
+    }
+    info.render_scale_step = step;
+    // The next paints come at the new size and are measured afresh.
+    info.paint_cost_ms = 0;
+    info.browser->GetHost()->NotifyScreenInfoChanged();
+    info.browser->GetHost()->WasResized();
+}
+
 void WebviewHandler::setCookie(const std::string &domain, const std::string &key, const std::string &value)
 {
     CefRefPtr<CefCookieManager> manager = CefCookieManager::GetGlobalManager(nullptr);
@@ -1419,18 +2116,185 @@ void WebviewHandler::GetViewRect(CefRefPtr<CefBrowser> browser, CefRect &rect)
 
 bool WebviewHandler::GetScreenInfo(CefRefPtr<CefBrowser> browser, CefScreenInfo &screen_info)
 {
-    // todo: hi dpi support
-    screen_info.device_scale_factor = browser_map_[browser->GetIdentifier()].dpi;
-    return false;
+    auto it = browser_map_.find(browser->GetIdentifier());
+    if (it == browser_map_.end())
+    {
+        return false;
+    }
+    const browser_info &info = it->second;
+    // An offscreen view has no screen of its own; the view is its screen.
+    const CefRect view(0, 0, (int)std::max(info.width, 1u), (int)std::max(info.height, 1u));
+    // Paints come at the Flutter device pixel ratio, so the texture maps
+    // 1:1 onto physical pixels, reduced while dynamic resolution is active.
+    screen_info.device_scale_factor = std::max(info.dpi, 0.25f) * kRenderScales[info.render_scale_step];
+    screen_info.depth = 24;
+    screen_info.depth_per_component = 8;
+    screen_info.is_monochrome = false;
+    screen_info.rect = view;
+    screen_info.available_rect = view;
+    return true;
+}
+
+void WebviewHandler::OnPopupShow(CefRefPtr<CefBrowser> browser, bool show)
+{
+    auto it = browser_map_.find(browser->GetIdentifier());
+    if (it == browser_map_.end())
+    {
+        return;
+    }
+    browser_info &info = it->second;
+    info.popup_visible = show;
+    if (!show)
+    {
+        info.popup_rect = CefRect();
+        info.popup_buffer.clear();
+        info.popup_buffer_width = info.popup_buffer_height = 0;
+        info.composed_buffer.clear();
+        info.composed_width = info.composed_height = 0;
+    }
+    // The mirror has to be seeded on show, and the pixels under the popup
+    // restored on hide. Both happen once per popup, not per popup frame.
+    browser->GetHost()->Invalidate(PET_VIEW);
+}
+
+void WebviewHandler::OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect &rect)
+{
+    auto it = browser_map_.find(browser->GetIdentifier());
+    if (it == browser_map_.end() || it->second.popup_rect == rect)
+    {
+        return;
+    }
+    browser_info &info = it->second;
+    bool moved = !info.popup_rect.IsEmpty();
+    if (info.popup_rect.width != rect.width || info.popup_rect.height != rect.height)
+    {
+        // The last popup paint has the old size; compose nothing until the
+        // popup repaints at the new one.
+        info.popup_buffer.clear();
+        info.popup_buffer_width = info.popup_buffer_height = 0;
+    }
+    info.popup_rect = rect;
+    if (moved)
+    {
+        // The old popup area is only in the mirror with the popup drawn over it.
+        browser->GetHost()->Invalidate(PET_VIEW);
+    }
 }
 
 void WebviewHandler::OnPaint(CefRefPtr<CefBrowser> browser, CefRenderHandler::PaintElementType type,
                              const CefRenderHandler::RectList &dirtyRects, const void *buffer, int w, int h)
 {
-    if (!browser->IsPopup() && onPaintCallback != nullptr)
+    if (browser->IsPopup() || onPaintCallback == nullptr)
+    {
+        return;
+    }
+    auto it = browser_map_.find(browser->GetIdentifier());
+    if (it == browser_map_.end())
+    {
+        if (type == PET_VIEW)
+        {
+            onPaintCallback(browser->GetIdentifier(), buffer, w, h, dirtyRects);
+        }
+        return;
+    }
+    browser_info &info = it->second;
+    if (info.hidden)
+    {
+        if (info.frame_requested && type == PET_VIEW)
+        {
+            // The one paint requestFrame() woke the browser for.
+            info.frame_requested = false;
+            onPaintCallback(browser->GetIdentifier(), buffer, w, h, dirtyRects);
+            browser->GetHost()->WasHidden(true);
+        }
+        return;
+    }
+    info.idle_begin_frames = 0;
+
+    if (type == PET_POPUP)
+    {
+        if (!info.popup_visible)
+        {
+            return;
+        }
+        info.popup_buffer.assign((const uint8_t *)buffer, (const uint8_t *)buffer + (size_t)w * h * 4);
+        info.popup_buffer_width = w;
+        info.popup_buffer_height = h;
+        if (info.composed_buffer.empty())
+        {
+            // Drawn once the invalidated view paint seeds the mirror.
+            return;
+        }
+        const CefRect popup = popupPixelRect(info);
+        const CefRect bounds(0, 0, info.composed_width, info.composed_height);
+        RectList damage;
+        for (const CefRect &dirty : dirtyRects)
+        {
+            CefRect rect = webview_cef::IntersectRect(CefRect(dirty.x + popup.x, dirty.y + popup.y, dirty.width, dirty.height), bounds);
+            if (rect.IsEmpty())
+            {
+                continue;
+            }
+            copyBgraRect(info.composed_buffer.data(), info.composed_width, info.popup_buffer.data(), w, popup, rect);
+            damage.push_back(rect);
+        }
+        if (!damage.empty())
+        {
+            onPaintCallback(browser->GetIdentifier(), info.composed_buffer.data(), info.composed_width, info.composed_height, damage);
+        }
+        return;
+    }
+
+    if (type != PET_VIEW)
+    {
+        return;
+    }
+    const auto paintStart = std::chrono::steady_clock::now();
+    if (!info.popup_visible)
+    {
+        onPaintCallback(browser->GetIdentifier(), buffer, w, h, dirtyRects);
+    }
+    else
+    {
+        composeView(info, browser->GetIdentifier(), buffer, w, h, dirtyRects);
+    }
+    std::chrono::duration<double, std::milli> cost = std::chrono::steady_clock::now() - paintStart;
+    updateRenderScale(info, cost.count());
+}
+
+void WebviewHandler::composeView(browser_info &info, int browserId, const void *buffer, int w, int h, const RectList &dirtyRects)
+{
+    const CefRect bounds(0, 0, w, h);
+    RectList damage = dirtyRects;
+    const CefRect popup = popupPixelRect(info);
+    const CefRect visible = webview_cef::IntersectRect(popup, bounds);
+    if (info.composed_width != w || info.composed_height != h)
+    {
+        info.composed_buffer.assign((const uint8_t *)buffer, (const uint8_t *)buffer + (size_t)w * h * 4);
+        info.composed_width = w;
+        info.composed_height = h;
+        // Popup paints that arrived before the mirror existed were dropped.
+        if (!visible.IsEmpty())
+        {
+            damage.push_back(visible);
+        }
+    }
+    else
+    {
+        for (const CefRect &dirty : dirtyRects)
+        {
+            CefRect rect = webview_cef::IntersectRect(dirty, bounds);
+            if (!rect.IsEmpty())
+            {
+                copyBgraRect(info.composed_buffer.data(), w, (const uint8_t *)buffer, w, bounds, rect);
+            }
+        }
+    }
+    if (!visible.IsEmpty())
     {
-        onPaintCallback(browser->GetIdentifier(), buffer, w, h);
+        copyBgraRect(info.composed_buffer.data(), w, info.popup_buffer.data(), info.popup_buffer_width, popup, visible);
     }
+    onPaintCallback(browserId, info.composed_buffer.data(), w, h, damage);
 }
 
 // CefContextMenuHandler methods
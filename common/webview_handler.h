@@ -8,12 +8,16 @@
 #include "include/cef_client.h"
 #include "include/cef_request_context_handler.h"
 
+#include <chrono>
 #include <functional>
 #include <list>
 #include <unordered_map>
 #include <map>
+#include <mutex>
+#include <vector>
 
 #include "webview_cookieVisitor.h"
+#include "webview_input_log.h"
 
 #define ColorUNDERLINE \
     0xFF000000 // Black SkColor value for underline,
@@ -49,6 +53,69 @@ struct browser_info
     CefRect prev_ime_position = CefRect();
     bool is_ime_commit = false;
 
+    // Frame rate requested for the browser while it is on screen.
+    static const int kDefaultFrameRate = 30;
+    int frame_rate = kDefaultFrameRate;
+    // Set while the Flutter widget is off screen: painting is throttled and
+    // frames are not forwarded to the texture.
+    bool hidden = false;
+    // A hidden browser was woken by requestFrame() for one paint.
+    bool frame_requested = false;
+    std::chrono::steady_clock::time_point last_hidden_wake;
+
+    // Painting is driven by sendExternalBeginFrames() instead of CEF's timer.
+    bool external_begin_frame = false;
+    // Begin frames sent since the last paint or input event.
+    int idle_begin_frames = 0;
+
+    // setSize() calls are applied at most once per frame interval: the first
+    // one immediately, the ones after it by a single delayed flush that picks
+    // up the latest size.
+    std::chrono::steady_clock::time_point last_resize_time;
+    bool resize_scheduled = false;
+    bool screen_info_changed = false;
+
+    // cursorMove() samples are coalesced the same way: one is sent per frame
+    // interval and the latest sample since then waits in |pending_move_*|.
+    // Clicks, scrolls and drag state changes send the waiting sample first,
+    // so the order of input is kept.
+    std::chrono::steady_clock::time_point last_move_time;
+    bool move_pending = false;
+    bool move_scheduled = false;
+    int pending_move_x = 0;
+    int pending_move_y = 0;
+    bool pending_move_dragging = false;
+    // Drag state of the last move sent, to start a drag with a scroll.
+    bool last_move_dragging = false;
+
+    // PET_POPUP widget (select dropdowns, autofill). |popup_rect| is in view
+    // coordinates as reported by OnPopupSize; |popup_buffer| holds its last
+    // BGRA paint. While a popup is shown the view is mirrored in
+    // |composed_buffer| with the popup drawn on top, so popup paints can be
+    // forwarded as damage-only updates.
+    bool popup_visible = false;
+    CefRect popup_rect = CefRect();
+    std::vector<uint8_t> popup_buffer;
+    int popup_buffer_width = 0;
+    int popup_buffer_height = 0;
+    std::vector<uint8_t> composed_buffer;
+    int composed_width = 0;
+    int composed_height = 0;
+
+    // Dynamic resolution: the page renders at dpi * kRenderScales[render_scale_step]
+    // and Flutter stretches the texture. |paint_cost_ms| is a moving average
+    // of how long handing a paint to the texture takes.
+    int render_scale_step = 0;
+    bool scale_pinned = false;
+    double paint_budget_ms = 8.0;
+    double paint_cost_ms = 0;
+    int over_budget_paints = 0;
+    int under_budget_paints = 0;
+    std::chrono::steady_clock::time_point last_paint_time;
+
+    // Routes DevTools method results to executeDevToolsMethod() callbacks.
+    CefRefPtr<CefRegistration> devtools_registration;
+
     // Variables para múltiples clics
     int last_click_x = 0;
     int last_click_y = 0;
@@ -68,7 +135,7 @@ class WebviewHandler : public CefClient,
 {
 public:
     // Paint callback
-    std::function<void(int browserId, const void *buffer, int32_t width, int32_t height)> onPaintCallback;
+    std::function<void(int browserId, const void *buffer, int32_t width, int32_t height, const RectList &dirtyRects)> onPaintCallback;
     // cef message event
     std::function<void(int browserId, std::string url)> onUrlChangedEvent;
     std::function<void(int browserId, std::string title)> onTitleChangedEvent;
@@ -81,6 +148,11 @@ public:
     std::function<void(std::string, std::string, std::string, int browserId, std::string)> onJavaScriptChannelMessage;
     std::function<void(int browserId, std::string url)> onLoadStart;
     std::function<void(int browserId, std::string url)> onLoadEnd;
+    // Render stats timer, see setRenderStatsInterval().
+    std::function<void()> onRenderStatsTimer;
+    // Input replay, see replayInput().
+    std::function<void(int browserId, const webview_cef::WebviewInputEvent &event)> onInputReplayEvent;
+    std::function<void(int browserId, size_t dispatched, bool completed, double durationMs)> onInputReplayFinished;
 
     explicit WebviewHandler();
     ~WebviewHandler();
@@ -163,6 +235,8 @@ public:
     virtual void GetViewRect(CefRefPtr<CefBrowser> browser, CefRect &rect) override;
     virtual void OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList &dirtyRects, const void *buffer, int width, int height) override;
     virtual bool GetScreenInfo(CefRefPtr<CefBrowser> browser, CefScreenInfo &screen_info) override;
+    virtual void OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) override;
+    virtual void OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect &rect) override;
     virtual bool StartDragging(CefRefPtr<CefBrowser> browser,
                                CefRefPtr<CefDragData> drag_data,
                                DragOperationsMask allowed_ops,
@@ -189,13 +263,21 @@ public:
     static bool IsChromeRuntimeEnabled();
 
     void closeBrowser(int browserId);
-    void createBrowser(std::string url, std::string profileId, std::function<void(int)> callback);
+    void createBrowser(std::string url, std::string profileId, bool externalBeginFrame, std::function<void(int)> callback);
 
     void sendScrollEvent(int browserId, int x, int y, int deltaX, int deltaY);
     void changeSize(int browserId, float a_dpi, int width, int height);
     void cursorClick(int browserId, int x, int y, bool up, int button = 0);
     void cursorMove(int browserId, int x, int y, bool dragging);
+    // Forwards one touch point. |id| tells apart simultaneous touches.
+    void sendTouchEvent(int browserId, int id, int x, int y, cef_touch_event_type_t type, float pressure);
+    // Move counters of the browser; false if it is unknown. Safe to call
+    // from any thread.
+    bool getInputCounters(int browserId, uint64_t &movesReceived, uint64_t &movesCoalesced);
     void sendKeyEvent(CefKeyEvent &ev);
+    // Sends |ev| to |browserId| whether or not it has focus, as input replay
+    // needs.
+    void sendKeyEventTo(int browserId, CefKeyEvent ev);
     void loadUrl(int browserId, std::string url);
     void goForward(int browserId);
     void goBack(int browserId);
@@ -205,6 +287,47 @@ public:
     void imeSetComposition(int browserId, std::string text);
     void imeCommitText(int browserId, std::string text);
     void setClientFocus(int browserId, bool focus);
+    // Both are posted to the CEF UI thread when called from another thread.
+    void setFrameRate(int browserId, int frameRate);
+    void setVisibility(int browserId, bool visible);
+    // Called once per Flutter frame. Sends a BeginFrame to every visible
+    // browser created with external begin frames that may have something
+    // to paint. Safe to call from any thread; the work is posted to the CEF
+    // UI thread.
+    void sendExternalBeginFrames();
+    // Paints that take longer than |budgetMs| to reach the texture lower the
+    // browser's render resolution. 0 disables scaling.
+    void setPaintBudget(int browserId, double budgetMs);
+    // Keeps the browser at full resolution regardless of its paint cost.
+    // Both run on the CEF UI thread, where the scale is read.
+    void setFullResolutionPinned(int browserId, bool pinned);
+    // Asks for a full repaint, for consumers that start from an empty frame.
+    // Posted to the CEF UI thread when called from another thread.
+    void invalidate(int browserId);
+    // Like invalidate(), but a hidden browser is also woken for that one
+    // paint, which reaches onPaintCallback before it is hidden again. Safe to
+    // call from any thread; the work is posted to the CEF UI thread.
+    // The wake makes the page visible for that paint (visibilitychange,
+    // unthrottled timers), so periodic callers pass |minHiddenWakeInterval|
+    // and are ignored for a hidden browser woken more recently than that.
+    void requestFrame(int browserId, std::chrono::milliseconds minHiddenWakeInterval = std::chrono::milliseconds(0));
+    // Runs a DevTools protocol method. |callback| gets the JSON result (or
+    // error) on the CEF UI thread.
+    void executeDevToolsMethod(int browserId, const std::string &method, CefRefPtr<CefDictionaryValue> params,
+                               std::function<void(bool success, const std::string &result)> callback);
+    void onDevToolsMethodResult(int browserId, int messageId, bool success, const std::string &result);
+    // Screenshots the whole page, beyond the viewport, with
+    // Page.captureScreenshot. |targetWidth| > 0 scales the page to that many
+    // pixels wide. |callback| gets the PNG bytes, or nothing on failure.
+    void captureFullPage(int browserId, int targetWidth, std::function<void(const std::string &png)> callback);
+    // Calls onRenderStatsTimer on the CEF UI thread every |intervalMs|; 0
+    // stops the timer.
+    void setRenderStatsInterval(int intervalMs);
+    // Hands |events| to onInputReplayEvent on the CEF UI thread at |speed|
+    // times their recorded pace, then calls onInputReplayFinished. A replay
+    // replaces the browser's previous one and ends early if it closes.
+    void replayInput(int browserId, std::vector<webview_cef::WebviewInputEvent> events, double speed);
+    void stopInputReplay(int browserId);
 
     void setCookie(const std::string &domain, const std::string &key, const std::string &value);
     void deleteCookie(const std::string &domain, const std::string &key);
@@ -226,11 +349,74 @@ public:
         return instance->browser_map_;
     }
 
+    // Hidden browsers keep ticking at this rate so timers and media still
+    // advance, but nothing is rasterized for the texture.
+    static const int kHiddenFrameRate = 1;
+    // Chromium CPU slowdown factor applied to hidden browsers.
+    static const int kHiddenCpuThrottlingRate = 4;
+    // After this many begin frames without a paint a browser is considered
+    // idle and only gets every kIdleBeginFrameInterval-th frame, which still
+    // picks up timer driven page updates. Input wakes it immediately.
+    static const int kIdleBeginFrameThreshold = 8;
+    static const int kIdleBeginFrameInterval = 4;
+    // Resolution steps, and how many consecutive paints must be over budget
+    // (or well under it) before moving between them.
+    static constexpr float kRenderScales[] = {1.0f, 0.75f, 0.5f};
+    static const int kScaleDownPaints = 10;
+    static const int kScaleUpPaints = 120;
+    // Scaling down by one step cuts the cost to roughly 56%, so only scale up
+    // again below 40% of the budget to avoid oscillating.
+    static constexpr double kScaleUpBudgetRatio = 0.4;
+
 private:
+    void updateRenderScale(browser_info &info, double costMs);
+    void applyRenderScale(browser_info &info, int step);
+    void applyResize(browser_info &info);
+    void flushResize(int browserId);
+    void sendMove(browser_info &info, int x, int y, bool dragging);
+    void sendPendingMove(browser_info &info);
+    void flushMove(int browserId);
+    // Forwards a view paint with the visible popup drawn over it.
+    void composeView(browser_info &info, int browserId, const void *buffer, int w, int h, const RectList &dirtyRects);
+
     // List of existing browser windows. Only accessed on the CEF UI thread.
     std::unordered_map<int, browser_info> browser_map_;
 
+    uint64_t begin_frame_count_ = 0;
+
+    // Moves received per browser, and how many of them were replaced by a
+    // later sample. cursorMove() counts them on the CEF UI thread and the
+    // render stats read them on the platform thread.
+    struct MoveCounters
+    {
+        uint64_t received = 0;
+        uint64_t coalesced = 0;
+    };
+    std::mutex move_counters_mutex_;
+    std::unordered_map<int, MoveCounters> move_counters_;
+
+    void renderStatsTick(int generation);
+    int render_stats_interval_ms_ = 0;
+    // Bumped by every setRenderStatsInterval() so ticks of an earlier timer
+    // stop.
+    int render_stats_generation_ = 0;
+
+    struct InputReplay
+    {
+        std::vector<webview_cef::WebviewInputEvent> events;
+        size_t next = 0;
+        double speed = 1.0;
+        std::chrono::steady_clock::time_point start;
+        int generation = 0;
+    };
+    void inputReplayTick(int browserId, int generation);
+    void finishInputReplay(int browserId, bool completed);
+    std::unordered_map<int, InputReplay> input_replays_;
+    int input_replay_generation_ = 0;
+
     std::unordered_map<std::string, std::function<void(CefRefPtr<CefValue>)>> js_callbacks_;
+    // Pending executeDevToolsMethod() calls by (browser id, message id).
+    std::map<std::pair<int, int>, std::function<void(bool, const std::string &)>> devtools_callbacks_;
     // Include the default reference counting implementation.
     IMPLEMENT_REFCOUNTING(WebviewHandler);
 
@@ -0,0 +1,538 @@
+#include "webview_image.h"
+#include "webview_swizzle.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace webview_cef
+{
+	WebviewImage scaleBgraRegion(const uint8_t *bgra, int stride, const WebviewImageRect &region, int width, int height)
+	{
+		WebviewImage image;
+		if (bgra == nullptr || region.isEmpty() || width <= 0 || height <= 0)
+		{
+			return image;
+		}
+		image.width = width;
+		image.height = height;
+		image.pixels.resize((size_t)width * height * 4);
+		uint8_t *dest = image.pixels.data();
+
+		if (width == region.width && height == region.height)
+		{
+			for (int row = 0; row < height; row++)
+			{
+				swizzleBgraToRgba(dest + (size_t)row * width * 4,
+								  bgra + (size_t)(region.y + row) * stride + (size_t)region.x * 4, width);
+			}
+		}
+		else
+		{
+			std::vector<int> columns(width + 1);
+			for (int x = 0; x <= width; x++)
+			{
+				columns[x] = region.x + (int)((int64_t)x * region.width / width);
+			}
+			for (int y = 0; y < height; y++)
+			{
+				const int top = region.y + (int)((int64_t)y * region.height / height);
+				const int bottom = std::max(top + 1, region.y + (int)((int64_t)(y + 1) * region.height / height));
+				for (int x = 0; x < width; x++)
+				{
+					const int left = columns[x];
+					const int right = std::max(left + 1, columns[x + 1]);
+					uint64_t sum[4] = {0, 0, 0, 0};
+					for (int sy = top; sy < bottom; sy++)
+					{
+						const uint8_t *p = bgra + (size_t)sy * stride + (size_t)left * 4;
+						for (int sx = left; sx < right; sx++, p += 4)
+						{
+							sum[0] += p[0];
+							sum[1] += p[1];
+							sum[2] += p[2];
+							sum[3] += p[3];
+						}
+					}
+					const uint64_t count = (uint64_t)(bottom - top) * (right - left);
+					uint8_t *out = dest + ((size_t)y * width + x) * 4;
+					out[0] = (uint8_t)((sum[2] + count / 2) / count);
+					out[1] = (uint8_t)((sum[1] + count / 2) / count);
+					out[2] = (uint8_t)((sum[0] + count / 2) / count);
+					out[3] = (uint8_t)((sum[3] + count / 2) / count);
+				}
+			}
+		}
+
+		// CEF paints premultiplied alpha; image formats expect it straight.
+		for (size_t i = 0; i < image.pixels.size(); i += 4)
+		{
+			const int alpha = dest[i + 3];
+			if (alpha == 255 || alpha == 0)
+			{
+				continue;
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				dest[i + c] = (uint8_t)std::min(255, (dest[i + c] * 255 + alpha / 2) / alpha);
+			}
+		}
+		return image;
+	}
+
+	bool isImageOpaque(const WebviewImage &image)
+	{
+		for (size_t i = 3; i < image.pixels.size(); i += 4)
+		{
+			if (image.pixels[i] != 255)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	WebviewImageDiff diffImages(const WebviewImage &expected, const WebviewImage &actual, int tolerance, bool withHighlight)
+	{
+		WebviewImageDiff diff;
+		const size_t count = (size_t)actual.width * actual.height;
+		if (expected.width != actual.width || expected.height != actual.height ||
+			expected.pixels.size() < count * 4 || actual.pixels.size() < count * 4)
+		{
+			return diff;
+		}
+		diff.sameSize = true;
+		if (withHighlight)
+		{
+			diff.highlight.width = actual.width;
+			diff.highlight.height = actual.height;
+			diff.highlight.pixels.resize(count * 4);
+		}
+		PixelDiffStats stats;
+		diffPixels(expected.pixels.data(), actual.pixels.data(), count, tolerance,
+				   withHighlight ? diff.highlight.pixels.data() : nullptr, stats);
+		diff.differingPixels = stats.differingPixels;
+		diff.maxDelta = stats.maxDelta;
+		diff.meanDelta = count == 0 ? 0 : (double)stats.deltaSum / (count * 4);
+		return diff;
+	}
+
+	// Packs the image into |channels| bytes per pixel.
+	static std::vector<uint8_t> packPixels(const WebviewImage &image, int channels)
+	{
+		if (channels == 4)
+		{
+			return image.pixels;
+		}
+		std::vector<uint8_t> packed((size_t)image.width * image.height * 3);
+		const uint8_t *src = image.pixels.data();
+		for (size_t i = 0, j = 0; j < packed.size(); i += 4, j += 3)
+		{
+			packed[j] = src[i];
+			packed[j + 1] = src[i + 1];
+			packed[j + 2] = src[i + 2];
+		}
+		return packed;
+	}
+
+	static void putBigEndian(std::vector<uint8_t> &out, uint32_t value)
+	{
+		out.push_back((uint8_t)(value >> 24));
+		out.push_back((uint8_t)(value >> 16));
+		out.push_back((uint8_t)(value >> 8));
+		out.push_back((uint8_t)value);
+	}
+
+	struct CrcTable
+	{
+		uint32_t entries[256];
+
+		CrcTable()
+		{
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+				{
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				entries[n] = c;
+			}
+		}
+	};
+
+	static uint32_t crc32(const uint8_t *data, size_t size)
+	{
+		static const CrcTable table;
+		uint32_t crc = 0xffffffffu;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		}
+		return crc ^ 0xffffffffu;
+	}
+
+	static uint32_t adler32(const uint8_t *data, size_t size)
+	{
+		uint32_t a = 1;
+		uint32_t b = 0;
+		while (size > 0)
+		{
+			// 5552 bytes is the most that can be summed before |b| may overflow.
+			const size_t block = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < block; i++)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += block;
+			size -= block;
+		}
+		return (b << 16) | a;
+	}
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<uint8_t> &out) : out_(out) {}
+
+		void put(uint32_t value, int count)
+		{
+			bits_ |= (uint64_t)value << count_;
+			count_ += count;
+			while (count_ >= 8)
+			{
+				out_.push_back((uint8_t)bits_);
+				bits_ >>= 8;
+				count_ -= 8;
+			}
+		}
+
+		void flush()
+		{
+			if (count_ > 0)
+			{
+				out_.push_back((uint8_t)bits_);
+			}
+			bits_ = 0;
+			count_ = 0;
+		}
+
+	private:
+		std::vector<uint8_t> &out_;
+		uint64_t bits_ = 0;
+		int count_ = 0;
+	};
+
+	static const int kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+										35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	static const int kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+										 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	static const int kDistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+										  193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+										  6145, 8193, 12289, 16385, 24577};
+	static const int kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+										   6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+	static uint32_t reverseBits(uint32_t code, int count)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < count; i++)
+		{
+			reversed = (reversed << 1) | ((code >> i) & 1);
+		}
+		return reversed;
+	}
+
+	// Deflate's fixed Huffman tables, with codes bit-reversed for LSB-first
+	// output.
+	struct FixedCodes
+	{
+		uint32_t literal[288];
+		int literalBits[288];
+		uint8_t lengthCode[259];
+		uint8_t distanceCode[512];
+
+		FixedCodes()
+		{
+			for (int s = 0; s < 288; s++)
+			{
+				uint32_t code;
+				int bits;
+				if (s < 144)
+				{
+					code = 0x30 + s;
+					bits = 8;
+				}
+				else if (s < 256)
+				{
+					code = 0x190 + (s - 144);
+					bits = 9;
+				}
+				else if (s < 280)
+				{
+					code = s - 256;
+					bits = 7;
+				}
+				else
+				{
+					code = 0xc0 + (s - 280);
+					bits = 8;
+				}
+				literal[s] = reverseBits(code, bits);
+				literalBits[s] = bits;
+			}
+			for (int code = 0; code < 29; code++)
+			{
+				const int end = code == 28 ? 259 : kLengthBase[code + 1];
+				for (int length = kLengthBase[code]; length < end; length++)
+				{
+					lengthCode[length] = (uint8_t)code;
+				}
+			}
+			// zlib's layout: distances up to 256 directly, larger ones by
+			// (distance - 1) >> 7.
+			for (int code = 0; code < 30; code++)
+			{
+				const int end = code == 29 ? 32769 : kDistanceBase[code + 1];
+				for (int distance = kDistanceBase[code]; distance < end; distance++)
+				{
+					const int slot = distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+					distanceCode[slot] = (uint8_t)code;
+				}
+			}
+		}
+	};
+
+	static void deflateFixed(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+	{
+		static const FixedCodes codes;
+		const int kHashBits = 15;
+		const size_t kWindow = 32768;
+		const size_t kMaxMatch = 258;
+		std::vector<uint32_t> head((size_t)1 << kHashBits, 0);
+
+		BitWriter writer(out);
+		// A single final block with fixed codes.
+		writer.put(1, 1);
+		writer.put(1, 2);
+
+		auto hashAt = [&](size_t i)
+		{
+			uint32_t word = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+			return (word * 2654435761u) >> (32 - kHashBits);
+		};
+
+		size_t i = 0;
+		while (i < size)
+		{
+			size_t length = 0;
+			size_t distance = 0;
+			if (i + 3 <= size)
+			{
+				const uint32_t hash = hashAt(i);
+				// |head| stores position + 1 so that 0 means empty.
+				const size_t candidate = head[hash];
+				head[hash] = (uint32_t)(i + 1);
+				if (candidate != 0 && i - (candidate - 1) <= kWindow)
+				{
+					const uint8_t *a = data + candidate - 1;
+					const uint8_t *b = data + i;
+					const size_t limit = std::min(kMaxMatch, size - i);
+					while (length < limit && a[length] == b[length])
+					{
+						length++;
+					}
+					distance = i - (candidate - 1);
+				}
+			}
+			if (length < 3)
+			{
+				writer.put(codes.literal[data[i]], codes.literalBits[data[i]]);
+				i++;
+				continue;
+			}
+
+			const int lengthCode = codes.lengthCode[length];
+			writer.put(codes.literal[257 + lengthCode], codes.literalBits[257 + lengthCode]);
+			writer.put((uint32_t)(length - kLengthBase[lengthCode]), kLengthExtra[lengthCode]);
+			const int distanceCode = codes.distanceCode[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+			writer.put(reverseBits(distanceCode, 5), 5);
+			writer.put((uint32_t)(distance - kDistanceBase[distanceCode]), kDistanceExtra[distanceCode]);
+
+			for (size_t k = i + 1; k < i + length && k + 3 <= size; k++)
+			{
+				head[hashAt(k)] = (uint32_t)(k + 1);
+			}
+			i += length;
+		}
+		writer.put(codes.literal[256], codes.literalBits[256]);
+		writer.flush();
+	}
+
+	static void putChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+	{
+		putBigEndian(out, (uint32_t)data.size());
+		const size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		putBigEndian(out, crc32(out.data() + start, out.size() - start));
+	}
+
+	static uint8_t paeth(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = std::abs(p - a);
+		const int pb = std::abs(p - b);
+		const int pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc)
+		{
+			return (uint8_t)a;
+		}
+		return (uint8_t)(pb <= pc ? b : c);
+	}
+
+	std::vector<uint8_t> encodePng(const WebviewImage &image)
+	{
+		std::vector<uint8_t> png;
+		if (image.width <= 0 || image.height <= 0)
+		{
+			return png;
+		}
+		const int channels = isImageOpaque(image) ? 3 : 4;
+		const std::vector<uint8_t> pixels = packPixels(image, channels);
+		const size_t rowBytes = (size_t)image.width * channels;
+
+		// Each row gets whichever of the Sub, Up and Paeth filters leaves the
+		// smallest residuals.
+		std::vector<uint8_t> filtered;
+		filtered.reserve((rowBytes + 1) * image.height);
+		std::vector<uint8_t> candidates[3];
+		for (auto &candidate : candidates)
+		{
+			candidate.resize(rowBytes);
+		}
+		const std::vector<uint8_t> zeros(rowBytes, 0);
+		for (int row = 0; row < image.height; row++)
+		{
+			const uint8_t *cur = pixels.data() + row * rowBytes;
+			const uint8_t *prev = row > 0 ? cur - rowBytes : zeros.data();
+			uint64_t cost[3] = {0, 0, 0};
+			for (size_t i = 0; i < rowBytes; i++)
+			{
+				const int left = i >= (size_t)channels ? cur[i - channels] : 0;
+				const int upLeft = i >= (size_t)channels ? prev[i - channels] : 0;
+				candidates[0][i] = (uint8_t)(cur[i] - left);
+				candidates[1][i] = (uint8_t)(cur[i] - prev[i]);
+				candidates[2][i] = (uint8_t)(cur[i] - paeth(left, prev[i], upLeft));
+				for (int f = 0; f < 3; f++)
+				{
+					cost[f] += std::abs((int)(int8_t)candidates[f][i]);
+				}
+			}
+			const int best = (int)(std::min_element(cost, cost + 3) - cost);
+			const uint8_t filterTypes[3] = {1, 2, 4};
+			filtered.push_back(filterTypes[best]);
+			filtered.insert(filtered.end(), candidates[best].begin(), candidates[best].end());
+		}
+
+		std::vector<uint8_t> zlib = {0x78, 0x01};
+		deflateFixed(filtered.data(), filtered.size(), zlib);
+		putBigEndian(zlib, adler32(filtered.data(), filtered.size()));
+
+		const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		png.insert(png.end(), signature, signature + 8);
+		std::vector<uint8_t> header;
+		putBigEndian(header, (uint32_t)image.width);
+		putBigEndian(header, (uint32_t)image.height);
+		header.push_back(8);
+		header.push_back(channels == 4 ? 6 : 2);
+		header.push_back(0);
+		header.push_back(0);
+		header.push_back(0);
+		putChunk(png, "IHDR", header);
+		putChunk(png, "IDAT", zlib);
+		putChunk(png, "IEND", std::vector<uint8_t>());
+		return png;
+	}
+
+	std::vector<uint8_t> encodeQoi(const WebviewImage &image)
+	{
+		std::vector<uint8_t> qoi;
+		if (image.width <= 0 || image.height <= 0)
+		{
+			return qoi;
+		}
+		const int channels = isImageOpaque(image) ? 3 : 4;
+		const size_t count = (size_t)image.width * image.height;
+		qoi.reserve(14 + count * (channels + 1) + 8);
+		qoi.insert(qoi.end(), {'q', 'o', 'i', 'f'});
+		putBigEndian(qoi, (uint32_t)image.width);
+		putBigEndian(qoi, (uint32_t)image.height);
+		qoi.push_back((uint8_t)channels);
+		qoi.push_back(0);
+
+		uint8_t index[64][4];
+		memset(index, 0, sizeof(index));
+		uint8_t prev[4] = {0, 0, 0, 255};
+		int run = 0;
+		const uint8_t *px = image.pixels.data();
+		for (size_t i = 0; i < count; i++, px += 4)
+		{
+			if (memcmp(px, prev, 4) == 0)
+			{
+				run++;
+				if (run == 62 || i + 1 == count)
+				{
+					qoi.push_back((uint8_t)(0xc0 | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0)
+			{
+				qoi.push_back((uint8_t)(0xc0 | (run - 1)));
+				run = 0;
+			}
+			const int slot = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+			if (memcmp(index[slot], px, 4) == 0)
+			{
+				qoi.push_back((uint8_t)slot);
+			}
+			else
+			{
+				memcpy(index[slot], px, 4);
+				if (px[3] == prev[3])
+				{
+					const int dr = (int8_t)(px[0] - prev[0]);
+					const int dg = (int8_t)(px[1] - prev[1]);
+					const int db = (int8_t)(px[2] - prev[2]);
+					const int drg = dr - dg;
+					const int dbg = db - dg;
+					if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+					{
+						qoi.push_back((uint8_t)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+					}
+					else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7)
+					{
+						qoi.push_back((uint8_t)(0x80 | (dg + 32)));
+						qoi.push_back((uint8_t)((drg + 8) << 4 | (dbg + 8)));
+					}
+					else
+					{
+						qoi.insert(qoi.end(), {0xfe, px[0], px[1], px[2]});
+					}
+				}
+				else
+				{
+					qoi.insert(qoi.end(), {0xff, px[0], px[1], px[2], px[3]});
+				}
+			}
+			memcpy(prev, px, 4);
+		}
+		qoi.insert(qoi.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+		return qoi;
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef WEBVIEW_IMAGE_H
+#define WEBVIEW_IMAGE_H
+
+#include <cstdint>
+#include <vector>
+
+namespace webview_cef {
+    // Straight-alpha RGBA pixels with tightly packed rows.
+    struct WebviewImage {
+        std::vector<uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+    };
+
+    // A rectangle of pixels. Kept apart from CefRect so the kernels build
+    // without CEF.
+    struct WebviewImageRect {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+
+        bool isEmpty() const { return width <= 0 || height <= 0; }
+    };
+
+    // Crops |region| out of a premultiplied BGRA frame and resizes it to
+    // width x height. Each output pixel averages the block of source pixels
+    // it covers (a box filter); enlarging repeats pixels. |region| must lie
+    // inside the frame.
+    WebviewImage scaleBgraRegion(const uint8_t* bgra, int stride, const WebviewImageRect& region, int width, int height);
+
+    bool isImageOpaque(const WebviewImage& image);
+
+    struct WebviewImageDiff {
+        // False when the images differ in size; nothing else is filled in.
+        bool sameSize = false;
+        uint64_t differingPixels = 0;
+        // Largest and mean absolute difference over all channels.
+        int maxDelta = 0;
+        double meanDelta = 0;
+        // |actual| faded, differing pixels in red. Only filled in on request.
+        WebviewImage highlight;
+    };
+
+    // Compares two images channel by channel. A pixel differs when any of
+    // its channels is more than |tolerance| apart.
+    WebviewImageDiff diffImages(const WebviewImage& expected, const WebviewImage& actual, int tolerance, bool withHighlight);
+
+    // Encoders favour speed over size. Opaque images are written as RGB.
+    // PNG uses per-row filter selection and a greedy LZ77 pass with fixed
+    // Huffman codes; QOI follows the 1.0 specification.
+    std::vector<uint8_t> encodePng(const WebviewImage& image);
+    std::vector<uint8_t> encodeQoi(const WebviewImage& image);
+}
+
+#endif //WEBVIEW_IMAGE_H
@@ -0,0 +1,236 @@
+#include "webview_input_log.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace webview_cef
+{
+	static const char kInputLogMagic[8] = {'W', 'V', 'I', 'N', 'P', 'U', 'T', 1};
+
+	static void appendInputVarint(std::vector<uint8_t> &out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(uint8_t(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(uint8_t(value));
+	}
+
+	// Zigzag, so small negative values stay short.
+	static void appendInputSigned(std::vector<uint8_t> &out, int64_t value)
+	{
+		appendInputVarint(out, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+	}
+
+	static bool readInputVarint(const std::vector<uint8_t> &in, size_t &pos, uint64_t &value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64 && pos < in.size(); shift += 7)
+		{
+			const uint8_t byte = in[pos++];
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static bool readInputSigned(const std::vector<uint8_t> &in, size_t &pos, int64_t &value)
+	{
+		uint64_t raw = 0;
+		if (!readInputVarint(in, pos, raw))
+		{
+			return false;
+		}
+		value = int64_t(raw >> 1) ^ -int64_t(raw & 1);
+		return true;
+	}
+
+	WebviewInputRecorder::~WebviewInputRecorder()
+	{
+		stop();
+	}
+
+	bool WebviewInputRecorder::start(const std::string &path)
+	{
+		if (file_ != nullptr)
+		{
+			return false;
+		}
+		file_ = fopen(path.c_str(), "wb");
+		if (file_ == nullptr)
+		{
+			std::cerr << "Input recorder: cannot open " << path << ": " << strerror(errno) << std::endl;
+			return false;
+		}
+		buffer_.assign(kInputLogMagic, kInputLogMagic + sizeof(kInputLogMagic));
+		startTime_ = std::chrono::steady_clock::now();
+		lastMicros_ = 0;
+		stats_ = Stats();
+		return true;
+	}
+
+	void WebviewInputRecorder::record(WebviewInputEvent event)
+	{
+		if (file_ == nullptr || stats_.failed)
+		{
+			return;
+		}
+		event.micros = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+						   std::chrono::steady_clock::now() - startTime_)
+						   .count();
+		appendInputVarint(buffer_, event.micros - lastMicros_);
+		lastMicros_ = event.micros;
+		appendInputSigned(buffer_, event.kind());
+		switch (event.kind())
+		{
+		case WebviewInputEvent::kKey:
+			appendInputSigned(buffer_, event.key.type);
+			appendInputSigned(buffer_, event.key.modifiers);
+			appendInputSigned(buffer_, event.key.windows_key_code);
+			appendInputSigned(buffer_, event.key.native_key_code);
+			appendInputSigned(buffer_, event.key.is_system_key);
+			appendInputSigned(buffer_, event.key.character);
+			appendInputSigned(buffer_, event.key.unmodified_character);
+			appendInputSigned(buffer_, event.key.focus_on_editable_field);
+			break;
+		case WebviewInputEvent::kImeComposition:
+		case WebviewInputEvent::kImeCommit:
+			appendInputVarint(buffer_, event.text.size());
+			buffer_.insert(buffer_.end(), event.text.begin(), event.text.end());
+			break;
+		default:
+			for (size_t i = 1; i < WebviewInputEvent::kRecordSize; i++)
+			{
+				appendInputSigned(buffer_, event.record[i]);
+			}
+			break;
+		}
+		stats_.events++;
+		if (buffer_.size() >= kFlushSize)
+		{
+			flush();
+		}
+	}
+
+	void WebviewInputRecorder::flush()
+	{
+		if (buffer_.empty())
+		{
+			return;
+		}
+		if (fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size())
+		{
+			std::cerr << "Input recorder: write failed: " << strerror(errno) << std::endl;
+			stats_.failed = true;
+		}
+		else
+		{
+			stats_.bytes += buffer_.size();
+		}
+		buffer_.clear();
+	}
+
+	WebviewInputRecorder::Stats WebviewInputRecorder::stop()
+	{
+		if (file_ != nullptr)
+		{
+			if (!stats_.failed)
+			{
+				flush();
+			}
+			if (fclose(file_) != 0)
+			{
+				stats_.failed = true;
+			}
+			file_ = nullptr;
+		}
+		return stats_;
+	}
+
+	bool loadInputLog(const std::string &path, std::vector<WebviewInputEvent> &events)
+	{
+		FILE *file = fopen(path.c_str(), "rb");
+		if (file == nullptr)
+		{
+			std::cerr << "Input log: cannot open " << path << ": " << strerror(errno) << std::endl;
+			return false;
+		}
+		std::vector<uint8_t> data;
+		uint8_t chunk[4096];
+		size_t read = 0;
+		while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		{
+			data.insert(data.end(), chunk, chunk + read);
+		}
+		fclose(file);
+		if (data.size() < sizeof(kInputLogMagic) || memcmp(data.data(), kInputLogMagic, sizeof(kInputLogMagic)) != 0)
+		{
+			std::cerr << "Input log: " << path << " is not an input log" << std::endl;
+			return false;
+		}
+
+		events.clear();
+		size_t pos = sizeof(kInputLogMagic);
+		uint64_t micros = 0;
+		while (pos < data.size())
+		{
+			WebviewInputEvent event;
+			uint64_t delta = 0;
+			int64_t kind = 0;
+			if (!readInputVarint(data, pos, delta) || !readInputSigned(data, pos, kind))
+			{
+				break;
+			}
+			micros += delta;
+			event.micros = micros;
+			event.record[0] = int32_t(kind);
+			bool complete = true;
+			if (kind == WebviewInputEvent::kKey)
+			{
+				int64_t fields[8];
+				for (int64_t &field : fields)
+				{
+					complete = complete && readInputSigned(data, pos, field);
+				}
+				event.key.type = int(fields[0]);
+				event.key.modifiers = uint32_t(fields[1]);
+				event.key.windows_key_code = int(fields[2]);
+				event.key.native_key_code = int(fields[3]);
+				event.key.is_system_key = int(fields[4]);
+				event.key.character = char16_t(fields[5]);
+				event.key.unmodified_character = char16_t(fields[6]);
+				event.key.focus_on_editable_field = int(fields[7]);
+			}
+			else if (kind == WebviewInputEvent::kImeComposition || kind == WebviewInputEvent::kImeCommit)
+			{
+				uint64_t length = 0;
+				complete = readInputVarint(data, pos, length) && length <= data.size() - pos;
+				if (complete)
+				{
+					event.text.assign((const char *)data.data() + pos, (size_t)length);
+					pos += (size_t)length;
+				}
+			}
+			else
+			{
+				for (size_t i = 1; i < WebviewInputEvent::kRecordSize && complete; i++)
+				{
+					int64_t value = 0;
+					complete = readInputSigned(data, pos, value);
+					event.record[i] = int32_t(value);
+				}
+			}
+			if (!complete)
+			{
+				break;
+			}
+			events.push_back(std::move(event));
+		}
+		return true;
+	}
+}
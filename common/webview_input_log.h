@@ -0,0 +1,85 @@
+#ifndef WEBVIEW_INPUT_LOG_H
+#define WEBVIEW_INPUT_LOG_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace webview_cef {
+    // The fields of a CefKeyEvent, without CEF so the log builds on its own.
+    struct WebviewKeyEvent {
+        int type = 0;
+        uint32_t modifiers = 0;
+        int windows_key_code = 0;
+        int native_key_code = 0;
+        int is_system_key = 0;
+        char16_t character = 0;
+        char16_t unmodified_character = 0;
+        int focus_on_editable_field = 0;
+    };
+
+    // One input call of a browser. Pointer events keep their sendInputBatch
+    // record (see WebviewPlugin::InputKind); keys and IME text use the kinds
+    // below.
+    struct WebviewInputEvent {
+        enum Kind {
+            kKey = 16,
+            kImeComposition = 17,
+            kImeCommit = 18,
+        };
+        static const size_t kRecordSize = 5;
+
+        // Time since the recording started.
+        uint64_t micros = 0;
+        // record[0] is the kind.
+        int32_t record[kRecordSize] = {};
+        WebviewKeyEvent key;
+        std::string text;
+
+        int32_t kind() const { return record[0]; }
+    };
+
+    // Writes one browser's input calls to a compact binary log, on the thread
+    // that makes them: a header, then per event the time since the previous
+    // one and the kind as varints, followed by the record, the key event
+    // fields or the text. Writes go through a small buffer, so recording
+    // costs little more than a copy.
+    class WebviewInputRecorder {
+    public:
+        struct Stats {
+            uint64_t events = 0;
+            uint64_t bytes = 0;
+            bool failed = false;
+        };
+
+        WebviewInputRecorder() {}
+        ~WebviewInputRecorder();
+
+        // Creates |path|. Returns false and logs on failure.
+        bool start(const std::string& path);
+        // Stamps |event| with the time since start().
+        void record(WebviewInputEvent event);
+        // Writes what is buffered and closes the file.
+        Stats stop();
+
+    private:
+        static const size_t kFlushSize = 4096;
+
+        void flush();
+
+        FILE* file_ = nullptr;
+        std::vector<uint8_t> buffer_;
+        std::chrono::steady_clock::time_point startTime_;
+        uint64_t lastMicros_ = 0;
+        Stats stats_;
+    };
+
+    // Reads a log written by WebviewInputRecorder. Returns false and logs if
+    // it cannot be opened or is not an input log; a truncated log yields the
+    // events before the cut.
+    bool loadInputLog(const std::string& path, std::vector<WebviewInputEvent>& events);
+}
+
+#endif //WEBVIEW_INPUT_LOG_H
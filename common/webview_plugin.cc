@@ -1,11 +1,26 @@
 
 #include "webview_plugin.h"
+#include "webview_swizzle.h"
+#include "webview_frame_pool.h"
+#include "webview_worker_pool.h"
+#include "webview_texture_atlas.h"
+#include "webview_frame_export.h"
+#include "webview_frame_recorder.h"
+#include "webview_frame_capture.h"
+#include "webview_thumbnail_cache.h"
+#include "webview_render_stats.h"
+#include "webview_input_log.h"
+#include "include/base/cef_callback.h"
+#include "include/wrapper/cef_closure_task.h"
 
 #ifdef OS_MAC
 #include <include/wrapper/cef_library_loader.h>
 #endif
 
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <thread>
 #include <iostream>
@@ -26,14 +41,30 @@ namespace webview_cef
 	CefString userAgent;
 	bool isCefInitialized = false;
 
+	// Sets |key| of |map| and drops the caller's reference to |value|.
+	static void setMapEntry(WValue *map, const char *key, WValue *value)
+	{
+		webview_value_set_string(map, key, value);
+		webview_value_unref(value);
+	}
+
 	WebviewPlugin::WebviewPlugin()
 	{
 		m_handler = new WebviewHandler();
+		m_capture.reset(new WebviewFrameCapture());
+		CefRefPtr<WebviewHandler> handler = m_handler;
+		m_thumbnails.reset(new WebviewThumbnailCache([handler](int browserId)
+													 { handler->requestFrame(browserId, std::chrono::milliseconds(WebviewThumbnailCache::kHiddenWakeIntervalMs)); }));
 	}
 
 	WebviewPlugin::~WebviewPlugin()
 	{
+		if (m_benchmarkThread.joinable())
+		{
+			m_benchmarkThread.join();
+		}
 		uninitCallback();
+		m_thumbnails.reset();
 		m_handler->CloseAllBrowsers(true);
 		m_handler = nullptr;
 		if (!m_renderers.empty())
@@ -46,11 +77,65 @@ namespace webview_cef
 	{
 		if (!m_init)
 		{
-			m_handler->onPaintCallback = [=](int browserId, const void *buffer, int32_t width, int32_t height)
+			m_handler->onPaintCallback = [=](int browserId, const void *buffer, int32_t width, int32_t height, const std::vector<CefRect> &dirtyRects)
 			{
 				if (m_renderers.find(browserId) != m_renderers.end() && m_renderers[browserId] != nullptr)
 				{
-					m_renderers[browserId]->onFrame(buffer, width, height);
+					const auto paintStart = std::chrono::steady_clock::now();
+					WebviewFrame frame;
+					frame.buffer = buffer;
+					frame.width = width;
+					frame.height = height;
+					frame.stride = width * 4;
+					frame.dirtyRects = dirtyRects;
+					std::shared_ptr<WebviewPaintStats> stats = findPaintStats(browserId);
+					std::chrono::steady_clock::time_point inputTime;
+					int64_t inputSequence = 0;
+					if (stats != nullptr)
+					{
+						std::lock_guard<std::mutex> lock(stats->inputMutex);
+						inputTime = stats->pendingInputTime;
+						inputSequence = stats->pendingInputSequence;
+						stats->pendingInputTime = std::chrono::steady_clock::time_point();
+					}
+					// Input that changed nothing on screen would otherwise be
+					// matched with whatever paints much later.
+					if (inputTime != std::chrono::steady_clock::time_point() &&
+						paintStart - inputTime < std::chrono::milliseconds(kMaxInputLatencyMs))
+					{
+						frame.inputTime = inputTime;
+						stats->inputToPaint.record(paintStart - inputTime);
+						stats->paintedInputSequence.store(inputSequence, std::memory_order_relaxed);
+					}
+					m_renderers[browserId]->onFrame(frame);
+					{
+						std::lock_guard<std::mutex> lock(m_sinkMutex);
+						auto exporter = m_exporters.find(browserId);
+						if (exporter != m_exporters.end())
+						{
+							exporter->second->publish(frame);
+						}
+						auto recorder = m_recorders.find(browserId);
+						if (recorder != m_recorders.end())
+						{
+							recorder->second->push(frame);
+						}
+					}
+					m_capture->onFrame(browserId, frame);
+					m_thumbnails->onFrame(browserId, frame);
+					if (stats != nullptr)
+					{
+						uint64_t dirtyPixels = 0;
+						const CefRect bounds(0, 0, width, height);
+						for (const CefRect &dirty : dirtyRects)
+						{
+							const CefRect rect = IntersectRect(dirty, bounds);
+							dirtyPixels += (uint64_t)rect.width * rect.height;
+						}
+						stats->paints.fetch_add(1, std::memory_order_relaxed);
+						stats->dirtyPixels.fetch_add(dirtyPixels, std::memory_order_relaxed);
+						stats->paintTime.record(std::chrono::steady_clock::now() - paintStart);
+					}
 				}
 			};
 
@@ -235,6 +320,66 @@ namespace webview_cef
 				}
 			};
 
+			m_handler->onRenderStatsTimer = [=]()
+			{
+				// Like the replay summary, the stats are built where the
+				// renderers live.
+				postToPlatformThread([=]()
+				{
+					if (!m_invokeFunc)
+					{
+						return;
+					}
+					std::vector<int> browserIds;
+					{
+						std::lock_guard<std::mutex> lock(m_inputMutex);
+						for (const auto &browser : m_paintStats)
+						{
+							browserIds.push_back(browser.first);
+						}
+					}
+					for (int browserId : browserIds)
+					{
+						WValue *stats = renderStatsValue(browserId, WebviewPaintStats::kPush);
+						if (stats != nullptr)
+						{
+							m_invokeFunc("onRenderStats", stats);
+							webview_value_unref(stats);
+						}
+					}
+				});
+			};
+
+			m_handler->onInputReplayEvent = [=](int browserId, const WebviewInputEvent &event)
+			{
+				replayInputEvent(browserId, event);
+			};
+
+			m_handler->onInputReplayFinished = [=](int browserId, size_t dispatched, bool completed, double durationMs)
+			{
+				// The stats read the renderers, which belong to the platform
+				// thread.
+				postToPlatformThread([=]()
+				{
+					if (!m_invokeFunc)
+					{
+						return;
+					}
+					WValue *retMap = webview_value_new_map();
+					setMapEntry(retMap, "browserId", webview_value_new_int(browserId));
+					setMapEntry(retMap, "events", webview_value_new_int(int64_t(dispatched)));
+					setMapEntry(retMap, "completed", webview_value_new_bool(completed));
+					setMapEntry(retMap, "durationMs", webview_value_new_double(durationMs));
+					WValue *stats = renderStatsValue(browserId, WebviewPaintStats::kReplay);
+					if (stats != nullptr)
+					{
+						setMapEntry(retMap, "renderStats", stats);
+					}
+					m_invokeFunc("onInputReplayFinished", retMap);
+					webview_value_unref(retMap);
+				});
+			};
+
 			m_init = true;
 		}
 	}
@@ -250,6 +395,9 @@ namespace webview_cef
 		m_handler->onJavaScriptChannelMessage = nullptr;
 		m_handler->onFocusedNodeChangeMessage = nullptr;
 		m_handler->onImeCompositionRangeChangedMessage = nullptr;
+		m_handler->onRenderStatsTimer = nullptr;
+		m_handler->onInputReplayEvent = nullptr;
+		m_handler->onInputReplayFinished = nullptr;
 		m_init = false;
 	}
 
@@ -279,6 +427,8 @@ namespace webview_cef
 			// Obtener la URL y profileId de los argumentos
 			std::string url = "";
 			std::string profileId = "";
+			bool externalBeginFrame = false;
+			bool useTextureAtlas = false;
 
 			if (values != nullptr)
 			{
@@ -296,12 +446,52 @@ namespace webview_cef
 				{
 					profileId = webview_value_get_string(profileValue);
 				}
+
+				WValue *beginFrameValue = webview_value_get_list_value(args, 2);
+				if (beginFrameValue != nullptr)
+				{
+					externalBeginFrame = webview_value_get_bool(beginFrameValue);
+				}
+
+				WValue *atlasValue = webview_value_get_list_value(args, 3);
+				if (atlasValue != nullptr)
+				{
+					useTextureAtlas = webview_value_get_bool(atlasValue);
+				}
 			}
 
-			m_handler->createBrowser(url, profileId, [=](int browserId)
+			m_handler->createBrowser(url, profileId, externalBeginFrame, [=](int browserId)
 									 {
-			std::shared_ptr<WebviewTexture> renderer = m_createTextureFunc();
+			std::shared_ptr<WebviewTexture> renderer;
+			if (useTextureAtlas)
+			{
+				if (!m_atlas)
+				{
+					m_atlas = std::make_shared<WebviewTextureAtlas>(m_createTextureFunc());
+					m_atlas->onSlotChanged = [=](int slotBrowserId)
+					{
+						WValue *slot = atlasSlotValue(slotBrowserId);
+						if (m_invokeFunc && slot != nullptr)
+						{
+							m_invokeFunc("onAtlasSlotChanged", slot);
+						}
+						if (slot != nullptr)
+						{
+							webview_value_unref(slot);
+						}
+					};
+				}
+				renderer = m_atlas->createSlotTexture(browserId);
+			}
+			else
+			{
+				renderer = m_createTextureFunc();
+			}
 			m_renderers[browserId] = renderer;
+			{
+				std::lock_guard<std::mutex> lock(m_inputMutex);
+				m_paintStats[browserId] = std::make_shared<WebviewPaintStats>();
+			}
 			WValue *response = webview_value_new_list();
 			webview_value_append(response, webview_value_new_int(browserId));
 			webview_value_append(response, webview_value_new_int(renderer->textureId));
@@ -312,6 +502,21 @@ namespace webview_cef
 		{
 			int browserId = int(webview_value_get_int(values));
 			m_handler->closeBrowser(browserId);
+			std::unique_ptr<WebviewFrameRecorder> frameRecorder;
+			{
+				std::lock_guard<std::mutex> lock(m_sinkMutex);
+				m_exporters.erase(browserId);
+				frameRecorder = takeRecorder(browserId);
+			}
+			// Finishes the file outside the lock, which paints wait on.
+			frameRecorder.reset();
+			{
+				std::lock_guard<std::mutex> lock(m_inputMutex);
+				m_inputRecorders.erase(browserId);
+				m_paintStats.erase(browserId);
+			}
+			m_capture->cancel(browserId);
+			m_thumbnails->disable(browserId);
 			if (m_renderers.find(browserId) != m_renderers.end() && m_renderers[browserId] != nullptr)
 			{
 				m_renderers[browserId].reset();
@@ -341,6 +546,40 @@ namespace webview_cef
 		{
 			result(cursorAction(values, name), nullptr);
 		}
+		else if (name.compare("sendInputBatch") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			WValue *records = webview_value_get_list_value(values, 1);
+			const int32_t *data = webview_value_get_int32_list(records);
+			if (data == nullptr)
+			{
+				result(-1, nullptr);
+				return;
+			}
+			std::shared_ptr<WebviewPaintStats> stats = findPaintStats(browserId);
+			if (webview_value_get_len(values) >= 5 && stats != nullptr)
+			{
+				// The batch's sequence number, when its oldest event was queued
+				// and when it was sent, in microseconds on our steady clock as
+				// converted with the getInputClock offset; 0 before Dart has it.
+				const int64_t sequence = webview_value_get_int(webview_value_get_list_value(values, 2));
+				const int64_t queuedUs = webview_value_get_int(webview_value_get_list_value(values, 3));
+				const int64_t sentUs = webview_value_get_int(webview_value_get_list_value(values, 4));
+				const auto now = std::chrono::steady_clock::now();
+				if (queuedUs > 0 && sentUs > 0)
+				{
+					// The offset is an estimate, so the times can be a little
+					// in the future.
+					const std::chrono::steady_clock::time_point queued{std::chrono::microseconds(queuedUs)};
+					const std::chrono::steady_clock::time_point sent{std::chrono::microseconds(sentUs)};
+					stats->inputDelivery.record(std::max(now - sent, std::chrono::steady_clock::duration::zero()));
+					markInputTime(browserId, std::min(queued, now), sequence);
+				}
+				stats->inputSequence.store(sequence, std::memory_order_relaxed);
+			}
+			dispatchInputBatch(browserId, data, webview_value_get_len(records));
+			result(1, nullptr);
+		}
 		else if (name.compare("setScrollDelta") == 0)
 		{
 			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
@@ -348,7 +587,8 @@ namespace webview_cef
 			auto y = webview_value_get_int(webview_value_get_list_value(values, 2));
 			auto deltaX = webview_value_get_int(webview_value_get_list_value(values, 3));
 			auto deltaY = webview_value_get_int(webview_value_get_list_value(values, 4));
-			m_handler->sendScrollEvent(browserId, (int)x, (int)y, (int)deltaX, (int)deltaY);
+			const int32_t record[kInputRecordSize] = {kInputScroll, (int32_t)x, (int32_t)y, (int32_t)deltaX, (int32_t)deltaY};
+			dispatchInputRecord(browserId, record);
 			result(1, nullptr);
 		}
 		else if (name.compare("goForward") == 0)
@@ -379,6 +619,13 @@ namespace webview_cef
 		{
 			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
 			const auto text = webview_value_get_string(webview_value_get_list_value(values, 1));
+			if (isRecordingInput(browserId))
+			{
+				WebviewInputEvent event;
+				event.record[0] = WebviewInputEvent::kImeComposition;
+				event.text = text;
+				recordInput(browserId, event);
+			}
 			m_handler->imeSetComposition(browserId, text);
 			result(1, nullptr);
 		}
@@ -386,6 +633,13 @@ namespace webview_cef
 		{
 			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
 			const auto text = webview_value_get_string(webview_value_get_list_value(values, 1));
+			if (isRecordingInput(browserId))
+			{
+				WebviewInputEvent event;
+				event.record[0] = WebviewInputEvent::kImeCommit;
+				event.text = text;
+				recordInput(browserId, event);
+			}
 			m_handler->imeCommitText(browserId, text);
 			result(1, nullptr);
 		}
@@ -399,6 +653,47 @@ namespace webview_cef
 			}
 			result(1, nullptr);
 		}
+		else if (name.compare("setFrameRate") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			int frameRate = int(webview_value_get_int(webview_value_get_list_value(values, 1)));
+			m_handler->setFrameRate(browserId, frameRate);
+			result(1, nullptr);
+		}
+		else if (name.compare("setVisibility") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			bool visible = webview_value_get_bool(webview_value_get_list_value(values, 1));
+			m_handler->setVisibility(browserId, visible);
+			result(1, nullptr);
+		}
+		else if (name.compare("setPaintBudget") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			double budgetMs = webview_value_get_double(webview_value_get_list_value(values, 1));
+			m_handler->setPaintBudget(browserId, budgetMs);
+			result(1, nullptr);
+		}
+		else if (name.compare("setFullResolutionPinned") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			bool pinned = webview_value_get_bool(webview_value_get_list_value(values, 1));
+			m_handler->setFullResolutionPinned(browserId, pinned);
+			result(1, nullptr);
+		}
+		else if (name.compare("getInputClock") == 0)
+		{
+			// Dart estimates its clock offset from this once.
+			const auto now = std::chrono::steady_clock::now().time_since_epoch();
+			WValue *micros = webview_value_new_int(int64_t(std::chrono::duration_cast<std::chrono::microseconds>(now).count()));
+			result(1, micros);
+			webview_value_unref(micros);
+		}
+		else if (name.compare("beginFrame") == 0)
+		{
+			m_handler->sendExternalBeginFrames();
+			result(1, nullptr);
+		}
 		else if (name.compare("setCookie") == 0)
 		{
 			const auto domain = webview_value_get_string(webview_value_get_list_value(values, 0));
@@ -554,14 +849,668 @@ namespace webview_cef
 			result(1, retValue);
 			webview_value_unref(retValue); });
 		}
+		else if (name.compare("setConvertOnConsume") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			bool enabled = webview_value_get_bool(webview_value_get_list_value(values, 1));
+			if (m_renderers.find(browserId) != m_renderers.end() && m_renderers[browserId] != nullptr && m_renderers[browserId]->framePool() != nullptr)
+			{
+				m_renderers[browserId]->framePool()->setConvertOnConsume(enabled);
+			}
+			result(1, nullptr);
+		}
+		else if (name.compare("startFrameExport") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			WValue *nameValue = webview_value_get_list_value(values, 1);
+			std::string exportName = WebviewFrameExporter::defaultName(browserId);
+			if (nameValue != nullptr && webview_value_get_type(nameValue) == Webview_Value_Type_String)
+			{
+				exportName = webview_value_get_string(nameValue);
+			}
+			if (exportName.empty())
+			{
+				result(0, nullptr);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_sinkMutex);
+				m_exporters.erase(browserId);
+			}
+			std::unique_ptr<WebviewFrameExporter> exporter(new WebviewFrameExporter());
+			if (!exporter->open(exportName))
+			{
+				result(-1, nullptr);
+				return;
+			}
+			WValue *wName = webview_value_new_string(exportName.c_str());
+			WValue *pid = webview_value_new_int(WebviewFrameExporter::processId());
+			WValue *retMap = webview_value_new_map();
+			webview_value_set_string(retMap, "name", wName);
+			webview_value_set_string(retMap, "pid", pid);
+			{
+				std::lock_guard<std::mutex> lock(m_sinkMutex);
+				m_exporters[browserId] = std::move(exporter);
+			}
+			result(1, retMap);
+			webview_value_unref(wName);
+			webview_value_unref(pid);
+			webview_value_unref(retMap);
+		}
+		else if (name.compare("stopFrameExport") == 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_sinkMutex);
+				m_exporters.erase(int(webview_value_get_int(values)));
+			}
+			result(1, nullptr);
+		}
+		else if (name.compare("startRecording") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			const auto path = webview_value_get_string(webview_value_get_list_value(values, 1));
+			const auto format = webview_value_get_string(webview_value_get_list_value(values, 2));
+			int frameRate = int(webview_value_get_int(webview_value_get_list_value(values, 3)));
+			if (path == nullptr)
+			{
+				result(-1, nullptr);
+				return;
+			}
+			WebviewFrameRecorder::Format recordFormat = WebviewFrameRecorder::kFormatY4M;
+			if (format != nullptr && std::string(format) == "raw")
+			{
+				recordFormat = WebviewFrameRecorder::kFormatRaw;
+			}
+			std::unique_ptr<WebviewFrameRecorder> previous;
+			{
+				std::lock_guard<std::mutex> lock(m_sinkMutex);
+				previous = takeRecorder(browserId);
+			}
+			previous.reset();
+			std::unique_ptr<WebviewFrameRecorder> recorder(new WebviewFrameRecorder());
+			if (!recorder->start(path, recordFormat, frameRate))
+			{
+				result(-1, nullptr);
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_sinkMutex);
+				m_recorders[browserId] = std::move(recorder);
+			}
+			// Start from a full frame rather than the next bit of damage.
+			m_handler->invalidate(browserId);
+			result(1, nullptr);
+		}
+		else if (name.compare("startInputRecording") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			const auto path = webview_value_get_string(webview_value_get_list_value(values, 1));
+			if (path == nullptr)
+			{
+				result(-1, nullptr);
+				return;
+			}
+			std::unique_ptr<WebviewInputRecorder> recorder(new WebviewInputRecorder());
+			if (!recorder->start(path))
+			{
+				result(-1, nullptr);
+				return;
+			}
+			std::lock_guard<std::mutex> lock(m_inputMutex);
+			m_inputRecorders[browserId] = std::move(recorder);
+			result(1, nullptr);
+		}
+		else if (name.compare("stopInputRecording") == 0)
+		{
+			int browserId = int(webview_value_get_int(values));
+			std::unique_ptr<WebviewInputRecorder> recorder;
+			{
+				std::lock_guard<std::mutex> lock(m_inputMutex);
+				auto it = m_inputRecorders.find(browserId);
+				if (it != m_inputRecorders.end())
+				{
+					recorder = std::move(it->second);
+					m_inputRecorders.erase(it);
+				}
+			}
+			if (recorder == nullptr)
+			{
+				result(1, nullptr);
+				return;
+			}
+			const WebviewInputRecorder::Stats stats = recorder->stop();
+			WValue *retMap = webview_value_new_map();
+			setMapEntry(retMap, "events", webview_value_new_int(int64_t(stats.events)));
+			setMapEntry(retMap, "bytes", webview_value_new_int(int64_t(stats.bytes)));
+			setMapEntry(retMap, "failed", webview_value_new_bool(stats.failed));
+			result(1, retMap);
+			webview_value_unref(retMap);
+		}
+		else if (name.compare("replayInput") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			const auto path = webview_value_get_string(webview_value_get_list_value(values, 1));
+			const double speed = webview_value_get_double(webview_value_get_list_value(values, 2));
+			std::vector<WebviewInputEvent> events;
+			if (path == nullptr || !loadInputLog(path, events))
+			{
+				result(-1, nullptr);
+				return;
+			}
+			// Starts the replay's rate window, so the report's rates cover
+			// the replay only.
+			WValue *baseline = renderStatsValue(browserId, WebviewPaintStats::kReplay);
+			if (baseline != nullptr)
+			{
+				webview_value_unref(baseline);
+			}
+			WValue *count = webview_value_new_int(int64_t(events.size()));
+			m_handler->replayInput(browserId, std::move(events), speed);
+			result(1, count);
+			webview_value_unref(count);
+		}
+		else if (name.compare("stopInputReplay") == 0)
+		{
+			m_handler->stopInputReplay(int(webview_value_get_int(values)));
+			result(1, nullptr);
+		}
+		else if (name.compare("stopRecording") == 0)
+		{
+			int browserId = int(webview_value_get_int(values));
+			std::unique_ptr<WebviewFrameRecorder> recorder;
+			{
+				std::lock_guard<std::mutex> lock(m_sinkMutex);
+				recorder = takeRecorder(browserId);
+			}
+			if (recorder == nullptr)
+			{
+				result(1, nullptr);
+				return;
+			}
+			recorder->stop();
+			WebviewFrameRecorder::Stats stats = recorder->stats();
+			WValue *recorded = webview_value_new_int(int64_t(stats.recorded));
+			WValue *dropped = webview_value_new_int(int64_t(stats.dropped));
+			WValue *written = webview_value_new_int(int64_t(stats.written));
+			WValue *bytes = webview_value_new_int(int64_t(stats.bytes));
+			WValue *failed = webview_value_new_bool(stats.failed);
+			WValue *retMap = webview_value_new_map();
+			webview_value_set_string(retMap, "recorded", recorded);
+			webview_value_set_string(retMap, "dropped", dropped);
+			webview_value_set_string(retMap, "written", written);
+			webview_value_set_string(retMap, "bytes", bytes);
+			webview_value_set_string(retMap, "failed", failed);
+			result(1, retMap);
+			webview_value_unref(recorded);
+			webview_value_unref(dropped);
+			webview_value_unref(written);
+			webview_value_unref(bytes);
+			webview_value_unref(failed);
+			webview_value_unref(retMap);
+		}
+		else if (name.compare("captureFrame") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			const auto format = webview_value_get_string(webview_value_get_list_value(values, 1));
+			int x = int(webview_value_get_int(webview_value_get_list_value(values, 2)));
+			int y = int(webview_value_get_int(webview_value_get_list_value(values, 3)));
+			int width = int(webview_value_get_int(webview_value_get_list_value(values, 4)));
+			int height = int(webview_value_get_int(webview_value_get_list_value(values, 5)));
+			int targetWidth = int(webview_value_get_int(webview_value_get_list_value(values, 6)));
+			int targetHeight = int(webview_value_get_int(webview_value_get_list_value(values, 7)));
+			bool fullPage = webview_value_get_bool(webview_value_get_list_value(values, 8));
+			if (fullPage)
+			{
+				// Rendered by Chromium beyond the viewport, so always a PNG.
+				m_handler->captureFullPage(browserId, targetWidth, [=](const std::string &png)
+										   {
+					if (png.empty())
+					{
+						postResult(result, -1, nullptr);
+						return;
+					}
+					postResult(result, 1, webview_value_new_uint8_list((const uint8_t *)png.data(), png.size())); });
+				return;
+			}
+			WebviewFrameCapture::Request request;
+			request.region = CefRect(x, y, width, height);
+			request.width = targetWidth;
+			request.height = targetHeight;
+			if (format != nullptr && std::string(format) == "qoi")
+			{
+				request.format = WebviewFrameCapture::kFormatQoi;
+			}
+			// Called on the capture thread; the encoding stays there and only
+			// the reply moves to the platform thread.
+			request.done = [=](const std::vector<uint8_t> &encoded)
+			{
+				if (encoded.empty())
+				{
+					postResult(result, -1, nullptr);
+					return;
+				}
+				postResult(result, 1, webview_value_new_uint8_list(encoded.data(), encoded.size()));
+			};
+			m_capture->request(browserId, std::move(request));
+			// The snapshot is taken from the paint this triggers.
+			m_handler->requestFrame(browserId);
+		}
+		else if (name.compare("compareFrame") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			WValue *pixels = webview_value_get_list_value(values, 1);
+			auto expected = std::make_shared<WebviewImage>();
+			expected->width = int(webview_value_get_int(webview_value_get_list_value(values, 2)));
+			expected->height = int(webview_value_get_int(webview_value_get_list_value(values, 3)));
+			int tolerance = int(webview_value_get_int(webview_value_get_list_value(values, 4)));
+			bool withDiffImage = webview_value_get_bool(webview_value_get_list_value(values, 5));
+			const uint8_t *data = webview_value_get_uint8_list(pixels);
+			if (data == nullptr || expected->width <= 0 || expected->height <= 0 ||
+				webview_value_get_len(pixels) != (size_t)expected->width * expected->height * 4)
+			{
+				result(-1, nullptr);
+				return;
+			}
+			expected->pixels.assign(data, data + webview_value_get_len(pixels));
+
+			// The whole frame at its painted size, diffed on the capture thread.
+			WebviewFrameCapture::Request request;
+			request.done = [=](const std::vector<uint8_t> &)
+			{
+				postResult(result, -1, nullptr);
+			};
+			request.consume = [=](const WebviewImage &actual)
+			{
+				WebviewImageDiff diff = diffImages(*expected, actual, tolerance, withDiffImage);
+				WValue *retMap = webview_value_new_map();
+				WValue *width = webview_value_new_int(actual.width);
+				WValue *height = webview_value_new_int(actual.height);
+				WValue *sameSize = webview_value_new_bool(diff.sameSize);
+				WValue *differingPixels = webview_value_new_int(int64_t(diff.differingPixels));
+				WValue *maxDelta = webview_value_new_int(diff.maxDelta);
+				WValue *meanDelta = webview_value_new_double(diff.meanDelta);
+				webview_value_set_string(retMap, "width", width);
+				webview_value_set_string(retMap, "height", height);
+				webview_value_set_string(retMap, "sameSize", sameSize);
+				webview_value_set_string(retMap, "differingPixels", differingPixels);
+				webview_value_set_string(retMap, "maxDelta", maxDelta);
+				webview_value_set_string(retMap, "meanDelta", meanDelta);
+				if (diff.differingPixels > 0 && !diff.highlight.pixels.empty())
+				{
+					std::vector<uint8_t> png = encodePng(diff.highlight);
+					WValue *diffImage = webview_value_new_uint8_list(png.data(), png.size());
+					webview_value_set_string(retMap, "diffImage", diffImage);
+					webview_value_unref(diffImage);
+				}
+				webview_value_unref(width);
+				webview_value_unref(height);
+				webview_value_unref(sameSize);
+				webview_value_unref(differingPixels);
+				webview_value_unref(maxDelta);
+				webview_value_unref(meanDelta);
+				postResult(result, 1, retMap);
+			};
+			m_capture->request(browserId, std::move(request));
+			m_handler->requestFrame(browserId);
+		}
+		else if (name.compare("setThumbnailOptions") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			int maxWidth = int(webview_value_get_int(webview_value_get_list_value(values, 1)));
+			int maxHeight = int(webview_value_get_int(webview_value_get_list_value(values, 2)));
+			int intervalMs = int(webview_value_get_int(webview_value_get_list_value(values, 3)));
+			if (maxWidth <= 0 && maxHeight <= 0)
+			{
+				m_thumbnails->disable(browserId);
+			}
+			else
+			{
+				m_thumbnails->enable(browserId, maxWidth, maxHeight, intervalMs);
+			}
+			result(1, nullptr);
+		}
+		else if (name.compare("getThumbnails") == 0)
+		{
+			uint64_t latest = 0;
+			std::vector<WebviewThumbnailCache::Thumbnail> thumbnails =
+				m_thumbnails->changedSince(uint64_t(webview_value_get_int(values)), latest);
+			WValue *list = webview_value_new_list();
+			for (const WebviewThumbnailCache::Thumbnail &thumbnail : thumbnails)
+			{
+				WValue *bId = webview_value_new_int(thumbnail.browserId);
+				WValue *version = webview_value_new_int(int64_t(thumbnail.version));
+				WValue *width = webview_value_new_int(thumbnail.image.width);
+				WValue *height = webview_value_new_int(thumbnail.image.height);
+				WValue *pixels = webview_value_new_uint8_list(thumbnail.image.pixels.data(), thumbnail.image.pixels.size());
+				WValue *item = webview_value_new_map();
+				webview_value_set_string(item, "browserId", bId);
+				webview_value_set_string(item, "version", version);
+				webview_value_set_string(item, "width", width);
+				webview_value_set_string(item, "height", height);
+				webview_value_set_string(item, "pixels", pixels);
+				webview_value_append(list, item);
+				webview_value_unref(bId);
+				webview_value_unref(version);
+				webview_value_unref(width);
+				webview_value_unref(height);
+				webview_value_unref(pixels);
+				webview_value_unref(item);
+			}
+			WValue *version = webview_value_new_int(int64_t(latest));
+			WValue *retMap = webview_value_new_map();
+			webview_value_set_string(retMap, "version", version);
+			webview_value_set_string(retMap, "thumbnails", list);
+			result(1, retMap);
+			webview_value_unref(version);
+			webview_value_unref(list);
+			webview_value_unref(retMap);
+		}
+		else if (name.compare("getAtlasSlot") == 0)
+		{
+			int browserId = int(webview_value_get_int(values));
+			WValue *slot = atlasSlotValue(browserId);
+			result(1, slot);
+			if (slot != nullptr)
+			{
+				webview_value_unref(slot);
+			}
+		}
+		else if (name.compare("setSkipIdenticalFrames") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			bool enabled = webview_value_get_bool(webview_value_get_list_value(values, 1));
+			if (m_renderers.find(browserId) != m_renderers.end() && m_renderers[browserId] != nullptr && m_renderers[browserId]->framePool() != nullptr)
+			{
+				m_renderers[browserId]->framePool()->setSkipIdenticalFrames(enabled);
+			}
+			result(1, nullptr);
+		}
+		else if (name.compare("setVisibleArea") == 0)
+		{
+			int browserId = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+			float left = float(webview_value_get_double(webview_value_get_list_value(values, 1)));
+			float top = float(webview_value_get_double(webview_value_get_list_value(values, 2)));
+			float right = float(webview_value_get_double(webview_value_get_list_value(values, 3)));
+			float bottom = float(webview_value_get_double(webview_value_get_list_value(values, 4)));
+			auto it = m_renderers.find(browserId);
+			// Atlas slots share one pool, which must keep converting every slot.
+			if (it != m_renderers.end() && it->second != nullptr && it->second->framePool() != nullptr &&
+				(m_atlas == nullptr || it->second->textureId != m_atlas->textureId()))
+			{
+				if (it->second->framePool()->setVisibleArea(left, top, right, bottom))
+				{
+					// What scrolled into view was never converted, and CEF only
+					// repaints on damage. The pool converts all of that repaint,
+					// so this happens once per change of the hidden part rather
+					// than once per scroll step.
+					m_handler->invalidate(browserId);
+				}
+			}
+			result(1, nullptr);
+		}
+		else if (name.compare("getFrameStats") == 0)
+		{
+			int browserId = int(webview_value_get_int(values));
+			if (m_renderers.find(browserId) == m_renderers.end() || m_renderers[browserId] == nullptr || m_renderers[browserId]->framePool() == nullptr)
+			{
+				result(1, nullptr);
+				return;
+			}
+			WebviewFramePool::Stats stats = m_renderers[browserId]->framePool()->stats();
+			WValue *produced = webview_value_new_int(int64_t(stats.produced));
+			WValue *converted = webview_value_new_int(int64_t(stats.converted));
+			WValue *skipped = webview_value_new_int(int64_t(stats.skipped));
+			WValue *suppressed = webview_value_new_int(int64_t(stats.suppressed));
+			WValue *offscreen = webview_value_new_int(int64_t(stats.offscreen));
+			WValue *retMap = webview_value_new_map();
+			webview_value_set_string(retMap, "produced", produced);
+			webview_value_set_string(retMap, "converted", converted);
+			webview_value_set_string(retMap, "skipped", skipped);
+			webview_value_set_string(retMap, "suppressed", suppressed);
+			webview_value_set_string(retMap, "offscreen", offscreen);
+			result(1, retMap);
+			webview_value_unref(produced);
+			webview_value_unref(converted);
+			webview_value_unref(skipped);
+			webview_value_unref(suppressed);
+			webview_value_unref(offscreen);
+			webview_value_unref(retMap);
+		}
+		else if (name.compare("getRenderStats") == 0)
+		{
+			WValue *stats = renderStatsValue(int(webview_value_get_int(values)), WebviewPaintStats::kQuery);
+			result(1, stats);
+			if (stats != nullptr)
+			{
+				webview_value_unref(stats);
+			}
+		}
+		else if (name.compare("setRenderStatsInterval") == 0)
+		{
+			m_handler->setRenderStatsInterval(int(webview_value_get_int(values)));
+			result(1, nullptr);
+		}
+		else if (name.compare("swizzleBenchmark") == 0)
+		{
+			int width = 1920;
+			int height = 1080;
+			int iterations = 100;
+			if (values != nullptr && webview_value_get_len(values) >= 3)
+			{
+				width = int(webview_value_get_int(webview_value_get_list_value(values, 0)));
+				height = int(webview_value_get_int(webview_value_get_list_value(values, 1)));
+				iterations = int(webview_value_get_int(webview_value_get_list_value(values, 2)));
+			}
+			runBenchmark([=]()
+						 {
+				WValue *retMap = webview_value_new_map();
+				for (auto &bench : benchmarkSwizzleKernels(width, height, iterations))
+				{
+					WValue *gbps = webview_value_new_double(bench.gigabytesPerSecond);
+					webview_value_set_string(retMap, getSwizzleKernelName(bench.kernel), gbps);
+					webview_value_unref(gbps);
+				}
+				WValue *active = webview_value_new_string(getSwizzleKernelName(getActiveSwizzleKernel()));
+				webview_value_set_string(retMap, "active", active);
+				webview_value_unref(active);
+				return retMap; },
+						 result);
+		}
+		else if (name.compare("conversionBenchmark") == 0)
+		{
+			int iterations = 50;
+			if (values != nullptr && webview_value_get_type(values) == Webview_Value_Type_Int)
+			{
+				iterations = int(webview_value_get_int(values));
+			}
+			runBenchmark([=]()
+						 {
+				WValue *list = webview_value_new_list();
+				for (auto &bench : benchmarkFrameConversion(iterations))
+				{
+					WValue *entry = webview_value_new_map();
+					setMapEntry(entry, "width", webview_value_new_int(bench.width));
+					setMapEntry(entry, "height", webview_value_new_int(bench.height));
+					setMapEntry(entry, "damage", webview_value_new_bool(bench.damage));
+					setMapEntry(entry, "singleMs", webview_value_new_double(bench.singleMilliseconds));
+					setMapEntry(entry, "parallelMs", webview_value_new_double(bench.parallelMilliseconds));
+					webview_value_append(list, entry);
+					webview_value_unref(entry);
+				}
+				WValue *retMap = webview_value_new_map();
+				setMapEntry(retMap, "threads", webview_value_new_int(WebviewWorkerPool::shared().concurrency()));
+				setMapEntry(retMap, "threshold", webview_value_new_int(int64_t(getParallelConversionThreshold())));
+				setMapEntry(retMap, "results", list);
+				return retMap; },
+						 result);
+		}
+		else if (name.compare("setParallelConversionThreshold") == 0)
+		{
+			setParallelConversionThreshold(size_t(std::max<int64_t>(0, webview_value_get_int(values))));
+			result(1, nullptr);
+		}
 		else
 		{
 			result = 0;
 		}
 	}
 
+	WValue *WebviewPlugin::atlasSlotValue(int browserId)
+	{
+		CefRect slot;
+		int atlasWidth = 0;
+		int atlasHeight = 0;
+		if (!m_atlas || !m_atlas->getSlot(browserId, slot, atlasWidth, atlasHeight))
+		{
+			return nullptr;
+		}
+		WValue *bId = webview_value_new_int(browserId);
+		WValue *textureId = webview_value_new_int(m_atlas->textureId());
+		WValue *left = webview_value_new_double((double)slot.x / atlasWidth);
+		WValue *top = webview_value_new_double((double)slot.y / atlasHeight);
+		WValue *right = webview_value_new_double((double)(slot.x + slot.width) / atlasWidth);
+		WValue *bottom = webview_value_new_double((double)(slot.y + slot.height) / atlasHeight);
+		WValue *retMap = webview_value_new_map();
+		webview_value_set_string(retMap, "browserId", bId);
+		webview_value_set_string(retMap, "textureId", textureId);
+		webview_value_set_string(retMap, "left", left);
+		webview_value_set_string(retMap, "top", top);
+		webview_value_set_string(retMap, "right", right);
+		webview_value_set_string(retMap, "bottom", bottom);
+		webview_value_unref(bId);
+		webview_value_unref(textureId);
+		webview_value_unref(left);
+		webview_value_unref(top);
+		webview_value_unref(right);
+		webview_value_unref(bottom);
+		return retMap;
+	}
+
+	static WValue *histogramValue(const WebviewDurationHistogram::Snapshot &snapshot)
+	{
+		// A plain list: typed lists do not survive every platform channel.
+		WValue *buckets = webview_value_new_list();
+		for (int i = 0; i < WebviewDurationHistogram::kBuckets; i++)
+		{
+			WValue *count = webview_value_new_int(int64_t(snapshot.buckets[i]));
+			webview_value_append(buckets, count);
+			webview_value_unref(count);
+		}
+		WValue *retMap = webview_value_new_map();
+		setMapEntry(retMap, "count", webview_value_new_int(int64_t(snapshot.count)));
+		setMapEntry(retMap, "meanMs", webview_value_new_double(snapshot.meanMs));
+		setMapEntry(retMap, "maxMs", webview_value_new_double(snapshot.maxMs));
+		setMapEntry(retMap, "p50Ms", webview_value_new_double(snapshot.p50Ms));
+		setMapEntry(retMap, "p95Ms", webview_value_new_double(snapshot.p95Ms));
+		setMapEntry(retMap, "p99Ms", webview_value_new_double(snapshot.p99Ms));
+		setMapEntry(retMap, "buckets", buckets);
+		return retMap;
+	}
+
+	WValue *WebviewPlugin::renderStatsValue(int browserId, WebviewPaintStats::Consumer consumer)
+	{
+		std::shared_ptr<WebviewPaintStats> stats = findPaintStats(browserId);
+		if (stats == nullptr)
+		{
+			return nullptr;
+		}
+		WebviewPaintStats &paint = *stats;
+		auto renderer = m_renderers.find(browserId);
+		WebviewFramePool *pool = renderer != m_renderers.end() && renderer->second != nullptr ? renderer->second->framePool() : nullptr;
+		const WebviewFramePool::Stats frames = pool != nullptr ? pool->stats() : WebviewFramePool::Stats();
+
+		const auto now = std::chrono::steady_clock::now();
+		const uint64_t paints = paint.paints.load(std::memory_order_relaxed);
+		double paintFps = 0;
+		double presentFps = 0;
+		WebviewPaintStats::RateWindow &window = paint.rateWindows[consumer];
+		if (window.time != std::chrono::steady_clock::time_point())
+		{
+			const double seconds = std::chrono::duration<double>(now - window.time).count();
+			if (seconds > 0)
+			{
+				paintFps = (paints - window.paints) / seconds;
+				presentFps = (frames.presented - window.presented) / seconds;
+			}
+		}
+		window.time = now;
+		window.paints = paints;
+		window.presented = frames.presented;
+
+		WValue *retMap = webview_value_new_map();
+		setMapEntry(retMap, "browserId", webview_value_new_int(browserId));
+		setMapEntry(retMap, "paints", webview_value_new_int(int64_t(paints)));
+		setMapEntry(retMap, "dirtyPixels", webview_value_new_int(int64_t(paint.dirtyPixels.load(std::memory_order_relaxed))));
+		setMapEntry(retMap, "converted", webview_value_new_int(int64_t(frames.converted)));
+		setMapEntry(retMap, "presented", webview_value_new_int(int64_t(frames.presented)));
+		setMapEntry(retMap, "skipped", webview_value_new_int(int64_t(frames.skipped)));
+		setMapEntry(retMap, "suppressed", webview_value_new_int(int64_t(frames.suppressed)));
+		setMapEntry(retMap, "offscreen", webview_value_new_int(int64_t(frames.offscreen)));
+		setMapEntry(retMap, "paintFps", webview_value_new_double(paintFps));
+		setMapEntry(retMap, "presentFps", webview_value_new_double(presentFps));
+		uint64_t moves = 0;
+		uint64_t coalescedMoves = 0;
+		m_handler->getInputCounters(browserId, moves, coalescedMoves);
+		setMapEntry(retMap, "moves", webview_value_new_int(int64_t(moves)));
+		setMapEntry(retMap, "coalescedMoves", webview_value_new_int(int64_t(coalescedMoves)));
+		setMapEntry(retMap, "inputSequence", webview_value_new_int(paint.inputSequence.load(std::memory_order_relaxed)));
+		setMapEntry(retMap, "paintedInputSequence", webview_value_new_int(paint.paintedInputSequence.load(std::memory_order_relaxed)));
+		setMapEntry(retMap, "inputDelivery", histogramValue(paint.inputDelivery.snapshot()));
+		setMapEntry(retMap, "paintTime", histogramValue(paint.paintTime.snapshot()));
+		setMapEntry(retMap, "inputToPaint", histogramValue(paint.inputToPaint.snapshot()));
+		if (pool != nullptr)
+		{
+			setMapEntry(retMap, "conversionTime", histogramValue(pool->conversionTimes()));
+			setMapEntry(retMap, "presentLatency", histogramValue(pool->presentLatencies()));
+			setMapEntry(retMap, "inputToPresent", histogramValue(pool->inputLatencies()));
+		}
+		return retMap;
+	}
+
+	static WebviewKeyEvent toLoggedKey(const CefKeyEvent &ev)
+	{
+		WebviewKeyEvent key;
+		key.type = ev.type;
+		key.modifiers = ev.modifiers;
+		key.windows_key_code = ev.windows_key_code;
+		key.native_key_code = ev.native_key_code;
+		key.is_system_key = ev.is_system_key;
+		key.character = ev.character;
+		key.unmodified_character = ev.unmodified_character;
+		key.focus_on_editable_field = ev.focus_on_editable_field;
+		return key;
+	}
+
+	static CefKeyEvent fromLoggedKey(const WebviewKeyEvent &key)
+	{
+		CefKeyEvent ev;
+		ev.type = cef_key_event_type_t(key.type);
+		ev.modifiers = key.modifiers;
+		ev.windows_key_code = key.windows_key_code;
+		ev.native_key_code = key.native_key_code;
+		ev.is_system_key = key.is_system_key;
+		ev.character = key.character;
+		ev.unmodified_character = key.unmodified_character;
+		ev.focus_on_editable_field = key.focus_on_editable_field;
+		return ev;
+	}
+
 	void WebviewPlugin::sendKeyEvent(CefKeyEvent &ev)
 	{
+		if (isRecordingInput())
+		{
+			// Keys go to the focused browser.
+			WebviewInputEvent event;
+			event.record[0] = WebviewInputEvent::kKey;
+			event.key = toLoggedKey(ev);
+			for (auto &render : m_renderers)
+			{
+				if (render.second != nullptr && render.second->isFocused)
+				{
+					recordInput(render.first, event);
+				}
+			}
+		}
 		m_handler->sendKeyEvent(ev);
 		if (ev.type == KEYEVENT_RAWKEYDOWN && ev.windows_key_code == 0x7B && (ev.modifiers & EVENTFLAG_CONTROL_DOWN) != 0)
 		{
@@ -585,6 +1534,84 @@ namespace webview_cef
 		m_createTextureFunc = func;
 	}
 
+	void WebviewPlugin::setPostTaskFunc(std::function<void(std::function<void()>)> func)
+	{
+		m_postTaskFunc = func;
+	}
+
+	static void runPlatformTask(std::function<void()> task)
+	{
+		task();
+	}
+
+	// A method result on its way to the platform thread. If the task that
+	// carries it is dropped without running, as the Windows message loop
+	// does once the window's plugin is gone, the call is still completed,
+	// with an error, so the Dart future does not hang.
+	class PlatformReply
+	{
+	public:
+		PlatformReply(std::function<void(int, WValue *)> result, int status, WValue *value)
+			: result_(std::move(result)), status_(status), value_(value) {}
+		~PlatformReply()
+		{
+			if (!sent_)
+			{
+				result_(-1, nullptr);
+			}
+			if (value_ != nullptr)
+			{
+				webview_value_unref(value_);
+			}
+		}
+		void send()
+		{
+			sent_ = true;
+			result_(status_, value_);
+		}
+
+	private:
+		std::function<void(int, WValue *)> result_;
+		int status_;
+		WValue *value_;
+		bool sent_ = false;
+	};
+
+	void WebviewPlugin::postResult(std::function<void(int, WValue *)> result, int status, WValue *value)
+	{
+		auto reply = std::make_shared<PlatformReply>(std::move(result), status, value);
+		postToPlatformThread([reply]()
+							 { reply->send(); });
+	}
+
+	void WebviewPlugin::runBenchmark(std::function<WValue *()> benchmark, std::function<void(int, WValue *)> result)
+	{
+		if (m_benchmarkThread.joinable())
+		{
+			if (m_benchmarkRunning.load())
+			{
+				result(-1, nullptr);
+				return;
+			}
+			m_benchmarkThread.join();
+		}
+		m_benchmarkRunning = true;
+		m_benchmarkThread = std::thread([=]()
+										{
+			postResult(result, 1, benchmark());
+			m_benchmarkRunning = false; });
+	}
+
+	void WebviewPlugin::postToPlatformThread(std::function<void()> task)
+	{
+		if (m_postTaskFunc)
+		{
+			m_postTaskFunc(std::move(task));
+			return;
+		}
+		CefPostTask(TID_UI, base::BindOnce(&runPlatformTask, std::move(task)));
+	}
+
 	bool WebviewPlugin::getAnyBrowserFocused()
 	{
 		for (auto render : m_renderers)
@@ -614,6 +1641,25 @@ namespace webview_cef
 			button = int(webview_value_get_int(webview_value_get_list_value(args, 3)));
 		}
 
+		InputKind kind = kInputMove;
+		if (name.compare("cursorClickDown") == 0)
+		{
+			kind = kInputDown;
+		}
+		else if (name.compare("cursorClickUp") == 0)
+		{
+			kind = kInputUp;
+		}
+		else if (name.compare("cursorDragging") == 0)
+		{
+			kind = kInputDrag;
+		}
+		const int32_t record[kInputRecordSize] = {kind, x, y, button, 0};
+		return dispatchInputRecord(browserId, record);
+	}
+
+	int WebviewPlugin::dispatchCursor(int browserId, InputKind kind, int x, int y, int button)
+	{
 		// Si es botón 2, asumimos que es clic derecho
 		if (button == 2)
 		{
@@ -628,23 +1674,133 @@ namespace webview_cef
 		{
 			return 0;
 		}
-		if (name.compare("cursorClickDown") == 0)
+		switch (kind)
 		{
+		case kInputDown:
 			m_handler->cursorClick(browserId, x, y, false, button);
+			break;
+		case kInputUp:
+			m_handler->cursorClick(browserId, x, y, true, button);
+			break;
+		case kInputMove:
+			m_handler->cursorMove(browserId, x, y, false);
+			break;
+		case kInputDrag:
+			m_handler->cursorMove(browserId, x, y, true);
+			break;
+		default:
+			return 0;
 		}
-		else if (name.compare("cursorClickUp") == 0)
+		return 1;
+	}
+
+	size_t WebviewPlugin::dispatchInputBatch(int browserId, const int32_t *records, size_t length)
+	{
+		size_t dispatched = 0;
+		for (size_t i = 0; i + kInputRecordSize <= length; i += kInputRecordSize)
 		{
-			m_handler->cursorClick(browserId, x, y, true, button);
+			dispatched += dispatchInputRecord(browserId, records + i);
 		}
-		else if (name.compare("cursorMove") == 0)
+		return dispatched;
+	}
+
+	int WebviewPlugin::dispatchInputRecord(int browserId, const int32_t *record)
+	{
+		static_assert(WebviewInputEvent::kRecordSize == kInputRecordSize, "input logs store sendInputBatch records");
+		if (isRecordingInput(browserId))
 		{
-			m_handler->cursorMove(browserId, x, y, false);
+			WebviewInputEvent event;
+			std::copy(record, record + kInputRecordSize, event.record);
+			recordInput(browserId, event);
 		}
-		else if (name.compare("cursorDragging") == 0)
+		if (record[0] == kInputScroll)
 		{
-			m_handler->cursorMove(browserId, x, y, true);
+			m_handler->sendScrollEvent(browserId, record[1], record[2], record[3], record[4]);
+			return 1;
+		}
+		if (record[0] >= kInputMove && record[0] <= kInputUp)
+		{
+			return dispatchCursor(browserId, InputKind(record[0]), record[1], record[2], record[3]);
+		}
+		if (record[0] >= kInputTouchPressed && record[0] <= kInputTouchCancelled)
+		{
+			static const cef_touch_event_type_t kTouchTypes[] = {CEF_TET_PRESSED, CEF_TET_MOVED, CEF_TET_RELEASED, CEF_TET_CANCELLED};
+			const float pressure = std::min(std::max(record[4], 0), 1000) / 1000.0f;
+			m_handler->sendTouchEvent(browserId, record[3], record[1], record[2], kTouchTypes[record[0] - kInputTouchPressed], pressure);
+			return 1;
+		}
+		return 0;
+	}
+
+	bool WebviewPlugin::isRecordingInput(int browserId)
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		return browserId < 0 ? !m_inputRecorders.empty() : m_inputRecorders.find(browserId) != m_inputRecorders.end();
+	}
+
+	std::unique_ptr<WebviewFrameRecorder> WebviewPlugin::takeRecorder(int browserId)
+	{
+		std::unique_ptr<WebviewFrameRecorder> recorder;
+		auto it = m_recorders.find(browserId);
+		if (it != m_recorders.end())
+		{
+			recorder = std::move(it->second);
+			m_recorders.erase(it);
+		}
+		return recorder;
+	}
+
+	std::shared_ptr<WebviewPaintStats> WebviewPlugin::findPaintStats(int browserId)
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		auto it = m_paintStats.find(browserId);
+		return it != m_paintStats.end() ? it->second : nullptr;
+	}
+
+	void WebviewPlugin::recordInput(int browserId, const WebviewInputEvent &event)
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		auto it = m_inputRecorders.find(browserId);
+		if (it != m_inputRecorders.end())
+		{
+			it->second->record(event);
+		}
+	}
+
+	void WebviewPlugin::replayInputEvent(int browserId, const WebviewInputEvent &event)
+	{
+		markInputTime(browserId, std::chrono::steady_clock::now(), 0);
+		switch (event.kind())
+		{
+		case WebviewInputEvent::kKey:
+		{
+			m_handler->sendKeyEventTo(browserId, fromLoggedKey(event.key));
+			break;
+		}
+		case WebviewInputEvent::kImeComposition:
+			m_handler->imeSetComposition(browserId, event.text);
+			break;
+		case WebviewInputEvent::kImeCommit:
+			m_handler->imeCommitText(browserId, event.text);
+			break;
+		default:
+			dispatchInputRecord(browserId, event.record);
+			break;
+		}
+	}
+
+	void WebviewPlugin::markInputTime(int browserId, std::chrono::steady_clock::time_point inputTime, int64_t sequence)
+	{
+		std::shared_ptr<WebviewPaintStats> stats = findPaintStats(browserId);
+		if (stats != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(stats->inputMutex);
+			if (stats->pendingInputTime == std::chrono::steady_clock::time_point())
+			{
+				stats->pendingInputTime = inputTime;
+				stats->pendingInputSequence = sequence;
+			}
 		}
-		return 1;
 	}
 
 	void initCEFProcesses(CefMainArgs args)
@@ -735,22 +1891,185 @@ namespace webview_cef
 		CefDoMessageLoopWork();
 	}
 
+	static std::atomic<size_t> parallelConversionThreshold{kDefaultParallelConversionThreshold};
+
+	void setParallelConversionThreshold(size_t pixels)
+	{
+		parallelConversionThreshold.store(pixels, std::memory_order_relaxed);
+	}
+
+	size_t getParallelConversionThreshold()
+	{
+		return parallelConversionThreshold.load(std::memory_order_relaxed);
+	}
+
+	// Splits rows [0, height) into one stripe per pool thread when |pixels|
+	// is worth the hand-off, and calls convert(top, bottom) for each stripe.
+	static void forEachStripe(int height, size_t pixels, size_t threshold, const std::function<void(int, int)> &convert)
+	{
+		WebviewWorkerPool &pool = WebviewWorkerPool::shared();
+		const int stripes = std::min(pool.concurrency(), height);
+		if (pixels < threshold || stripes <= 1)
+		{
+			convert(0, height);
+			return;
+		}
+		pool.run(stripes, [&](int i)
+				 { convert(height * i / stripes, height * (i + 1) / stripes); });
+	}
+
+	static void swapBuffer(void *_dest, const void *_src, int width, int height, size_t threshold)
+	{
+		forEachStripe(height, (size_t)width * height, threshold, [&](int top, int bottom)
+					  {
+			const size_t offset = (size_t)top * width * 4;
+			swizzleBgraToRgba((uint8_t *)_dest + offset, (const uint8_t *)_src + offset, (size_t)width * (bottom - top)); });
+	}
+
 	void SwapBufferFromBgraToRgba(void *_dest, const void *_src, int width, int height)
 	{
-		int32_t *dest = (int32_t *)_dest;
-		int32_t *src = (int32_t *)_src;
-		int32_t rgba;
-		int32_t bgra;
-		int length = width * height;
-		for (int i = 0; i < length; i++)
+		swapBuffer(_dest, _src, width, height, getParallelConversionThreshold());
+	}
+
+	CefRect IntersectRect(const CefRect &a, const CefRect &b)
+	{
+		int left = std::max(a.x, b.x);
+		int top = std::max(a.y, b.y);
+		int right = std::min(a.x + a.width, b.x + b.width);
+		int bottom = std::min(a.y + a.height, b.y + b.height);
+		if (right <= left || bottom <= top)
+		{
+			return CefRect();
+		}
+		return CefRect(left, top, right - left, bottom - top);
+	}
+
+	CefRect UnionRect(const CefRect &a, const CefRect &b)
+	{
+		if (a.IsEmpty())
+		{
+			return b;
+		}
+		if (b.IsEmpty())
+		{
+			return a;
+		}
+		int left = std::min(a.x, b.x);
+		int top = std::min(a.y, b.y);
+		int right = std::max(a.x + a.width, b.x + b.width);
+		int bottom = std::max(a.y + a.height, b.y + b.height);
+		return CefRect(left, top, right - left, bottom - top);
+	}
+
+	// Converts the part of frame.dirtyRects that lies in rows [top, bottom).
+	static void swapDirtyRows(void *_dest, const WebviewFrame &frame, const std::vector<CefRect> &rects, int top, int bottom)
+	{
+		const CefRect band(0, top, frame.width, bottom - top);
+		for (const CefRect &dirty : rects)
+		{
+			CefRect rect = IntersectRect(dirty, band);
+			if (rect.IsEmpty())
+			{
+				continue;
+			}
+			if (rect.width == frame.width)
+			{
+				// Full-width damage is one contiguous run.
+				const size_t offset = (size_t)rect.y * frame.stride;
+				swizzleBgraToRgba((uint8_t *)_dest + offset, (const uint8_t *)frame.buffer + offset, (size_t)rect.width * rect.height);
+				continue;
+			}
+			for (int row = rect.y; row < rect.y + rect.height; row++)
+			{
+				const size_t offset = (size_t)row * frame.stride + (size_t)rect.x * 4;
+				swizzleBgraToRgba((uint8_t *)_dest + offset, (const uint8_t *)frame.buffer + offset, rect.width);
+			}
+		}
+	}
+
+	static void swapDirtyRects(void *_dest, const WebviewFrame &frame, size_t threshold)
+	{
+		const CefRect bounds(0, 0, frame.width, frame.height);
+		std::vector<CefRect> rects;
+		rects.reserve(frame.dirtyRects.size());
+		size_t pixels = 0;
+		for (const CefRect &dirty : frame.dirtyRects)
+		{
+			CefRect rect = IntersectRect(dirty, bounds);
+			if (!rect.IsEmpty())
+			{
+				rects.push_back(rect);
+				pixels += (size_t)rect.width * rect.height;
+			}
+		}
+		forEachStripe(frame.height, pixels, threshold, [&](int top, int bottom)
+					  { swapDirtyRows(_dest, frame, rects, top, bottom); });
+	}
+
+	void SwapDirtyRectsFromBgraToRgba(void *_dest, const WebviewFrame &frame)
+	{
+		swapDirtyRects(_dest, frame, getParallelConversionThreshold());
+	}
+
+	std::vector<ConversionBenchmarkResult> benchmarkFrameConversion(int iterations)
+	{
+		static const int sizes[][2] = {{640, 480}, {1280, 720}, {1920, 1080}, {2560, 1440}, {3440, 1440}, {3840, 2160}, {5120, 2880}};
+		// Damage inside a 4K frame: full-width bands as left by scrolling,
+		// and boxes as left by animations, from 64K to 2M pixels.
+		static const int damages[][2] = {{3840, 16}, {3840, 64}, {3840, 256}, {3840, 512},
+										 {256, 256}, {512, 512}, {1024, 1024}, {2048, 1024}};
+		const int frameWidth = 3840;
+		const int frameHeight = 2160;
+		std::vector<ConversionBenchmarkResult> results;
+		if (iterations <= 0)
+		{
+			return results;
+		}
+		std::vector<uint32_t> src((size_t)5120 * 2880, 0xff336699);
+		std::vector<uint32_t> dest(src.size());
+		const auto time = [&](const std::function<void(size_t)> &convert, double &milliseconds, size_t threshold)
+		{
+			// Warm up caches, page in the destination and wake the workers.
+			convert(threshold);
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				convert(threshold);
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			milliseconds = elapsed.count() / iterations;
+		};
+		for (const auto &size : sizes)
+		{
+			ConversionBenchmarkResult result;
+			result.width = size[0];
+			result.height = size[1];
+			const auto convert = [&](size_t threshold)
+			{ swapBuffer(dest.data(), src.data(), result.width, result.height, threshold); };
+			time(convert, result.singleMilliseconds, SIZE_MAX);
+			time(convert, result.parallelMilliseconds, 0);
+			results.push_back(result);
+		}
+		for (const auto &size : damages)
 		{
-			bgra = src[i];
-			// BGRA in hex = 0xAARRGGBB.
-			rgba = (bgra & 0x00ff0000) >> 16	// Red >> Blue.
-				   | (bgra & 0xff00ff00)		// Green Alpha.
-				   | (bgra & 0x000000ff) << 16; // Blue >> Red.
-			dest[i] = rgba;
+			ConversionBenchmarkResult result;
+			result.width = size[0];
+			result.height = size[1];
+			result.damage = true;
+			WebviewFrame frame;
+			frame.buffer = src.data();
+			frame.width = frameWidth;
+			frame.height = frameHeight;
+			frame.stride = frameWidth * 4;
+			frame.dirtyRects.push_back(CefRect((frameWidth - result.width) / 2, (frameHeight - result.height) / 2,
+											   result.width, result.height));
+			const auto convert = [&](size_t threshold)
+			{ swapDirtyRects(dest.data(), frame, threshold); };
+			time(convert, result.singleMilliseconds, SIZE_MAX);
+			time(convert, result.parallelMilliseconds, 0);
+			results.push_back(result);
 		}
+		return results;
 	}
 
 	void stopCEF()
@@ -3,14 +3,41 @@
 
 #include "webview_value.h"
 #include "webview_app.h"
+#include "webview_render_stats.h"
 #include <include/cef_base.h>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 namespace webview_cef {
+    class WebviewFramePool;
+    class WebviewTextureAtlas;
+    class WebviewFrameExporter;
+    class WebviewFrameRecorder;
+    class WebviewFrameCapture;
+    class WebviewThumbnailCache;
+    class WebviewInputRecorder;
+    struct WebviewInputEvent;
+    // One OnPaint of the main view: a BGRA buffer plus the rects CEF repainted.
+    struct WebviewFrame{
+        const void* buffer = nullptr;
+        int width = 0;
+        int height = 0;
+        int stride = 0; // bytes per row
+        std::vector<CefRect> dirtyRects;
+        // When the oldest input this paint answers was generated, if any.
+        std::chrono::steady_clock::time_point inputTime;
+    };
     class WebviewTexture{
     public:
         virtual ~WebviewTexture(){}
-        virtual void onFrame(const void* buffer, int width, int height){}
+        virtual void onFrame(const WebviewFrame&){}
+        // The pool backing this texture, if the platform renderer uses one.
+        virtual WebviewFramePool* framePool(){ return nullptr; }
         int64_t textureId = 0;
         bool isFocused = false;
     };
@@ -24,15 +51,92 @@ namespace webview_cef {
         void sendKeyEvent(CefKeyEvent& ev);
         void setInvokeMethodFunc(std::function<void(std::string, WValue*)> func);
         void setCreateTextureFunc(std::function<std::shared_ptr<WebviewTexture>()> func);
+        // Runs a task on the platform thread, where method results must be
+        // delivered. Without one, tasks go to the CEF UI thread, which is the
+        // platform thread unless CEF runs its own message loop (Windows).
+        void setPostTaskFunc(std::function<void(std::function<void()>)> func);
         bool getAnyBrowserFocused();
 
+        // sendInputBatch packs events into an Int32List of fixed-size
+        // records: kind, x, y and two kind specific values (the button for
+        // clicks, the deltas for scrolls, the pointer id and the pressure in
+        // thousandths for touches). Records are dispatched in order.
+        enum InputKind {
+            kInputMove = 0,
+            kInputDrag = 1,
+            kInputDown = 2,
+            kInputUp = 3,
+            kInputScroll = 4,
+            kInputTouchPressed = 5,
+            kInputTouchMoved = 6,
+            kInputTouchReleased = 7,
+            kInputTouchCancelled = 8,
+        };
+        static const size_t kInputRecordSize = 5;
+        // A paint later than this after an input batch is not counted as
+        // its response.
+        static const int kMaxInputLatencyMs = 1000;
+
     private :
         int cursorAction(WValue *args, std::string name);
+        int dispatchCursor(int browserId, InputKind kind, int x, int y, int button);
+        // Returns how many events were dispatched.
+        size_t dispatchInputBatch(int browserId, const int32_t* records, size_t length);
+        // Records and dispatches one sendInputBatch record; returns 1 if it
+        // was dispatched.
+        int dispatchInputRecord(int browserId, const int32_t* record);
+        // Whether |browserId|, or any browser if it is negative, is recorded.
+        bool isRecordingInput(int browserId = -1);
+        std::shared_ptr<WebviewPaintStats> findPaintStats(int browserId);
+        // Removes the browser's frame recorder from m_recorders; the caller
+        // holds m_sinkMutex.
+        std::unique_ptr<WebviewFrameRecorder> takeRecorder(int browserId);
+        void recordInput(int browserId, const WebviewInputEvent& event);
+        void replayInputEvent(int browserId, const WebviewInputEvent& event);
+        // Starts an input-to-paint measurement, unless one is pending.
+        void markInputTime(int browserId, std::chrono::steady_clock::time_point inputTime, int64_t sequence);
+        // Map with the browser's atlas texture id and its slot as normalized
+        // left/top/right/bottom, or nullptr if it has no slot yet.
+        WValue* atlasSlotValue(int browserId);
+        // Map with the paint, conversion and presentation stats of
+        // |browserId|, or nullptr for an unknown browser. Frame rates are
+        // measured since the previous call for the same |consumer|.
+        WValue* renderStatsValue(int browserId, WebviewPaintStats::Consumer consumer);
+        // For results produced on a worker or the CEF UI thread.
+        void postToPlatformThread(std::function<void()> task);
+        // Replies to a method call on the platform thread; takes |value|.
+        // The call fails if the reply is dropped on the way.
+        void postResult(std::function<void(int, WValue*)> result, int status, WValue* value);
+        // Runs |benchmark| on its own thread and replies with its value, so a
+        // multi-second benchmark does not stall the platform thread. One runs
+        // at a time; a second call fails while one is in flight.
+        void runBenchmark(std::function<WValue*()> benchmark, std::function<void(int, WValue*)> result);
     	std::function<void(std::string, WValue*)> m_invokeFunc;
 	    std::function<std::shared_ptr<WebviewTexture>()> m_createTextureFunc;
+	    std::function<void(std::function<void()>)> m_postTaskFunc;
         CefRefPtr<WebviewHandler> m_handler;
 	    CefRefPtr<WebviewApp> m_app;
     	std::unordered_map<int, std::shared_ptr<WebviewTexture>> m_renderers;
+	    // Shared texture for browsers created with useTextureAtlas.
+	    std::shared_ptr<WebviewTextureAtlas> m_atlas;
+	    // Shared-memory sinks for browsers whose frames are exported, and
+	    // frame recorders. Paints feed them on the CEF UI thread while method
+	    // calls on the platform thread add and remove them, so m_sinkMutex
+	    // guards both maps.
+	    std::mutex m_sinkMutex;
+	    std::unordered_map<int, std::unique_ptr<WebviewFrameExporter>> m_exporters;
+	    std::unordered_map<int, std::unique_ptr<WebviewFrameRecorder>> m_recorders;
+	    // Encodes captureFrame snapshots off the paint thread.
+	    std::unique_ptr<WebviewFrameCapture> m_capture;
+	    std::unique_ptr<WebviewThumbnailCache> m_thumbnails;
+	    // Input replay and paints use these on the CEF UI thread, which is not
+	    // the platform thread on Windows; m_inputMutex guards both maps and
+	    // the recorders.
+	    std::mutex m_inputMutex;
+	    std::unordered_map<int, std::shared_ptr<WebviewPaintStats>> m_paintStats;
+	    std::unordered_map<int, std::unique_ptr<WebviewInputRecorder>> m_inputRecorders;
+	    std::thread m_benchmarkThread;
+	    std::atomic<bool> m_benchmarkRunning{false};
 	    bool m_init = false;
     };
 
@@ -40,7 +144,33 @@ namespace webview_cef {
     void initCEFProcesses();
     void startCEF();
     void doMessageLoopWork();
+    // Frames (or damage) of at least this many pixels are converted in row
+    // stripes on WebviewWorkerPool::shared(). The default (about a quarter of
+    // a 1080p frame) is a starting point, not a measured crossover: it
+    // depends on core count and memory bandwidth, so run conversionBenchmark
+    // on the target machine and tune it with setParallelConversionThreshold.
+    const size_t kDefaultParallelConversionThreshold = 512 * 1024;
+    void setParallelConversionThreshold(size_t pixels);
+    size_t getParallelConversionThreshold();
+    struct ConversionBenchmarkResult {
+        // Size of the converted region; with |damage| it is a rect converted
+        // through SwapDirtyRectsFromBgraToRgba in a 3840x2160 frame.
+        int width = 0;
+        int height = 0;
+        bool damage = false;
+        double singleMilliseconds = 0;
+        double parallelMilliseconds = 0;
+    };
+    // Times conversion single-threaded and striped, for full frames at common
+    // resolutions and for damage of 64K to 2M pixels, to find the crossover
+    // for the threshold above. Takes seconds; call it off the UI thread.
+    std::vector<ConversionBenchmarkResult> benchmarkFrameConversion(int iterations);
     void SwapBufferFromBgraToRgba(void* _dest, const void* _src, int width, int height);
+    CefRect IntersectRect(const CefRect& a, const CefRect& b);
+    CefRect UnionRect(const CefRect& a, const CefRect& b);
+    // Converts only frame.dirtyRects into |_dest|, a persistent RGBA surface of
+    // the same size and stride as the frame.
+    void SwapDirtyRectsFromBgraToRgba(void* _dest, const WebviewFrame& frame);
     void stopCEF();
 }
 
@@ -0,0 +1,61 @@
+#include "webview_render_stats.h"
+
+namespace webview_cef
+{
+	void WebviewDurationHistogram::record(std::chrono::steady_clock::duration duration)
+	{
+		const int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+		const uint64_t value = micros > 0 ? (uint64_t)micros : 0;
+		int bucket = 0;
+		while (bucket < kBuckets - 1 && (value >> (bucket + 1)) != 0)
+		{
+			bucket++;
+		}
+		buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+		totalMicros_.fetch_add(value, std::memory_order_relaxed);
+		uint64_t max = maxMicros_.load(std::memory_order_relaxed);
+		while (value > max && !maxMicros_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	WebviewDurationHistogram::Snapshot WebviewDurationHistogram::snapshot() const
+	{
+		// The fields are read one by one, so a snapshot taken while paints
+		// are recorded may be off by the paints in flight.
+		Snapshot snapshot;
+		uint64_t total = 0;
+		for (int i = 0; i < kBuckets; i++)
+		{
+			snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+			total += snapshot.buckets[i];
+		}
+		snapshot.count = total;
+		snapshot.maxMs = maxMicros_.load(std::memory_order_relaxed) / 1000.0;
+		if (total == 0)
+		{
+			return snapshot;
+		}
+		snapshot.meanMs = totalMicros_.load(std::memory_order_relaxed) / 1000.0 / total;
+
+		const double ranks[3] = {0.5, 0.95, 0.99};
+		double *results[3] = {&snapshot.p50Ms, &snapshot.p95Ms, &snapshot.p99Ms};
+		for (int p = 0; p < 3; p++)
+		{
+			const uint64_t rank = (uint64_t)(ranks[p] * (total - 1)) + 1;
+			uint64_t seen = 0;
+			int bucket = 0;
+			for (; bucket < kBuckets - 1; bucket++)
+			{
+				seen += snapshot.buckets[bucket];
+				if (seen >= rank)
+				{
+					break;
+				}
+			}
+			const double upper = (double)(2ULL << bucket) / 1000.0;
+			*results[p] = bucket == kBuckets - 1 || upper > snapshot.maxMs ? snapshot.maxMs : upper;
+		}
+		return snapshot;
+	}
+}
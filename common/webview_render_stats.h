@@ -0,0 +1,78 @@
+#ifndef WEBVIEW_RENDER_STATS_H
+#define WEBVIEW_RENDER_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace webview_cef {
+    // Durations in power-of-two microsecond buckets: bucket i counts
+    // [2^i, 2^(i+1)) us, the first one also anything shorter and the last
+    // one anything longer. Recording is lock-free, so it can be done on the
+    // paint and raster threads while another thread takes snapshots.
+    class WebviewDurationHistogram {
+    public:
+        static constexpr int kBuckets = 20;
+
+        struct Snapshot {
+            uint64_t count = 0;
+            double meanMs = 0;
+            double maxMs = 0;
+            // Upper bounds of the buckets the percentiles fall in.
+            double p50Ms = 0;
+            double p95Ms = 0;
+            double p99Ms = 0;
+            uint64_t buckets[kBuckets] = {};
+        };
+
+        void record(std::chrono::steady_clock::duration duration);
+        Snapshot snapshot() const;
+
+    private:
+        std::atomic<uint64_t> buckets_[kBuckets] = {};
+        std::atomic<uint64_t> totalMicros_{0};
+        std::atomic<uint64_t> maxMicros_{0};
+    };
+
+    // Paints of one browser as seen by the plugin's paint callback. Updated
+    // on the CEF UI thread, readable from any thread.
+    struct WebviewPaintStats {
+        std::atomic<uint64_t> paints{0};
+        std::atomic<uint64_t> dirtyPixels{0};
+        // Time spent handing a paint to the texture and the other frame
+        // sinks; includes the conversion unless it is deferred.
+        WebviewDurationHistogram paintTime;
+
+        // Oldest input batch sent since the last paint and its sequence
+        // number. The next paint is taken to be the one answering it.
+        std::mutex inputMutex;
+        std::chrono::steady_clock::time_point pendingInputTime;
+        int64_t pendingInputSequence = 0;
+        // Last batch received, and last batch a paint answered.
+        std::atomic<int64_t> inputSequence{0};
+        std::atomic<int64_t> paintedInputSequence{0};
+        WebviewDurationHistogram inputToPaint;
+        // From Dart sending a batch to the plugin receiving it.
+        WebviewDurationHistogram inputDelivery;
+
+        // Frame rates are measured since the consumer's previous read. Each
+        // consumer (getRenderStats, the periodic push and the replay
+        // summary) has its own window, so one does not shorten another's.
+        // All of them read on the platform thread.
+        enum Consumer {
+            kQuery,
+            kPush,
+            kReplay,
+            kConsumers,
+        };
+        struct RateWindow {
+            std::chrono::steady_clock::time_point time;
+            uint64_t paints = 0;
+            uint64_t presented = 0;
+        };
+        RateWindow rateWindows[kConsumers];
+    };
+}
+
+#endif //WEBVIEW_RENDER_STATS_H
@@ -0,0 +1,538 @@
+#include "webview_swizzle.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define WEBVIEW_SWIZZLE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define WEBVIEW_SWIZZLE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit SIMD instructions for functions that opt in, so the
+// kernels are compiled for their ISA and picked at runtime. MSVC always allows
+// the intrinsics.
+#if defined(WEBVIEW_SWIZZLE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define WEBVIEW_TARGET(isa) __attribute__((target(isa)))
+#else
+#define WEBVIEW_TARGET(isa)
+#endif
+
+namespace webview_cef
+{
+	static void swizzleScalar(void *_dest, const void *_src, size_t count)
+	{
+		uint32_t *dest = (uint32_t *)_dest;
+		const uint32_t *src = (const uint32_t *)_src;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t bgra = src[i];
+			// BGRA in hex = 0xAARRGGBB.
+			dest[i] = (bgra & 0x00ff0000) >> 16	 // Red >> Blue.
+					  | (bgra & 0xff00ff00)		 // Green Alpha.
+					  | (bgra & 0x000000ff) << 16; // Blue >> Red.
+		}
+	}
+
+#ifdef WEBVIEW_SWIZZLE_X86
+	WEBVIEW_TARGET("ssse3")
+	static void swizzleSSSE3(void *_dest, const void *_src, size_t count)
+	{
+		uint8_t *dest = (uint8_t *)_dest;
+		const uint8_t *src = (const uint8_t *)_src;
+		const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i *)(src + i * 4));
+			__m128i b = _mm_loadu_si128((const __m128i *)(src + i * 4 + 16));
+			__m128i c = _mm_loadu_si128((const __m128i *)(src + i * 4 + 32));
+			__m128i d = _mm_loadu_si128((const __m128i *)(src + i * 4 + 48));
+			_mm_storeu_si128((__m128i *)(dest + i * 4), _mm_shuffle_epi8(a, mask));
+			_mm_storeu_si128((__m128i *)(dest + i * 4 + 16), _mm_shuffle_epi8(b, mask));
+			_mm_storeu_si128((__m128i *)(dest + i * 4 + 32), _mm_shuffle_epi8(c, mask));
+			_mm_storeu_si128((__m128i *)(dest + i * 4 + 48), _mm_shuffle_epi8(d, mask));
+		}
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i *)(src + i * 4));
+			_mm_storeu_si128((__m128i *)(dest + i * 4), _mm_shuffle_epi8(a, mask));
+		}
+		swizzleScalar(dest + i * 4, src + i * 4, count - i);
+	}
+
+	WEBVIEW_TARGET("avx2")
+	static void swizzleAVX2(void *_dest, const void *_src, size_t count)
+	{
+		uint8_t *dest = (uint8_t *)_dest;
+		const uint8_t *src = (const uint8_t *)_src;
+		// vpshufb shuffles within each 128-bit lane, so the mask is repeated.
+		const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+											  2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+			__m256i b = _mm256_loadu_si256((const __m256i *)(src + i * 4 + 32));
+			__m256i c = _mm256_loadu_si256((const __m256i *)(src + i * 4 + 64));
+			__m256i d = _mm256_loadu_si256((const __m256i *)(src + i * 4 + 96));
+			_mm256_storeu_si256((__m256i *)(dest + i * 4), _mm256_shuffle_epi8(a, mask));
+			_mm256_storeu_si256((__m256i *)(dest + i * 4 + 32), _mm256_shuffle_epi8(b, mask));
+			_mm256_storeu_si256((__m256i *)(dest + i * 4 + 64), _mm256_shuffle_epi8(c, mask));
+			_mm256_storeu_si256((__m256i *)(dest + i * 4 + 96), _mm256_shuffle_epi8(d, mask));
+		}
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+			_mm256_storeu_si256((__m256i *)(dest + i * 4), _mm256_shuffle_epi8(a, mask));
+		}
+		swizzleScalar(dest + i * 4, src + i * 4, count - i);
+	}
+
+	static bool cpuSupports(SwizzleKernel kernel)
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool ssse3 = (info[2] & (1 << 9)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (kernel == kSwizzleSSSE3)
+		{
+			return ssse3;
+		}
+		if (maxLeaf < 7 || !osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		if (kernel == kSwizzleSSSE3)
+		{
+			return __builtin_cpu_supports("ssse3");
+		}
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+#ifdef WEBVIEW_SWIZZLE_NEON
+	static void swizzleNEON(void *_dest, const void *_src, size_t count)
+	{
+		uint8_t *dest = (uint8_t *)_dest;
+		const uint8_t *src = (const uint8_t *)_src;
+		size_t i = 0;
+		// vld4 de-interleaves the channels, so the swap is just a register rename.
+		for (; i + 16 <= count; i += 16)
+		{
+			uint8x16x4_t px = vld4q_u8(src + i * 4);
+			uint8x16_t blue = px.val[0];
+			px.val[0] = px.val[2];
+			px.val[2] = blue;
+			vst4q_u8(dest + i * 4, px);
+		}
+		for (; i + 8 <= count; i += 8)
+		{
+			uint8x8x4_t px = vld4_u8(src + i * 4);
+			uint8x8_t blue = px.val[0];
+			px.val[0] = px.val[2];
+			px.val[2] = blue;
+			vst4_u8(dest + i * 4, px);
+		}
+		swizzleScalar(dest + i * 4, src + i * 4, count - i);
+	}
+#endif
+
+	// I420 kernels use BT.601 limited range coefficients in 7 bits for
+	// luma and 8 bits for chroma, so the SIMD and scalar paths round alike.
+	static inline uint8_t lumaOf(const uint8_t *p)
+	{
+		return (uint8_t)((13 * p[0] + 64 * p[1] + 33 * p[2] + 0x840) >> 7);
+	}
+
+	// Converts pixels [from, width) of a row pair. |row1| is |row0| and |y1|
+	// is nullptr for the last row of an odd height image.
+	static void i420RowsScalar(const uint8_t *row0, const uint8_t *row1, int from, int width,
+							   uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v)
+	{
+		for (int x = from; x < width; x += 2)
+		{
+			const int next = x + 1 < width ? x + 1 : x;
+			y0[x] = lumaOf(row0 + x * 4);
+			y0[next] = lumaOf(row0 + next * 4);
+			if (y1 != nullptr)
+			{
+				y1[x] = lumaOf(row1 + x * 4);
+				y1[next] = lumaOf(row1 + next * 4);
+			}
+			int avg[3];
+			for (int c = 0; c < 3; c++)
+			{
+				const int left = (row0[x * 4 + c] + row1[x * 4 + c] + 1) >> 1;
+				const int right = (row0[next * 4 + c] + row1[next * 4 + c] + 1) >> 1;
+				avg[c] = (left + right + 1) >> 1;
+			}
+			u[x / 2] = (uint8_t)(((112 * avg[0] - 74 * avg[1] - 38 * avg[2] + 128) >> 8) + 128);
+			v[x / 2] = (uint8_t)(((-18 * avg[0] - 94 * avg[1] + 112 * avg[2] + 128) >> 8) + 128);
+		}
+	}
+
+#ifdef WEBVIEW_SWIZZLE_X86
+	WEBVIEW_TARGET("ssse3")
+	static inline __m128i lumaSSSE3(const __m128i *px, __m128i coeffs, __m128i bias)
+	{
+		__m128i lo = _mm_hadd_epi16(_mm_maddubs_epi16(px[0], coeffs), _mm_maddubs_epi16(px[1], coeffs));
+		__m128i hi = _mm_hadd_epi16(_mm_maddubs_epi16(px[2], coeffs), _mm_maddubs_epi16(px[3], coeffs));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, bias), 7);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, bias), 7);
+		return _mm_packus_epi16(lo, hi);
+	}
+
+	// Averages horizontal neighbours of 8 pixels, giving 4 chroma pixels.
+	WEBVIEW_TARGET("ssse3")
+	static inline __m128i halveSSSE3(__m128i a, __m128i b)
+	{
+		__m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0x88));
+		__m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0xdd));
+		return _mm_avg_epu8(even, odd);
+	}
+
+	// Converts whole blocks of 16 pixels and returns how many were done.
+	WEBVIEW_TARGET("ssse3")
+	static int i420RowsSSSE3(const uint8_t *row0, const uint8_t *row1, int width,
+							 uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v)
+	{
+		const __m128i kY = _mm_setr_epi8(13, 64, 33, 0, 13, 64, 33, 0, 13, 64, 33, 0, 13, 64, 33, 0);
+		const __m128i kU = _mm_setr_epi8(112, -74, -38, 0, 112, -74, -38, 0, 112, -74, -38, 0, 112, -74, -38, 0);
+		const __m128i kV = _mm_setr_epi8(-18, -94, 112, 0, -18, -94, 112, 0, -18, -94, 112, 0, -18, -94, 112, 0);
+		const __m128i kYBias = _mm_set1_epi16(0x840);
+		const __m128i kUVRound = _mm_set1_epi16(128);
+		const __m128i kUVBias = _mm_set1_epi8((char)0x80);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i top[4];
+			__m128i bottom[4];
+			for (int k = 0; k < 4; k++)
+			{
+				top[k] = _mm_loadu_si128((const __m128i *)(row0 + x * 4 + k * 16));
+				bottom[k] = _mm_loadu_si128((const __m128i *)(row1 + x * 4 + k * 16));
+			}
+			_mm_storeu_si128((__m128i *)(y0 + x), lumaSSSE3(top, kY, kYBias));
+			if (y1 != nullptr)
+			{
+				_mm_storeu_si128((__m128i *)(y1 + x), lumaSSSE3(bottom, kY, kYBias));
+			}
+
+			__m128i c0 = halveSSSE3(_mm_avg_epu8(top[0], bottom[0]), _mm_avg_epu8(top[1], bottom[1]));
+			__m128i c1 = halveSSSE3(_mm_avg_epu8(top[2], bottom[2]), _mm_avg_epu8(top[3], bottom[3]));
+			__m128i us = _mm_hadd_epi16(_mm_maddubs_epi16(c0, kU), _mm_maddubs_epi16(c1, kU));
+			__m128i vs = _mm_hadd_epi16(_mm_maddubs_epi16(c0, kV), _mm_maddubs_epi16(c1, kV));
+			us = _mm_srai_epi16(_mm_add_epi16(us, kUVRound), 8);
+			vs = _mm_srai_epi16(_mm_add_epi16(vs, kUVRound), 8);
+			__m128i uv = _mm_add_epi8(_mm_packs_epi16(us, vs), kUVBias);
+			_mm_storel_epi64((__m128i *)(u + x / 2), uv);
+			_mm_storel_epi64((__m128i *)(v + x / 2), _mm_srli_si128(uv, 8));
+		}
+		return x;
+	}
+
+	// Halves whole blocks of 8 output pixels and returns how many were done.
+	WEBVIEW_TARGET("ssse3")
+	static int halveRowSSSE3(const uint8_t *row0, const uint8_t *row1, int width, uint8_t *dest)
+	{
+		int x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i top[4];
+			__m128i bottom[4];
+			for (int k = 0; k < 4; k++)
+			{
+				top[k] = _mm_loadu_si128((const __m128i *)(row0 + x * 8 + k * 16));
+				bottom[k] = _mm_loadu_si128((const __m128i *)(row1 + x * 8 + k * 16));
+			}
+			_mm_storeu_si128((__m128i *)(dest + x * 4),
+							 halveSSSE3(_mm_avg_epu8(top[0], bottom[0]), _mm_avg_epu8(top[1], bottom[1])));
+			_mm_storeu_si128((__m128i *)(dest + x * 4 + 16),
+							 halveSSSE3(_mm_avg_epu8(top[2], bottom[2]), _mm_avg_epu8(top[3], bottom[3])));
+		}
+		return x;
+	}
+
+	// Diffs whole blocks of 4 pixels and returns how many were done.
+	WEBVIEW_TARGET("ssse3")
+	static size_t diffPixelsSSSE3(const uint8_t *expected, const uint8_t *actual, size_t count, int tolerance,
+								  uint8_t *highlight, PixelDiffStats &stats)
+	{
+		// Number of clear bits in a 4-bit movemask.
+		static const uint8_t kOutside[16] = {4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0};
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i white = _mm_set1_epi8((char)0xff);
+		const __m128i red = _mm_set1_epi32((int)0xff0000ff);
+		const __m128i tol = _mm_set1_epi8((char)tolerance);
+		__m128i maxDelta = zero;
+		__m128i deltaSum = zero;
+		uint64_t differing = 0;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i *)(expected + i * 4));
+			const __m128i b = _mm_loadu_si128((const __m128i *)(actual + i * 4));
+			const __m128i delta = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+			maxDelta = _mm_max_epu8(maxDelta, delta);
+			deltaSum = _mm_add_epi64(deltaSum, _mm_sad_epu8(delta, zero));
+			// All ones for pixels whose channels are all within tolerance.
+			const __m128i within = _mm_cmpeq_epi32(_mm_subs_epu8(delta, tol), zero);
+			differing += kOutside[_mm_movemask_ps(_mm_castsi128_ps(within))];
+			if (highlight != nullptr)
+			{
+				const __m128i faded = _mm_avg_epu8(b, white);
+				_mm_storeu_si128((__m128i *)(highlight + i * 4),
+								 _mm_or_si128(_mm_and_si128(within, faded), _mm_andnot_si128(within, red)));
+			}
+		}
+		uint8_t lanes[16];
+		_mm_storeu_si128((__m128i *)lanes, maxDelta);
+		for (uint8_t lane : lanes)
+		{
+			stats.maxDelta = std::max(stats.maxDelta, (int)lane);
+		}
+		uint64_t sums[2];
+		_mm_storeu_si128((__m128i *)sums, deltaSum);
+		stats.deltaSum += sums[0] + sums[1];
+		stats.differingPixels += differing;
+		return i;
+	}
+#endif
+
+	const char *getSwizzleKernelName(SwizzleKernel kernel)
+	{
+		switch (kernel)
+		{
+		case kSwizzleScalar:
+			return "scalar";
+		case kSwizzleSSSE3:
+			return "ssse3";
+		case kSwizzleAVX2:
+			return "avx2";
+		case kSwizzleNEON:
+			return "neon";
+		default:
+			return "unknown";
+		}
+	}
+
+	SwizzleFunc getSwizzleFunc(SwizzleKernel kernel)
+	{
+		switch (kernel)
+		{
+		case kSwizzleScalar:
+			return swizzleScalar;
+#ifdef WEBVIEW_SWIZZLE_X86
+		case kSwizzleSSSE3:
+			return cpuSupports(kSwizzleSSSE3) ? swizzleSSSE3 : nullptr;
+		case kSwizzleAVX2:
+			return cpuSupports(kSwizzleAVX2) ? swizzleAVX2 : nullptr;
+#endif
+#ifdef WEBVIEW_SWIZZLE_NEON
+		case kSwizzleNEON:
+			return swizzleNEON;
+#endif
+		default:
+			return nullptr;
+		}
+	}
+
+	static SwizzleKernel detectSwizzleKernel()
+	{
+		const SwizzleKernel preferred[] = {kSwizzleAVX2, kSwizzleNEON, kSwizzleSSSE3};
+		for (SwizzleKernel kernel : preferred)
+		{
+			if (getSwizzleFunc(kernel) != nullptr)
+			{
+				return kernel;
+			}
+		}
+		return kSwizzleScalar;
+	}
+
+	static std::atomic<int> activeKernel{-1};
+	static std::atomic<SwizzleFunc> activeFunc{nullptr};
+
+	SwizzleKernel getActiveSwizzleKernel()
+	{
+		int kernel = activeKernel.load(std::memory_order_acquire);
+		if (kernel < 0)
+		{
+			setActiveSwizzleKernel(detectSwizzleKernel());
+			kernel = activeKernel.load(std::memory_order_acquire);
+		}
+		return (SwizzleKernel)kernel;
+	}
+
+	void setActiveSwizzleKernel(SwizzleKernel kernel)
+	{
+		SwizzleFunc func = getSwizzleFunc(kernel);
+		if (func == nullptr)
+		{
+			return;
+		}
+		activeFunc.store(func, std::memory_order_release);
+		activeKernel.store(kernel, std::memory_order_release);
+	}
+
+	void swizzleBgraToRgba(void *dest, const void *src, size_t count)
+	{
+		SwizzleFunc func = activeFunc.load(std::memory_order_acquire);
+		if (func == nullptr)
+		{
+			getActiveSwizzleKernel();
+			func = activeFunc.load(std::memory_order_acquire);
+		}
+		func(dest, src, count);
+	}
+
+	std::vector<SwizzleBenchmarkResult> benchmarkSwizzleKernels(int width, int height, int iterations)
+	{
+		std::vector<SwizzleBenchmarkResult> results;
+		if (width <= 0 || height <= 0 || iterations <= 0)
+		{
+			return results;
+		}
+		const size_t count = (size_t)width * height;
+		std::vector<uint32_t> src(count);
+		std::vector<uint32_t> dest(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			src[i] = (uint32_t)(i * 2654435761u);
+		}
+
+		for (int k = 0; k < kSwizzleKernelCount; k++)
+		{
+			SwizzleFunc func = getSwizzleFunc((SwizzleKernel)k);
+			if (func == nullptr)
+			{
+				continue;
+			}
+			// Warm up caches and page in the destination before timing.
+			func(dest.data(), src.data(), count);
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				func(dest.data(), src.data(), count);
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			double bytes = (double)count * 4 * iterations;
+			results.push_back({(SwizzleKernel)k, elapsed.count() > 0 ? bytes / elapsed.count() / 1e9 : 0});
+		}
+		return results;
+	}
+
+	void convertBgraToI420(const uint8_t *src, int srcStride, int width, int height,
+						   uint8_t *y, uint8_t *u, uint8_t *v)
+	{
+#ifdef WEBVIEW_SWIZZLE_X86
+		const SwizzleKernel kernel = getActiveSwizzleKernel();
+		const bool simd = kernel == kSwizzleSSSE3 || kernel == kSwizzleAVX2;
+#endif
+		const int chromaWidth = (width + 1) / 2;
+		for (int row = 0; row < height; row += 2)
+		{
+			const bool pair = row + 1 < height;
+			const uint8_t *row0 = src + (size_t)row * srcStride;
+			const uint8_t *row1 = pair ? row0 + srcStride : row0;
+			uint8_t *y0 = y + (size_t)row * width;
+			uint8_t *y1 = pair ? y0 + width : nullptr;
+			uint8_t *uRow = u + (size_t)(row / 2) * chromaWidth;
+			uint8_t *vRow = v + (size_t)(row / 2) * chromaWidth;
+			int x = 0;
+#ifdef WEBVIEW_SWIZZLE_X86
+			if (simd)
+			{
+				x = i420RowsSSSE3(row0, row1, width, y0, y1, uRow, vRow);
+			}
+#endif
+			i420RowsScalar(row0, row1, x, width, y0, y1, uRow, vRow);
+		}
+	}
+
+	void halveImage(const uint8_t *src, int srcStride, int width, int height, uint8_t *dest)
+	{
+#ifdef WEBVIEW_SWIZZLE_X86
+		const SwizzleKernel kernel = getActiveSwizzleKernel();
+		const bool simd = kernel == kSwizzleSSSE3 || kernel == kSwizzleAVX2;
+#endif
+		const int halfWidth = width / 2;
+		const int halfHeight = height / 2;
+		for (int row = 0; row < halfHeight; row++)
+		{
+			const uint8_t *row0 = src + (size_t)row * 2 * srcStride;
+			const uint8_t *row1 = row0 + srcStride;
+			uint8_t *out = dest + (size_t)row * halfWidth * 4;
+			int x = 0;
+#ifdef WEBVIEW_SWIZZLE_X86
+			if (simd)
+			{
+				x = halveRowSSSE3(row0, row1, halfWidth, out);
+			}
+#endif
+			// Same rounding as the SIMD path: rows first, then columns.
+			for (; x < halfWidth; x++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					const int left = (row0[x * 8 + c] + row1[x * 8 + c] + 1) >> 1;
+					const int right = (row0[x * 8 + 4 + c] + row1[x * 8 + 4 + c] + 1) >> 1;
+					out[x * 4 + c] = (uint8_t)((left + right + 1) >> 1);
+				}
+			}
+		}
+	}
+
+	void diffPixels(const uint8_t *expected, const uint8_t *actual, size_t count, int tolerance,
+					uint8_t *highlight, PixelDiffStats &stats)
+	{
+		tolerance = std::min(std::max(tolerance, 0), 255);
+		size_t i = 0;
+#ifdef WEBVIEW_SWIZZLE_X86
+		const SwizzleKernel kernel = getActiveSwizzleKernel();
+		if (kernel == kSwizzleSSSE3 || kernel == kSwizzleAVX2)
+		{
+			i = diffPixelsSSSE3(expected, actual, count, tolerance, highlight, stats);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			const uint8_t *a = expected + i * 4;
+			const uint8_t *b = actual + i * 4;
+			bool differs = false;
+			for (int c = 0; c < 4; c++)
+			{
+				const int delta = std::abs(a[c] - b[c]);
+				stats.maxDelta = std::max(stats.maxDelta, delta);
+				stats.deltaSum += delta;
+				differs |= delta > tolerance;
+			}
+			stats.differingPixels += differs;
+			if (highlight != nullptr)
+			{
+				uint8_t *out = highlight + i * 4;
+				for (int c = 0; c < 4; c++)
+				{
+					out[c] = differs ? (c == 0 || c == 3 ? 0xff : 0) : (uint8_t)((b[c] + 256) >> 1);
+				}
+			}
+		}
+	}
+}
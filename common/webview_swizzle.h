@@ -0,0 +1,70 @@
+#ifndef WEBVIEW_SWIZZLE_H
+#define WEBVIEW_SWIZZLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace webview_cef {
+    // Converts |count| BGRA pixels from |src| to RGBA in |dest|. |dest| and
+    // |src| may alias but must not partially overlap.
+    typedef void (*SwizzleFunc)(void* dest, const void* src, size_t count);
+
+    enum SwizzleKernel {
+        kSwizzleScalar = 0,
+        kSwizzleSSSE3,
+        kSwizzleAVX2,
+        kSwizzleNEON,
+        kSwizzleKernelCount,
+    };
+
+    struct SwizzleBenchmarkResult {
+        SwizzleKernel kernel;
+        double gigabytesPerSecond;
+    };
+
+    const char* getSwizzleKernelName(SwizzleKernel kernel);
+    // Returns nullptr when |kernel| is not compiled in or not supported by the CPU.
+    SwizzleFunc getSwizzleFunc(SwizzleKernel kernel);
+    // The fastest kernel supported by the running CPU, detected once.
+    SwizzleKernel getActiveSwizzleKernel();
+    // Forces a kernel (e.g. kSwizzleScalar for correctness checks). Ignored if
+    // the kernel is not supported.
+    void setActiveSwizzleKernel(SwizzleKernel kernel);
+
+    void swizzleBgraToRgba(void* dest, const void* src, size_t count);
+    // Times every supported kernel on a width x height frame.
+    std::vector<SwizzleBenchmarkResult> benchmarkSwizzleKernels(int width, int height, int iterations);
+
+    // Converts a width x height BGRA image to I420 (BT.601, limited range),
+    // ignoring alpha. The planes are tightly packed: |y| is width x height,
+    // |u| and |v| are (width + 1) / 2 x (height + 1) / 2, each chroma sample
+    // being the average of a 2x2 block. Uses SSSE3 when the active swizzle
+    // kernel is SSSE3 or AVX2.
+    void convertBgraToI420(const uint8_t* src, int srcStride, int width, int height,
+                           uint8_t* y, uint8_t* u, uint8_t* v);
+
+    // Halves a width x height 4-byte-per-pixel image by averaging 2x2 blocks
+    // into a tightly packed (width / 2) x (height / 2) image. An odd last
+    // row or column is dropped. Uses SSSE3 under the same conditions as
+    // convertBgraToI420.
+    void halveImage(const uint8_t* src, int srcStride, int width, int height, uint8_t* dest);
+
+    struct PixelDiffStats {
+        // Pixels with a channel more than the tolerance apart.
+        uint64_t differingPixels = 0;
+        // Largest and summed absolute channel differences.
+        int maxDelta = 0;
+        uint64_t deltaSum = 0;
+    };
+
+    // Compares |count| RGBA pixels channel by channel and adds the result to
+    // |stats|. When |highlight| is not null it receives |actual| faded
+    // towards white, with the differing pixels painted opaque red. Uses SSSE3
+    // under the same conditions as convertBgraToI420.
+    void diffPixels(const uint8_t* expected, const uint8_t* actual, size_t count, int tolerance,
+                    uint8_t* highlight, PixelDiffStats& stats);
+}
+
+#endif //WEBVIEW_SWIZZLE_H
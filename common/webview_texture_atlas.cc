@@ -0,0 +1,314 @@
+#include "webview_texture_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace webview_cef
+{
+	namespace
+	{
+		// Stands in for a browser's own texture: paints go to its atlas slot
+		// and Flutter sees the atlas texture id.
+		class WebviewAtlasSlotTexture : public WebviewTexture
+		{
+		public:
+			WebviewAtlasSlotTexture(std::shared_ptr<WebviewTextureAtlas> atlas, int browserId)
+				: atlas_(atlas), browserId_(browserId)
+			{
+				textureId = atlas->textureId();
+			}
+
+			virtual ~WebviewAtlasSlotTexture()
+			{
+				if (auto atlas = atlas_.lock())
+				{
+					atlas->release(browserId_);
+				}
+			}
+
+			virtual void onFrame(const WebviewFrame &frame) override
+			{
+				if (auto atlas = atlas_.lock())
+				{
+					atlas->update(browserId_, frame);
+				}
+			}
+
+			virtual WebviewFramePool *framePool() override
+			{
+				auto atlas = atlas_.lock();
+				return atlas ? atlas->framePool() : nullptr;
+			}
+
+		private:
+			std::weak_ptr<WebviewTextureAtlas> atlas_;
+			int browserId_;
+		};
+
+		void copyRows(uint8_t *dest, int destStride, const CefRect &destRect, const uint8_t *src, int srcStride, int srcX, int srcY)
+		{
+			for (int row = 0; row < destRect.height; row++)
+			{
+				memcpy(dest + (size_t)(destRect.y + row) * destStride + (size_t)destRect.x * 4,
+					   src + (size_t)(srcY + row) * srcStride + (size_t)srcX * 4,
+					   (size_t)destRect.width * 4);
+			}
+		}
+	}
+
+	WebviewTextureAtlas::WebviewTextureAtlas(std::shared_ptr<WebviewTexture> target) : target_(target)
+	{
+	}
+
+	std::shared_ptr<WebviewTexture> WebviewTextureAtlas::createSlotTexture(int browserId)
+	{
+		return std::make_shared<WebviewAtlasSlotTexture>(shared_from_this(), browserId);
+	}
+
+	bool WebviewTextureAtlas::getSlot(int browserId, CefRect &slot, int &atlasWidth, int &atlasHeight)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = slots_.find(browserId);
+		if (it == slots_.end())
+		{
+			return false;
+		}
+		slot = it->second;
+		atlasWidth = width_;
+		atlasHeight = height_;
+		return true;
+	}
+
+	void WebviewTextureAtlas::update(int browserId, const WebviewFrame &frame)
+	{
+		if (frame.buffer == nullptr || frame.width <= 0 || frame.height <= 0)
+		{
+			return;
+		}
+		std::vector<int> moved;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = slots_.find(browserId);
+			const bool placed = it == slots_.end() || it->second.width != frame.width || it->second.height != frame.height;
+			if (placed && !allocate(browserId, frame.width, frame.height, moved))
+			{
+				std::cerr << "Texture atlas cannot fit a " << frame.width << "x" << frame.height << " webview" << std::endl;
+				return;
+			}
+			const CefRect slot = slots_[browserId];
+			const int stride = width_ * 4;
+
+			WebviewFrame atlasFrame;
+			atlasFrame.buffer = composite_.data();
+			atlasFrame.width = width_;
+			atlasFrame.height = height_;
+			atlasFrame.stride = stride;
+			for (int id : moved)
+			{
+				atlasFrame.dirtyRects.push_back(slots_[id]);
+			}
+			if (placed)
+			{
+				copyRows(composite_.data(), stride, slot, (const uint8_t *)frame.buffer, frame.stride, 0, 0);
+			}
+			else
+			{
+				const CefRect bounds(0, 0, frame.width, frame.height);
+				for (const CefRect &dirty : frame.dirtyRects)
+				{
+					CefRect rect = IntersectRect(dirty, bounds);
+					if (rect.IsEmpty())
+					{
+						continue;
+					}
+					CefRect dest(slot.x + rect.x, slot.y + rect.y, rect.width, rect.height);
+					copyRows(composite_.data(), stride, dest, (const uint8_t *)frame.buffer, frame.stride, rect.x, rect.y);
+					atlasFrame.dirtyRects.push_back(dest);
+				}
+			}
+			// The pool reads the composite synchronously, so it must not change
+			// underneath it.
+			target_->onFrame(atlasFrame);
+		}
+		if (onSlotChanged)
+		{
+			for (int id : moved)
+			{
+				onSlotChanged(id);
+			}
+		}
+	}
+
+	void WebviewTextureAtlas::release(int browserId)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = slots_.find(browserId);
+		if (it == slots_.end())
+		{
+			return;
+		}
+		const CefRect freed = it->second;
+		slots_.erase(it);
+		if (slots_.empty())
+		{
+			// Start over small rather than keep uploading an empty atlas.
+			composite_.clear();
+			composite_.shrink_to_fit();
+			shelves_.clear();
+			width_ = height_ = 0;
+			return;
+		}
+		reclaim(freed);
+	}
+
+	void WebviewTextureAtlas::reclaim(const CefRect &freed)
+	{
+		for (Shelf &shelf : shelves_)
+		{
+			if (shelf.y != freed.y)
+			{
+				continue;
+			}
+			int nextX = 0;
+			for (const auto &entry : slots_)
+			{
+				if (entry.second.y == shelf.y)
+				{
+					nextX = std::max(nextX, entry.second.x + entry.second.width + kPadding);
+				}
+			}
+			shelf.nextX = nextX;
+			break;
+		}
+		while (!shelves_.empty() && shelves_.back().nextX == 0)
+		{
+			shelves_.pop_back();
+		}
+	}
+
+	bool WebviewTextureAtlas::allocate(int browserId, int width, int height, std::vector<int> &moved)
+	{
+		auto it = slots_.find(browserId);
+		if (it != slots_.end())
+		{
+			const CefRect freed = it->second;
+			slots_.erase(it);
+			reclaim(freed);
+		}
+		CefRect slot;
+		if (width_ > 0 && placeOnShelf(width, height, slot))
+		{
+			slots_[browserId] = slot;
+			moved.push_back(browserId);
+			return true;
+		}
+
+		slots_[browserId] = CefRect(0, 0, width, height);
+		int atlasWidth = std::max(width_, kInitialSize);
+		int atlasHeight = std::max(height_, kInitialSize);
+		while (!repack(atlasWidth, atlasHeight, moved))
+		{
+			if (atlasWidth >= kMaxSize && atlasHeight >= kMaxSize)
+			{
+				slots_.erase(browserId);
+				return false;
+			}
+			if ((atlasWidth <= atlasHeight && atlasWidth < kMaxSize) || atlasHeight >= kMaxSize)
+			{
+				atlasWidth *= 2;
+			}
+			else
+			{
+				atlasHeight *= 2;
+			}
+		}
+		// The new slot's old rect was only a size placeholder.
+		if (std::find(moved.begin(), moved.end(), browserId) == moved.end())
+		{
+			moved.push_back(browserId);
+		}
+		return true;
+	}
+
+	bool WebviewTextureAtlas::placeOnShelf(int width, int height, CefRect &slot)
+	{
+		const int paddedWidth = width + kPadding;
+		const int paddedHeight = height + kPadding;
+		// Best fit: the lowest shelf that is tall enough and has room left.
+		Shelf *best = nullptr;
+		for (Shelf &shelf : shelves_)
+		{
+			if (paddedHeight <= shelf.height && shelf.nextX + paddedWidth <= width_ && (best == nullptr || shelf.height < best->height))
+			{
+				best = &shelf;
+			}
+		}
+		if (best == nullptr)
+		{
+			const int y = shelves_.empty() ? 0 : shelves_.back().y + shelves_.back().height;
+			if (y + paddedHeight > height_ || paddedWidth > width_)
+			{
+				return false;
+			}
+			shelves_.push_back({y, paddedHeight, 0});
+			best = &shelves_.back();
+		}
+		slot = CefRect(best->nextX, best->y, width, height);
+		best->nextX += paddedWidth;
+		return true;
+	}
+
+	bool WebviewTextureAtlas::repack(int atlasWidth, int atlasHeight, std::vector<int> &moved)
+	{
+		// Tallest first keeps shelves tight.
+		std::vector<int> order;
+		for (auto &entry : slots_)
+		{
+			order.push_back(entry.first);
+		}
+		std::stable_sort(order.begin(), order.end(), [this](int a, int b)
+						 { return slots_[a].height > slots_[b].height; });
+
+		std::vector<Shelf> oldShelves;
+		oldShelves.swap(shelves_);
+		const int oldWidth = width_;
+		const int oldHeight = height_;
+		width_ = atlasWidth;
+		height_ = atlasHeight;
+		std::map<int, CefRect> placed;
+		for (int id : order)
+		{
+			CefRect slot;
+			if (!placeOnShelf(slots_[id].width, slots_[id].height, slot))
+			{
+				shelves_.swap(oldShelves);
+				width_ = oldWidth;
+				height_ = oldHeight;
+				return false;
+			}
+			placed[id] = slot;
+		}
+
+		// Carry every slot's pixels over, so moved browsers need no repaint.
+		std::vector<uint8_t> composite((size_t)width_ * height_ * 4, 0);
+		const CefRect oldBounds(0, 0, oldWidth, oldHeight);
+		for (auto &entry : placed)
+		{
+			const CefRect old = slots_[entry.first];
+			CefRect source = IntersectRect(old, oldBounds);
+			if (!source.IsEmpty())
+			{
+				CefRect dest(entry.second.x + (source.x - old.x), entry.second.y + (source.y - old.y), source.width, source.height);
+				copyRows(composite.data(), width_ * 4, dest, composite_.data(), oldWidth * 4, source.x, source.y);
+			}
+			if (!(old == entry.second) || width_ != oldWidth || height_ != oldHeight)
+			{
+				moved.push_back(entry.first);
+			}
+		}
+		composite_.swap(composite);
+		slots_.swap(placed);
+		return true;
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef WEBVIEW_TEXTURE_ATLAS_H
+#define WEBVIEW_TEXTURE_ATLAS_H
+
+#include "webview_plugin.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace webview_cef {
+    // Packs the frames of several browsers into sub-rectangles of one shared
+    // texture, so a wall of small webviews costs one Flutter texture and one
+    // upload per frame instead of one each. Slots are shelf packed into a BGRA
+    // composite that is handed to an ordinary platform texture, whose frame
+    // pool then converts only the damaged part of the atlas.
+    //
+    // The platform textures upload whole buffers, so a paint in any slot
+    // uploads the whole atlas on the next Flutter frame. That beats per-view
+    // textures while the views painting in a frame cover a good part of the
+    // atlas (one upload of width_ x height_ against one per view), and loses
+    // when a single small view animates in a big atlas. kMaxSize keeps the
+    // worst case at 2048x2048 (16 MB, about two 1080p frames); views that do
+    // not fit should use their own texture.
+    class WebviewTextureAtlas : public std::enable_shared_from_this<WebviewTextureAtlas> {
+    public:
+        explicit WebviewTextureAtlas(std::shared_ptr<WebviewTexture> target);
+
+        int64_t textureId() const { return target_->textureId; }
+        WebviewFramePool* framePool() { return target_->framePool(); }
+
+        // A texture for |browserId| that paints into its slot of the atlas.
+        // The slot is freed when the returned texture is destroyed.
+        std::shared_ptr<WebviewTexture> createSlotTexture(int browserId);
+
+        // The slot of |browserId| in atlas pixels and the atlas size. Returns
+        // false until the browser has painted.
+        bool getSlot(int browserId, CefRect& slot, int& atlasWidth, int& atlasHeight);
+
+        // Called after a slot was placed or moved, outside the atlas lock.
+        std::function<void(int browserId)> onSlotChanged;
+
+        void update(int browserId, const WebviewFrame& frame);
+        void release(int browserId);
+
+    private:
+        static constexpr int kInitialSize = 1024;
+        static constexpr int kMaxSize = 2048;
+        // Gap between slots so scaled sampling does not bleed into neighbours.
+        static constexpr int kPadding = 2;
+
+        struct Shelf {
+            int y;
+            int height;
+            int nextX;
+        };
+
+        // Places a |width| x |height| slot for |browserId|, repacking or
+        // growing the atlas when it does not fit. Returns false if the atlas
+        // is at its maximum size and still too small.
+        bool allocate(int browserId, int width, int height, std::vector<int>& moved);
+        bool placeOnShelf(int width, int height, CefRect& slot);
+        // Returns the space of a removed slot to its shelf when it was the
+        // rightmost one, and drops empty shelves at the bottom.
+        void reclaim(const CefRect& freed);
+        bool repack(int atlasWidth, int atlasHeight, std::vector<int>& moved);
+
+        std::shared_ptr<WebviewTexture> target_;
+        std::mutex mutex_;
+        std::vector<uint8_t> composite_;
+        int width_ = 0;
+        int height_ = 0;
+        std::vector<Shelf> shelves_;
+        std::map<int, CefRect> slots_;
+    };
+}
+
+#endif //WEBVIEW_TEXTURE_ATLAS_H
@@ -0,0 +1,175 @@
+#include "webview_thumbnail_cache.h"
+#include "webview_swizzle.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace webview_cef
+{
+	WebviewThumbnailCache::WebviewThumbnailCache(std::function<void(int browserId)> requestFrame)
+		: requestFrame_(requestFrame)
+	{
+	}
+
+	WebviewThumbnailCache::~WebviewThumbnailCache()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+			wakeup_ = true;
+		}
+		wake_.notify_one();
+		if (thread_.joinable())
+		{
+			thread_.join();
+		}
+	}
+
+	void WebviewThumbnailCache::enable(int browserId, int maxWidth, int maxHeight, int intervalMs)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			Entry &entry = entries_[browserId];
+			entry.maxWidth = std::max(0, maxWidth);
+			entry.maxHeight = std::max(0, maxHeight);
+			entry.interval = std::chrono::milliseconds(std::max(50, intervalMs));
+			entry.stale = true;
+			entry.lastRequest = Clock::time_point();
+			wakeup_ = true;
+			if (!thread_.joinable())
+			{
+				thread_ = std::thread(&WebviewThumbnailCache::timerLoop, this);
+			}
+		}
+		wake_.notify_one();
+	}
+
+	void WebviewThumbnailCache::disable(int browserId)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		entries_.erase(browserId);
+	}
+
+	void WebviewThumbnailCache::onFrame(int browserId, const WebviewFrame &frame)
+	{
+		int maxWidth = 0;
+		int maxHeight = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = entries_.find(browserId);
+			if (it == entries_.end() || frame.buffer == nullptr || frame.width <= 0 || frame.height <= 0)
+			{
+				return;
+			}
+			const Clock::time_point now = Clock::now();
+			if (now - it->second.lastUpdate < it->second.interval)
+			{
+				it->second.stale = true;
+				return;
+			}
+			it->second.lastUpdate = now;
+			it->second.stale = false;
+			maxWidth = it->second.maxWidth;
+			maxHeight = it->second.maxHeight;
+		}
+
+		WebviewImage image = downscale(frame, maxWidth, maxHeight);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = entries_.find(browserId);
+		if (it != entries_.end())
+		{
+			it->second.thumbnail.browserId = browserId;
+			it->second.thumbnail.version = ++version_;
+			it->second.thumbnail.image = std::move(image);
+		}
+	}
+
+	WebviewImage WebviewThumbnailCache::downscale(const WebviewFrame &frame, int maxWidth, int maxHeight)
+	{
+		double scale = 1.0;
+		if (maxWidth > 0)
+		{
+			scale = std::min(scale, (double)maxWidth / frame.width);
+		}
+		if (maxHeight > 0)
+		{
+			scale = std::min(scale, (double)maxHeight / frame.height);
+		}
+		const int targetWidth = std::max(1, (int)std::lround(frame.width * scale));
+		const int targetHeight = std::max(1, (int)std::lround(frame.height * scale));
+
+		// Halve with the SIMD kernel while that stays above the target, so the
+		// final box filter averages at most 2x2 blocks.
+		const uint8_t *src = (const uint8_t *)frame.buffer;
+		int stride = frame.stride;
+		int width = frame.width;
+		int height = frame.height;
+		for (int level = 0; width / 2 >= targetWidth && height / 2 >= targetHeight; level++)
+		{
+			std::vector<uint8_t> &dest = scratch_[level % 2];
+			dest.resize((size_t)(width / 2) * (height / 2) * 4);
+			halveImage(src, stride, width, height, dest.data());
+			src = dest.data();
+			width /= 2;
+			height /= 2;
+			stride = width * 4;
+		}
+		return scaleBgraRegion(src, stride, {0, 0, width, height}, targetWidth, targetHeight);
+	}
+
+	std::vector<WebviewThumbnailCache::Thumbnail> WebviewThumbnailCache::changedSince(uint64_t sinceVersion, uint64_t &latestVersion)
+	{
+		std::vector<Thumbnail> changed;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto &entry : entries_)
+		{
+			if (entry.second.thumbnail.version > sinceVersion)
+			{
+				changed.push_back(entry.second.thumbnail);
+			}
+		}
+		latestVersion = version_;
+		return changed;
+	}
+
+	void WebviewThumbnailCache::timerLoop()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!stopping_)
+		{
+			const Clock::time_point now = Clock::now();
+			Clock::duration sleep = std::chrono::seconds(1);
+			std::vector<int> due;
+			for (auto &entry : entries_)
+			{
+				Entry &e = entry.second;
+				const Clock::time_point refreshAt = e.lastUpdate + (e.stale ? e.interval : e.interval * kIdleRefreshIntervals);
+				// A request that is not answered within an interval is repeated.
+				const Clock::time_point at = std::max(refreshAt, e.lastRequest + e.interval);
+				if (at <= now)
+				{
+					due.push_back(entry.first);
+					e.lastRequest = now;
+					sleep = std::min(sleep, e.interval);
+				}
+				else
+				{
+					sleep = std::min(sleep, at - now);
+				}
+			}
+			if (!due.empty())
+			{
+				lock.unlock();
+				for (int browserId : due)
+				{
+					requestFrame_(browserId);
+				}
+				lock.lock();
+			}
+			wake_.wait_for(lock, sleep, [this]
+						   { return wakeup_; });
+			wakeup_ = false;
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef WEBVIEW_THUMBNAIL_CACHE_H
+#define WEBVIEW_THUMBNAIL_CACHE_H
+
+#include "webview_image.h"
+#include "webview_plugin.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace webview_cef {
+    // Small downscaled copies of browsers' frames for tab switchers. Paints
+    // refresh a thumbnail at most once per interval. A paint that arrives
+    // sooner marks it stale instead. A background thread asks for a frame
+    // when a thumbnail has been stale for an interval, or untouched for
+    // kIdleRefreshIntervals intervals. The idle refresh is what keeps
+    // hidden browsers, which do not paint on their own, up to date; waking
+    // one un-hides the page for a paint, so that is limited to once per
+    // kHiddenWakeIntervalMs whatever the interval.
+    class WebviewThumbnailCache {
+    public:
+        struct Thumbnail {
+            int browserId = 0;
+            // Bumped on every refresh; comparable across browsers.
+            uint64_t version = 0;
+            WebviewImage image;
+        };
+
+        // |requestFrame| is called from the cache thread.
+        explicit WebviewThumbnailCache(std::function<void(int browserId)> requestFrame);
+        ~WebviewThumbnailCache();
+
+        // Keeps a thumbnail of |browserId| that fits in maxWidth x maxHeight
+        // (0 leaves that side unconstrained), refreshed at most every
+        // |intervalMs|.
+        void enable(int browserId, int maxWidth, int maxHeight, int intervalMs);
+        void disable(int browserId);
+
+        // Paint callback.
+        void onFrame(int browserId, const WebviewFrame& frame);
+
+        // Thumbnails refreshed after |sinceVersion|, and the newest version.
+        std::vector<Thumbnail> changedSince(uint64_t sinceVersion, uint64_t& latestVersion);
+
+        static constexpr int kIdleRefreshIntervals = 5;
+        static constexpr int kHiddenWakeIntervalMs = 60000;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Entry {
+            int maxWidth = 0;
+            int maxHeight = 0;
+            Clock::duration interval;
+            Clock::time_point lastUpdate;
+            Clock::time_point lastRequest;
+            bool stale = true;
+            Thumbnail thumbnail;
+        };
+
+        void timerLoop();
+        WebviewImage downscale(const WebviewFrame& frame, int maxWidth, int maxHeight);
+
+        std::function<void(int)> requestFrame_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::thread thread_;
+        bool stopping_ = false;
+        // Set when entries change, so the timer recomputes its deadline.
+        bool wakeup_ = false;
+        std::unordered_map<int, Entry> entries_;
+        uint64_t version_ = 0;
+
+        // Halving pyramid scratch, paint thread only.
+        std::vector<uint8_t> scratch_[2];
+    };
+}
+
+#endif //WEBVIEW_THUMBNAIL_CACHE_H
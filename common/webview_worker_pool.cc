@@ -0,0 +1,112 @@
+#include "webview_worker_pool.h"
+
+#include <algorithm>
+
+namespace webview_cef
+{
+	WebviewWorkerPool::WebviewWorkerPool(int workers)
+	{
+		for (int i = 0; i < workers; i++)
+		{
+			threads_.emplace_back(&WebviewWorkerPool::workerLoop, this);
+		}
+	}
+
+	WebviewWorkerPool::~WebviewWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (std::thread &thread : threads_)
+		{
+			thread.join();
+		}
+	}
+
+	static int defaultWorkerCount()
+	{
+		// Half the cores, at most four threads: conversion is memory bound and
+		// stops scaling well before that, and CEF needs the other cores. The
+		// caller is one of the threads.
+		int cores = (int)std::thread::hardware_concurrency();
+		return std::max(1, std::min(cores / 2, 4)) - 1;
+	}
+
+	WebviewWorkerPool &WebviewWorkerPool::shared()
+	{
+		static WebviewWorkerPool pool(defaultWorkerCount());
+		return pool;
+	}
+
+	void WebviewWorkerPool::run(int count, const std::function<void(int)> &task)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+		if (threads_.empty() || count == 1)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				task(i);
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> runLock(runMutex_);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			task_ = &task;
+			count_ = count;
+			next_.store(0, std::memory_order_relaxed);
+			generation_++;
+			busy_++;
+		}
+		wake_.notify_all();
+		drain(task, count);
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		busy_--;
+		// Late workers may still hold the task, so it is only retired once
+		// nobody is inside it.
+		done_.wait(lock, [this]
+				   { return busy_ == 0; });
+		task_ = nullptr;
+	}
+
+	void WebviewWorkerPool::drain(const std::function<void(int)> &task, int count)
+	{
+		for (int i = next_.fetch_add(1, std::memory_order_relaxed); i < count; i = next_.fetch_add(1, std::memory_order_relaxed))
+		{
+			task(i);
+		}
+	}
+
+	void WebviewWorkerPool::workerLoop()
+	{
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			wake_.wait(lock, [&]
+					   { return stop_ || (task_ != nullptr && generation_ != seen); });
+			if (stop_)
+			{
+				return;
+			}
+			seen = generation_;
+			const std::function<void(int)> *task = task_;
+			const int count = count_;
+			busy_++;
+			lock.unlock();
+			drain(*task, count);
+			lock.lock();
+			if (--busy_ == 0)
+			{
+				done_.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef WEBVIEW_WORKER_POOL_H
+#define WEBVIEW_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace webview_cef {
+    // A small set of persistent threads for splitting one job (e.g. converting
+    // a large frame) into equal tasks. The calling thread works on the job too
+    // and run() only returns once every task has finished.
+    class WebviewWorkerPool {
+    public:
+        explicit WebviewWorkerPool(int workers);
+        ~WebviewWorkerPool();
+
+        // Pool shared by the frame conversion code, sized for the CPU.
+        static WebviewWorkerPool& shared();
+
+        // Threads that take part in run(), counting the caller.
+        int concurrency() const { return (int)threads_.size() + 1; }
+
+        // Calls task(i) for every i in [0, count). Concurrent callers are
+        // serialized.
+        void run(int count, const std::function<void(int)>& task);
+
+    private:
+        void workerLoop();
+        void drain(const std::function<void(int)>& task, int count);
+
+        std::vector<std::thread> threads_;
+        std::mutex runMutex_;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        const std::function<void(int)>* task_ = nullptr;
+        int count_ = 0;
+        uint64_t generation_ = 0;
+        int busy_ = 0;
+        bool stop_ = false;
+        std::atomic<int> next_{0};
+    };
+}
+
+#endif //WEBVIEW_WORKER_POOL_H
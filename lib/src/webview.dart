@@ -12,19 +12,79 @@ import 'webview_javascript.dart';
 import 'webview_textinput.dart';
 import 'webview_tooltip.dart';
 
+// Record kinds of the sendInputBatch channel, see WebviewPlugin::InputKind.
+const int _kInputMove = 0;
+const int _kInputDrag = 1;
+const int _kInputDown = 2;
+const int _kInputUp = 3;
+const int _kInputScroll = 4;
+const int _kInputTouchPressed = 5;
+const int _kInputTouchMoved = 6;
+const int _kInputTouchReleased = 7;
+const int _kInputTouchCancelled = 8;
+
+// Timestamps input on the Dart side.
+final Stopwatch _inputClock = Stopwatch()..start();
+// Microseconds to add to [_inputClock] to get the plugin's steady clock, or
+// null until [_syncInputClock] has measured it.
+int? _inputClockOffset;
+Future<void>? _inputClockSync;
+
+// Reads the plugin's clock a few times and keeps the sample with the
+// shortest round trip, taking the reply to be made halfway through it.
+Future<void> _syncInputClock(MethodChannel channel) async {
+  int? offset;
+  int bestRoundTrip = 0;
+  try {
+    for (int i = 0; i < 5; i++) {
+      final sent = _inputClock.elapsedMicroseconds;
+      final native = await channel.invokeMethod<int>('getInputClock');
+      final received = _inputClock.elapsedMicroseconds;
+      if (native == null) {
+        return;
+      }
+      if (offset == null || received - sent < bestRoundTrip) {
+        bestRoundTrip = received - sent;
+        offset = native - (sent + received) ~/ 2;
+      }
+    }
+  } on PlatformException {
+    return;
+  }
+  _inputClockOffset = offset;
+}
+
 class WebViewController extends ValueNotifier<bool> {
   WebViewController(
     this._pluginChannel,
     this._index, {
     Widget? loading,
     String? profileId,
+    bool externalBeginFrame = false,
+    bool useTextureAtlas = false,
   }) : super(false) {
     _loadingWidget = loading;
     _profileId = profileId;
+    _externalBeginFrame = externalBeginFrame;
+    _useTextureAtlas = useTextureAtlas;
   }
   final MethodChannel _pluginChannel;
   Widget? _loadingWidget;
   String? _profileId;
+  // Paint only when Flutter produces a frame instead of on CEF's own timer.
+  bool _externalBeginFrame = false;
+  // Paint into a slot of a texture shared with other atlas webviews.
+  bool _useTextureAtlas = false;
+  // The slot in normalized texture coordinates, null until the first paint.
+  final ValueNotifier<Rect?> _atlasSlot = ValueNotifier<Rect?>(null);
+  // Last size reported to the plugin, in logical pixels.
+  Size _surfaceSize = Size.zero;
+  // Pointer events waiting for the next frame, as sendInputBatch records.
+  final List<int> _pendingInput = <int>[];
+  bool _inputFlushScheduled = false;
+  // When the oldest pending record was queued, on [_inputClock].
+  int _inputQueuedAt = 0;
+  int _inputSequence = 0;
 
   late WebView _webviewWidget;
   Widget get webviewWidget => _webviewWidget;
@@ -68,15 +128,20 @@ class WebViewController extends ValueNotifier<bool> {
     _creatingCompleter = Completer<void>();
     try {
       await WebviewManager().ready;
+      await (_inputClockSync ??= _syncInputClock(_pluginChannel));
 
       List args = await _pluginChannel.invokeMethod(
         'create',
-        [url, _profileId],
+        [url, _profileId, _externalBeginFrame, _useTextureAtlas],
       );
 
       _browserId = args[0] as int;
       _textureId = args[1] as int;
       WebviewManager().onBrowserCreated(_index, _browserId);
+      if (_useTextureAtlas) {
+        onAtlasSlotChanged(
+            await _pluginChannel.invokeMethod('getAtlasSlot', _browserId));
+      }
       await Future.delayed(const Duration(milliseconds: 50));
       _webviewWidget = WebView(this);
       value = true;
@@ -87,6 +152,17 @@ class WebViewController extends ValueNotifier<bool> {
     return _creatingCompleter.future;
   }
 
+  void onAtlasSlotChanged(dynamic slot) {
+    if (slot == null) {
+      return;
+    }
+    _atlasSlot.value = Rect.fromLTRB(
+        (slot['left'] as num).toDouble(),
+        (slot['top'] as num).toDouble(),
+        (slot['right'] as num).toDouble(),
+        (slot['bottom'] as num).toDouble());
+  }
+
   setWebviewListener(WebviewEventsListener listener) {
     _listener = listener;
   }
@@ -216,51 +292,362 @@ class WebViewController extends ValueNotifier<bool> {
         .invokeMethod('evaluateJavascript', [_browserId, code]);
   }
 
-  /// Moves the virtual cursor to [position].
-  Future<void> _cursorMove(Offset position) async {
+  /// Sets the frame rate the page is rendered at while visible (1-60 fps).
+  Future<void> setFrameRate(int frameRate) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('setFrameRate', [_browserId, frameRate]);
+  }
+
+  /// Tells the browser whether its widget is on screen. Hidden browsers are
+  /// throttled to 1fps and their frames are not copied to the texture.
+  ///
+  /// [WebView] reports this automatically when it is taken off stage (for
+  /// example by an [IndexedStack] or a covering route) and when the app is
+  /// paused.
+  Future<void> setVisibility(bool visible) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('setVisibility', [_browserId, visible]);
+  }
+
+  /// When handing a paint to the texture takes longer than [milliseconds] on
+  /// average, the page is rendered at a lower resolution and stretched by
+  /// Flutter until the load drops again. 0 disables this.
+  Future<void> setPaintBudget(double milliseconds) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel
+        .invokeMethod('setPaintBudget', [_browserId, milliseconds]);
+  }
+
+  /// Keeps this webview at full resolution whatever its paint cost.
+  Future<void> setFullResolutionPinned(bool pinned) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel
+        .invokeMethod('setFullResolutionPinned', [_browserId, pinned]);
+  }
+
+  /// Defers the BGRA to RGBA conversion until Flutter pulls the texture, so
+  /// frames painted faster than they are displayed are never converted.
+  Future<void> setConvertOnConsume(bool enabled) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel
+        .invokeMethod('setConvertOnConsume', [_browserId, enabled]);
+  }
+
+  /// Drops paints whose damaged pixels are identical to the previous frame,
+  /// so Flutter does not re-upload an unchanged texture.
+  Future<void> setSkipIdenticalFrames(bool enabled) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel
+        .invokeMethod('setSkipIdenticalFrames', [_browserId, enabled]);
+  }
+
+  /// Returns the `produced`, `converted`, `skipped`, `suppressed` and
+  /// `offscreen` frame counters of the texture backing this webview.
+  Future<dynamic> getFrameStats() async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('getFrameStats', _browserId);
+  }
+
+  /// Returns render telemetry for this webview: `paints` and `dirtyPixels`
+  /// received from CEF, frames `converted` and `presented` to Flutter, the
+  /// frame pool counters, `paintFps` and `presentFps` since the previous
+  /// `getRenderStats` call (pushed `onRenderStats` events keep their own
+  /// window), the pointer `moves` received and how many of them were
+  /// `coalescedMoves` (dropped for a later move in the same frame), the
+  /// `inputSequence` of the last input batch and the
+  /// `paintedInputSequence` of the last batch a paint answered, and
+  /// `paintTime`, `conversionTime`, `presentLatency`, `inputDelivery`,
+  /// `inputToPaint` and `inputToPresent` histograms. `inputDelivery` is the
+  /// method-channel hop of each batch; the other input histograms time it
+  /// from its oldest event being queued in Dart to the next paint and to
+  /// the frame that shows it, using a clock offset measured once at
+  /// startup. Each histogram
+  /// has `count`, `meanMs`, `maxMs`, `p50Ms`, `p95Ms`, `p99Ms` and
+  /// `buckets`, where bucket i counts durations of 2^i to 2^(i+1)
+  /// microseconds.
+  Future<dynamic> getRenderStats() async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('getRenderStats', _browserId);
+  }
+
+  /// Publishes every painted frame to a POSIX shared memory segment that
+  /// other processes can map read-only. Returns the segment `name` and the
+  /// `pid` that owns it. On Linux readers can wait for frames with a shared
+  /// futex on the header's `notify` word (see webview_frame_export.h).
+  /// Not supported on Windows.
+  Future<dynamic> startFrameExport({String? name}) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('startFrameExport', [_browserId, name]);
+  }
+
+  /// Stops the export started by [startFrameExport] and unlinks the segment.
+  Future<void> stopFrameExport() async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('stopFrameExport', _browserId);
+  }
+
+  /// Records this webview's paints to [path] as I420 video. `y4m` files are
+  /// padded to a constant [frameRate]; `raw` files hold one frame per paint
+  /// with their times in `<path>.timestamps`. Conversion and writing happen
+  /// off the UI thread, and paints are dropped if the disk falls behind.
+  Future<void> startRecording(String path,
+      {String format = 'y4m', int frameRate = 30}) async {
     if (_isDisposed) {
       return;
     }
     assert(value);
     return _pluginChannel.invokeMethod(
-        'cursorMove', [_browserId, position.dx.round(), position.dy.round()]);
+        'startRecording', [_browserId, path, format, frameRate]);
   }
 
-  Future<void> _cursorDragging(Offset position) async {
+  /// Finishes the recording and returns its `recorded`, `dropped`,
+  /// `written` and `bytes` counters, plus whether writing `failed`.
+  Future<dynamic> stopRecording() async {
     if (_isDisposed) {
       return;
     }
     assert(value);
-    return _pluginChannel.invokeMethod('cursorDragging',
-        [_browserId, position.dx.round(), position.dy.round()]);
+    return _pluginChannel.invokeMethod('stopRecording', _browserId);
   }
 
-  Future<void> _cursorClickDown(Offset position, int button) async {
+  /// Records this webview's pointer, scroll, key and IME input with its
+  /// timing to [path], in a compact binary log for [replayInput].
+  Future<void> startInputRecording(String path) async {
     if (_isDisposed) {
       return;
     }
     assert(value);
-    return _pluginChannel.invokeMethod('cursorClickDown',
-        [_browserId, position.dx.round(), position.dy.round(), button]);
+    return _pluginChannel
+        .invokeMethod('startInputRecording', [_browserId, path]);
+  }
+
+  /// Closes the input log and returns its `events` and `bytes` counters,
+  /// plus whether writing `failed`.
+  Future<dynamic> stopInputRecording() async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('stopInputRecording', _browserId);
   }
 
-  Future<void> _cursorClickUp(Offset position, int button) async {
+  /// Plays an input log written by [startInputRecording] back into this
+  /// webview, [speed] times faster than it was recorded, and returns the
+  /// number of events in it. [WebviewEventsListener.onInputReplayFinished]
+  /// reports the end of the replay together with the render stats, so an
+  /// interaction can be benchmarked against a local page.
+  Future<dynamic> replayInput(String path, {double speed = 1.0}) async {
     if (_isDisposed) {
       return;
     }
     assert(value);
-    return _pluginChannel.invokeMethod('cursorClickUp',
-        [_browserId, position.dx.round(), position.dy.round(), button]);
+    return _pluginChannel
+        .invokeMethod('replayInput', [_browserId, path, speed]);
+  }
+
+  /// Stops the replay started by [replayInput].
+  Future<void> stopInputReplay() async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('stopInputReplay', _browserId);
+  }
+
+  /// Keeps a native thumbnail of this webview that fits in [width] x
+  /// [height] (0 leaves a side unconstrained), refreshed at most once per
+  /// [interval]. Hidden webviews are woken for a single paint at most once a
+  /// minute to keep their thumbnail current. While woken the page is
+  /// visible: it gets a `visibilitychange` event each way and its timers run
+  /// unthrottled until the paint. Read them with
+  /// [WebviewManager.getThumbnails]; pass 0 for both sides to stop.
+  Future<void> setThumbnailOptions(
+      {int width = 200,
+      int height = 0,
+      Duration interval = const Duration(seconds: 1)}) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod('setThumbnailOptions',
+        [_browserId, width, height, interval.inMilliseconds]);
+  }
+
+  /// Snapshots the next painted frame and returns it encoded as `png` or
+  /// `qoi`. [region] (in texture pixels) crops the frame; [width] and
+  /// [height] resize it, keeping the aspect ratio when only one is given.
+  /// Scaling and encoding run on a native worker thread.
+  ///
+  /// With [fullPage] the whole document, including what is scrolled out of
+  /// view, is rendered through the DevTools protocol. The result is always a
+  /// PNG, [region] and [height] are ignored, and [width] scales the page.
+  Future<Uint8List?> captureFrame(
+      {String format = 'png',
+      Rect? region,
+      int width = 0,
+      int height = 0,
+      bool fullPage = false}) async {
+    if (_isDisposed) {
+      return null;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod<Uint8List>('captureFrame', [
+      _browserId,
+      format,
+      region?.left.round() ?? 0,
+      region?.top.round() ?? 0,
+      region?.width.round() ?? 0,
+      region?.height.round() ?? 0,
+      width,
+      height,
+      fullPage,
+    ]);
+  }
+
+  /// Diffs the next painted frame against a golden image given as
+  /// straight-alpha RGBA [pixels] (e.g. from `Image.toByteData` with
+  /// `ImageByteFormat.rawStraightRgba`). A pixel differs when any channel is
+  /// more than [tolerance] apart. Returns `width`, `height`, `sameSize`,
+  /// `differingPixels`, `maxDelta` and `meanDelta`, plus a PNG `diffImage`
+  /// with the differing pixels in red when [diffImage] is set and any differ.
+  /// Wait for the page to settle (e.g. [WebviewEventsListener.onLoadEnd])
+  /// before comparing.
+  Future<Map?> compareFrame(Uint8List pixels, int width, int height,
+      {int tolerance = 0, bool diffImage = true}) async {
+    if (_isDisposed) {
+      return null;
+    }
+    assert(value);
+    return _pluginChannel.invokeMethod<Map>('compareFrame',
+        [_browserId, pixels, width, height, tolerance, diffImage]);
+  }
+
+  /// Moves the virtual cursor to [position].
+  void _cursorMove(Offset position) {
+    _queueInput(_kInputMove, position);
+  }
+
+  void _cursorDragging(Offset position) {
+    _queueInput(_kInputDrag, position);
+  }
+
+  void _cursorClickDown(Offset position, int button) {
+    _queueInput(_kInputDown, position, button);
+  }
+
+  void _cursorClickUp(Offset position, int button) {
+    _queueInput(_kInputUp, position, button);
   }
 
   /// Sets the horizontal and vertical scroll delta.
-  Future<void> _setScrollDelta(Offset position, int dx, int dy) async {
+  void _setScrollDelta(Offset position, int dx, int dy) {
+    _queueInput(_kInputScroll, position, dx, dy);
+  }
+
+  /// Forwards a touch as a touch event, so pages get native touch
+  /// scrolling and pinch zoom instead of emulated mouse input.
+  void _touch(int kind, PointerEvent ev) {
+    final pressure = ev.pressureMax > ev.pressureMin
+        ? (ev.pressure - ev.pressureMin) / (ev.pressureMax - ev.pressureMin)
+        : 1.0;
+    _queueInput(kind, ev.localPosition, ev.pointer,
+        (pressure.clamp(0.0, 1.0) * 1000).round());
+  }
+
+  /// Queues a pointer event. Events are sent in order, in one
+  /// `sendInputBatch` call per frame.
+  void _queueInput(int kind, Offset position, [int a = 0, int b = 0]) {
     if (_isDisposed) {
       return;
     }
     assert(value);
-    return _pluginChannel.invokeMethod('setScrollDelta',
-        [_browserId, position.dx.round(), position.dy.round(), dx, dy]);
+    if (_pendingInput.isEmpty) {
+      _inputQueuedAt = _inputClock.elapsedMicroseconds;
+    }
+    _pendingInput
+      ..add(kind)
+      ..add(position.dx.round())
+      ..add(position.dy.round())
+      ..add(a)
+      ..add(b);
+    if (!_inputFlushScheduled) {
+      _inputFlushScheduled = true;
+      WidgetsBinding.instance.scheduleFrameCallback((_) => _flushInput());
+    }
+  }
+
+  void _flushInput() {
+    _inputFlushScheduled = false;
+    if (_isDisposed || _pendingInput.isEmpty) {
+      _pendingInput.clear();
+      return;
+    }
+    final records = Int32List.fromList(_pendingInput);
+    _pendingInput.clear();
+    // The sequence number and the times on the plugin's clock let it time
+    // the batch from the oldest event, across the channel, to the paint and
+    // the frame that answer it.
+    _inputSequence++;
+    final offset = _inputClockOffset;
+    _pluginChannel.invokeMethod('sendInputBatch', [
+      _browserId,
+      records,
+      _inputSequence,
+      offset == null ? 0 : _inputQueuedAt + offset,
+      offset == null ? 0 : _inputClock.elapsedMicroseconds + offset
+    ]);
+  }
+
+  /// Converts only [rect], the part of the webview that is on screen in
+  /// logical pixels, into the texture; null means all of it. The widget
+  /// reports this itself while it sits in a [Scrollable]; call it when the
+  /// webview is covered in other ways.
+  Future<void> setVisibleRect(Rect? rect) async {
+    if (_isDisposed) {
+      return;
+    }
+    assert(value);
+    if (rect == null || _surfaceSize.isEmpty) {
+      return _pluginChannel
+          .invokeMethod('setVisibleArea', [_browserId, 0.0, 0.0, 1.0, 1.0]);
+    }
+    return _pluginChannel.invokeMethod('setVisibleArea', [
+      _browserId,
+      rect.left / _surfaceSize.width,
+      rect.top / _surfaceSize.height,
+      rect.right / _surfaceSize.width,
+      rect.bottom / _surfaceSize.height,
+    ]);
   }
 
   /// Sets the surface size to the provided [size].
@@ -269,6 +656,7 @@ class WebViewController extends ValueNotifier<bool> {
       return;
     }
     assert(value);
+    _surfaceSize = size;
     return _pluginChannel
         .invokeMethod('setSize', [_browserId, dpi, size.width, size.height]);
   }
@@ -302,13 +690,20 @@ class WebView extends StatefulWidget {
   WebViewState createState() => WebViewState();
 }
 
-class WebViewState extends State<WebView> with WebeViewTextInput {
+class WebViewState extends State<WebView>
+    with WebeViewTextInput, WidgetsBindingObserver {
   final GlobalKey _key = GlobalKey();
   String _composingText = '';
   late final _focusNode = FocusNode();
   bool isPrimaryFocus = false;
   WebviewTooltip? _tooltip;
   MouseCursor _mouseType = SystemMouseCursors.basic;
+  bool _onStage = true;
+  bool _appVisible = true;
+  bool? _reportedVisible;
+  // Scrolling the nearest Scrollable changes which part of the webview shows.
+  ScrollPosition? _scrollPosition;
+  Rect? _reportedVisibleRect;
 
   WebViewController get _controller => widget.controller;
 
@@ -392,6 +787,49 @@ class WebViewState extends State<WebView> with WebeViewTextInput {
     // Report initial surface size
     WidgetsBinding.instance
         .addPostFrameCallback((_) => _reportSurfaceSize(context));
+    WidgetsBinding.instance.addObserver(this);
+  }
+
+  @override
+  void didChangeDependencies() {
+    super.didChangeDependencies();
+    // Offstage routes and inactive IndexedStack children have their tickers
+    // disabled, which is the closest signal Flutter gives for "not visible".
+    _onStage = TickerMode.of(context);
+    _reportVisibility();
+    final position = Scrollable.maybeOf(context)?.position;
+    if (position != _scrollPosition) {
+      _scrollPosition?.removeListener(_reportVisibleRect);
+      _scrollPosition = position;
+      _scrollPosition?.addListener(_reportVisibleRect);
+    }
+  }
+
+  @override
+  void didChangeAppLifecycleState(AppLifecycleState state) {
+    _appVisible = state == AppLifecycleState.resumed ||
+        state == AppLifecycleState.inactive;
+    _reportVisibility();
+  }
+
+  @override
+  void dispose() {
+    _scrollPosition?.removeListener(_reportVisibleRect);
+    WidgetsBinding.instance.removeObserver(this);
+    super.dispose();
+  }
+
+  void _reportVisibility() async {
+    final visible = _onStage && _appVisible;
+    if (_reportedVisible == visible) {
+      return;
+    }
+    _reportedVisible = visible;
+    await _controller.ready;
+    if (_controller._externalBeginFrame) {
+      WebviewManager().setBeginFrameClient(_controller._browserId, visible);
+    }
+    unawaited(_controller.setVisibility(visible));
   }
 
   @override
@@ -441,14 +879,31 @@ class WebViewState extends State<WebView> with WebeViewTextInput {
                 }
               });
             }
+            if (ev.kind == PointerDeviceKind.touch) {
+              _controller._touch(_kInputTouchPressed, ev);
+              return;
+            }
             _controller._cursorClickDown(ev.localPosition, ev.buttons);
           },
           onPointerUp: (ev) {
+            if (ev.kind == PointerDeviceKind.touch) {
+              _controller._touch(_kInputTouchReleased, ev);
+              return;
+            }
             _controller._cursorClickUp(ev.localPosition, ev.buttons);
           },
           onPointerMove: (ev) {
+            if (ev.kind == PointerDeviceKind.touch) {
+              _controller._touch(_kInputTouchMoved, ev);
+              return;
+            }
             _controller._cursorDragging(ev.localPosition);
           },
+          onPointerCancel: (ev) {
+            if (ev.kind == PointerDeviceKind.touch) {
+              _controller._touch(_kInputTouchCancelled, ev);
+            }
+          },
           onPointerSignal: (signal) {
             if (signal is PointerScrollEvent) {
               _controller._setScrollDelta(signal.localPosition, 0, 0);
@@ -465,13 +920,48 @@ class WebViewState extends State<WebView> with WebeViewTextInput {
           },
           child: MouseRegion(
             cursor: _mouseType,
-            child: Texture(textureId: _controller._textureId),
+            child: _buildTexture(),
           ),
         ),
       ),
     );
   }
 
+  Widget _buildTexture() {
+    final texture = Texture(textureId: _controller._textureId);
+    if (!_controller._useTextureAtlas) {
+      return texture;
+    }
+    return ValueListenableBuilder<Rect?>(
+      valueListenable: _controller._atlasSlot,
+      builder: (context, slot, child) {
+        if (slot == null) {
+          return const SizedBox.expand();
+        }
+        return LayoutBuilder(builder: (context, constraints) {
+          // Lay the whole atlas out so that this browser's slot covers the
+          // widget, then clip away the neighbours.
+          final width = constraints.maxWidth / slot.width;
+          final height = constraints.maxHeight / slot.height;
+          return ClipRect(
+            child: OverflowBox(
+              alignment: Alignment.topLeft,
+              minWidth: width,
+              maxWidth: width,
+              minHeight: height,
+              maxHeight: height,
+              child: Transform.translate(
+                offset: Offset(-slot.left * width, -slot.top * height),
+                child: child,
+              ),
+            ),
+          );
+        });
+      },
+      child: texture,
+    );
+  }
+
   void _reportSurfaceSize(BuildContext context) async {
     double dpi = MediaQuery.of(context).devicePixelRatio;
     final box = _key.currentContext?.findRenderObject() as RenderBox?;
@@ -479,6 +969,53 @@ class WebViewState extends State<WebView> with WebeViewTextInput {
       await _controller.ready;
       unawaited(
           _controller._setSize(dpi, Size(box.size.width, box.size.height)));
+      _reportVisibleRect();
+    }
+  }
+
+  void _reportVisibleRect() {
+    final box = _key.currentContext?.findRenderObject() as RenderBox?;
+    if (!mounted || !_controller.value || box == null || !box.hasSize) {
+      return;
+    }
+    final visible = _visibleRectOf(box);
+    if (visible == _reportedVisibleRect) {
+      return;
+    }
+    _reportedVisibleRect = visible;
+    unawaited(_controller.setVisibleRect(visible));
+  }
+
+  // The part of [box] that its ancestors' clips and the window leave on
+  // screen, in whole logical pixels of the box, or null if all of it is.
+  Rect? _visibleRectOf(RenderBox box) {
+    final bounds = Offset.zero & box.size;
+    final toGlobal = box.getTransformTo(null);
+    var visible = MatrixUtils.transformRect(toGlobal, bounds)
+        .intersect(Offset.zero & MediaQuery.of(context).size);
+    RenderObject child = box;
+    var parent = child.parent as RenderObject?;
+    while (parent != null && !visible.isEmpty) {
+      final clip = parent.describeApproximatePaintClip(child);
+      if (clip != null) {
+        visible = visible.intersect(
+            MatrixUtils.transformRect(parent.getTransformTo(null), clip));
+      }
+      child = parent;
+      parent = child.parent as RenderObject?;
+    }
+    final toLocal = Matrix4.tryInvert(toGlobal);
+    if (visible.isEmpty || toLocal == null) {
+      return Rect.zero;
     }
+    final local = MatrixUtils.transformRect(toLocal, visible).intersect(bounds);
+    final rounded = Rect.fromLTRB(
+        local.left.floorToDouble(),
+        local.top.floorToDouble(),
+        local.right.ceilToDouble(),
+        local.bottom.ceilToDouble());
+    final whole = Rect.fromLTWH(
+        0, 0, bounds.width.ceilToDouble(), bounds.height.ceilToDouble());
+    return rounded == whole ? null : rounded;
   }
 }
@@ -17,12 +17,21 @@ typedef LoadStopCb = void Function(WebViewController controller, String url);
 typedef OnConsoleMessage = void Function(
     int level, String message, String source, int line);
 
+/// Receives the same map as [WebViewController.getRenderStats].
+typedef RenderStatsCb = void Function(Map stats);
+
+/// Receives the number of `events` replayed, whether the replay
+/// `completed`, its `durationMs` and the webview's `renderStats` at the end.
+typedef InputReplayFinishedCb = void Function(Map result);
+
 class WebviewEventsListener {
   TitleChangeCb? onTitleChanged;
   UrlChangeCb? onUrlChanged;
   OnConsoleMessage? onConsoleMessage;
   LoadStartCb? onLoadStart;
   LoadStopCb? onLoadEnd;
+  RenderStatsCb? onRenderStats;
+  InputReplayFinishedCb? onInputReplayFinished;
 
   WebviewEventsListener({
     this.onTitleChanged,
@@ -30,5 +39,7 @@ class WebviewEventsListener {
     this.onConsoleMessage,
     this.onLoadStart,
     this.onLoadEnd,
+    this.onRenderStats,
+    this.onInputReplayFinished,
   });
 }
@@ -1,6 +1,7 @@
 import 'dart:async';
 
 import 'package:flutter/material.dart';
+import 'package:flutter/scheduler.dart';
 import 'package:flutter/services.dart';
 import 'package:flutter/widgets.dart';
 import 'package:webview_cef/src/webview_inject_user_script.dart';
@@ -26,12 +27,25 @@ class WebviewManager extends ValueNotifier<bool> {
 
   int nextIndex = 1;
 
+  // Browsers painted by external begin frames get one on every frame
+  // Flutter produces anyway. Their paints mark the texture, which makes the
+  // engine produce the next frame, so an animating page runs at vsync and an
+  // idle one costs no frames. Input schedules its own frame; page updates
+  // started by timers are picked up by a slow poll that sends begin frames
+  // without scheduling a Flutter frame.
+  static const Duration _idleBeginFrameInterval = Duration(milliseconds: 50);
+  final Set<int> _beginFrameClients = <int>{};
+  bool _beginFrameCallbackAdded = false;
+  Timer? _idleBeginFrameTimer;
+
   get ready => _creatingCompleter.future;
 
   WebViewController createWebView({
     Widget? loading,
     InjectUserScripts? injectUserScripts,
     String? profileId,
+    bool externalBeginFrame = false,
+    bool useTextureAtlas = false,
   }) {
     int browserIndex = nextIndex++;
     final controller = WebViewController(
@@ -39,6 +53,8 @@ class WebviewManager extends ValueNotifier<bool> {
       browserIndex,
       loading: loading,
       profileId: profileId,
+      externalBeginFrame: externalBeginFrame,
+      useTextureAtlas: useTextureAtlas,
     );
     _tempWebViews[browserIndex] = controller;
     _tempInjectUserScripts[browserIndex] = injectUserScripts;
@@ -49,7 +65,40 @@ class WebviewManager extends ValueNotifier<bool> {
   void removeWebView(int browserId) {
     if (browserId > 0) {
       _webViews.remove(browserId);
+      setBeginFrameClient(browserId, false);
+    }
+  }
+
+  /// Adds or removes a browser created with `externalBeginFrame` from the
+  /// set that is painted in step with Flutter's frames.
+  void setBeginFrameClient(int browserId, bool active) {
+    if (active) {
+      _beginFrameClients.add(browserId);
+      if (!_beginFrameCallbackAdded) {
+        _beginFrameCallbackAdded = true;
+        SchedulerBinding.instance.addPersistentFrameCallback((_) {
+          _sendBeginFrame();
+        });
+      }
+      _idleBeginFrameTimer ??= Timer.periodic(
+          _idleBeginFrameInterval, (_) => _sendBeginFrame());
+      // One frame for the first paint.
+      SchedulerBinding.instance.scheduleFrame();
+    } else {
+      _beginFrameClients.remove(browserId);
+      if (_beginFrameClients.isEmpty) {
+        _idleBeginFrameTimer?.cancel();
+        _idleBeginFrameTimer = null;
+      }
+    }
+  }
+
+  void _sendBeginFrame() {
+    if (_beginFrameClients.isEmpty) {
+      return;
     }
+    // One call covers every external begin frame browser.
+    unawaited(pluginChannel.invokeMethod('beginFrame'));
   }
 
   WebviewManager._internal() : super(false);
@@ -130,6 +179,10 @@ class WebviewManager extends ValueNotifier<bool> {
             ?.onCursorChanged
             ?.call(call.arguments['type'] as int);
         return;
+      case 'onAtlasSlotChanged':
+        int browserId = call.arguments['browserId'] as int;
+        _webViews[browserId]?.onAtlasSlotChanged(call.arguments);
+        return;
       case 'onFocusedNodeChangeMessage':
         int browserId = call.arguments['browserId'] as int;
         bool editable = call.arguments['editable'] as bool;
@@ -154,6 +207,17 @@ class WebviewManager extends ValueNotifier<bool> {
             _webViews[browserId] as WebViewController;
         _webViews[browserId]?.listener?.onLoadStart?.call(controller, urlId);
         return;
+      case 'onRenderStats':
+        int browserId = call.arguments["browserId"] as int;
+        _webViews[browserId]?.listener?.onRenderStats?.call(call.arguments);
+        return;
+      case 'onInputReplayFinished':
+        int browserId = call.arguments["browserId"] as int;
+        _webViews[browserId]
+            ?.listener
+            ?.onInputReplayFinished
+            ?.call(call.arguments);
+        return;
       case 'onLoadEnd':
         int browserId = call.arguments["browserId"] as int;
         String urlId = call.arguments["urlId"] as String;
@@ -206,6 +270,52 @@ class WebviewManager extends ValueNotifier<bool> {
     return pluginChannel.invokeMethod('visitUrlCookies', [domain, isHttpOnly]);
   }
 
+  /// Times the native BGRA to RGBA frame conversion kernels and returns the
+  /// throughput of each one in GB/s, plus the name of the `active` kernel.
+  /// Runs on a native worker thread; fails while another benchmark runs.
+  Future<dynamic> swizzleBenchmark(
+      {int width = 1920, int height = 1080, int iterations = 100}) async {
+    assert(value);
+    return pluginChannel
+        .invokeMethod('swizzleBenchmark', [width, height, iterations]);
+  }
+
+  /// Times conversion single-threaded and split into row stripes, for full
+  /// frames at common resolutions and for damage rects of 64K to 2M pixels
+  /// in a 4K frame. Each result holds `width`, `height`, whether it is
+  /// `damage`, `singleMs` and `parallelMs`; the map also reports the pool's
+  /// `threads` and the current `threshold` in pixels. Use it to pick the
+  /// [setParallelConversionThreshold] for a machine. Runs on a native worker
+  /// thread; fails while another benchmark runs.
+  Future<dynamic> conversionBenchmark({int iterations = 50}) async {
+    assert(value);
+    return pluginChannel.invokeMethod('conversionBenchmark', iterations);
+  }
+
+  /// Frames or damage regions of at least [pixels] pixels are converted on
+  /// several threads.
+  Future<void> setParallelConversionThreshold(int pixels) async {
+    assert(value);
+    return pluginChannel.invokeMethod('setParallelConversionThreshold', pixels);
+  }
+
+  /// Returns the thumbnails refreshed after [sinceVersion] in one batch: a
+  /// map with the newest `version` and a `thumbnails` list of `browserId`,
+  /// `version`, `width`, `height` and RGBA `pixels`, ready for
+  /// `decodeImageFromPixels`. Pass the returned `version` to the next call.
+  Future<dynamic> getThumbnails({int sinceVersion = 0}) async {
+    assert(value);
+    return pluginChannel.invokeMethod('getThumbnails', sinceVersion);
+  }
+
+  /// Pushes every webview's render stats to its
+  /// [WebviewEventsListener.onRenderStats] once per [interval]; null stops.
+  Future<void> setRenderStatsInterval(Duration? interval) async {
+    assert(value);
+    return pluginChannel.invokeMethod(
+        'setRenderStatsInterval', interval?.inMilliseconds ?? 0);
+  }
+
   Future<void> quit() async {
     //only call this method when you want to quit the app
     assert(value);
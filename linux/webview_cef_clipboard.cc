@@ -0,0 +1,185 @@
+#include "webview_cef_clipboard.h"
+
+#include <X11/Xatom.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+WebviewClipboardOwner::WebviewClipboardOwner()
+{
+  display_ = XOpenDisplay(nullptr);
+  if (display_ == nullptr)
+  {
+    return;
+  }
+  if (pipe(wakePipe_) != 0)
+  {
+    XCloseDisplay(display_);
+    display_ = nullptr;
+    return;
+  }
+  fcntl(wakePipe_[0], F_SETFL, O_NONBLOCK);
+  window_ = XCreateSimpleWindow(display_, DefaultRootWindow(display_), 0, 0, 1, 1, 0, 0, 0);
+  clipboard_ = XInternAtom(display_, "CLIPBOARD", False);
+  targets_ = XInternAtom(display_, "TARGETS", False);
+  utf8String_ = XInternAtom(display_, "UTF8_STRING", False);
+  text_ = XInternAtom(display_, "TEXT", False);
+  plainUtf8_ = XInternAtom(display_, "text/plain;charset=utf-8", False);
+  long maxRequest = XExtendedMaxRequestSize(display_);
+  if (maxRequest == 0)
+  {
+    maxRequest = XMaxRequestSize(display_);
+  }
+  // The request size is in 4 byte units and includes the request header.
+  maxPropertyBytes_ = size_t(maxRequest) * 4 - 64;
+  XFlush(display_);
+  // From here on only the thread uses the connection.
+  thread_ = std::thread(&WebviewClipboardOwner::run, this);
+}
+
+WebviewClipboardOwner::~WebviewClipboardOwner()
+{
+  if (display_ == nullptr)
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake();
+  thread_.join();
+  XDestroyWindow(display_, window_);
+  XCloseDisplay(display_);
+  close(wakePipe_[0]);
+  close(wakePipe_[1]);
+}
+
+void WebviewClipboardOwner::own(const std::string &text)
+{
+  if (display_ == nullptr)
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ownedText_ = text;
+    ownPending_ = true;
+  }
+  wake();
+}
+
+void WebviewClipboardOwner::wake()
+{
+  const char byte = 0;
+  ssize_t written = write(wakePipe_[1], &byte, 1);
+  (void)written;
+}
+
+void WebviewClipboardOwner::run()
+{
+  const int connection = ConnectionNumber(display_);
+  while (true)
+  {
+    while (XPending(display_) > 0)
+    {
+      XEvent event;
+      XNextEvent(display_, &event);
+      handleEvent(event);
+    }
+
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(connection, &fds);
+    FD_SET(wakePipe_[0], &fds);
+    if (select(std::max(connection, wakePipe_[0]) + 1, &fds, nullptr, nullptr, nullptr) < 0 ||
+        !FD_ISSET(wakePipe_[0], &fds))
+    {
+      continue;
+    }
+    char drain[64];
+    while (read(wakePipe_[0], drain, sizeof(drain)) > 0)
+    {
+    }
+    bool take = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_)
+      {
+        return;
+      }
+      take = ownPending_;
+      ownPending_ = false;
+    }
+    if (take)
+    {
+      XSetSelectionOwner(display_, clipboard_, window_, CurrentTime);
+      ownsClipboard_ = XGetSelectionOwner(display_, clipboard_) == window_;
+    }
+  }
+}
+
+void WebviewClipboardOwner::handleEvent(const XEvent &event)
+{
+  if (event.type == SelectionClear)
+  {
+    // Something else was copied; stop answering.
+    if (event.xselectionclear.selection == clipboard_)
+    {
+      ownsClipboard_ = false;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!ownPending_)
+      {
+        ownedText_.clear();
+      }
+    }
+    return;
+  }
+  if (event.type != SelectionRequest)
+  {
+    return;
+  }
+  const XSelectionRequestEvent &request = event.xselectionrequest;
+  const bool owned = request.selection == clipboard_ && ownsClipboard_;
+  // Obsolete clients leave the property unset and mean the target.
+  const Atom property = request.property != None ? request.property : request.target;
+  XSelectionEvent reply = {};
+  reply.type = SelectionNotify;
+  reply.display = request.display;
+  reply.requestor = request.requestor;
+  reply.selection = request.selection;
+  reply.target = request.target;
+  reply.time = request.time;
+  reply.property = owned && answer(request.requestor, property, request.target) ? property : None;
+  XSendEvent(display_, request.requestor, False, NoEventMask, reinterpret_cast<XEvent *>(&reply));
+  XFlush(display_);
+}
+
+bool WebviewClipboardOwner::answer(Window requestor, Atom property, Atom target)
+{
+  if (target == targets_)
+  {
+    const Atom supported[] = {targets_, utf8String_, plainUtf8_, text_};
+    XChangeProperty(display_, requestor, property, XA_ATOM, 32, PropModeReplace,
+                    reinterpret_cast<const unsigned char *>(supported), sizeof(supported) / sizeof(supported[0]));
+    return true;
+  }
+  if (target != utf8String_ && target != plainUtf8_ && target != text_)
+  {
+    return false;
+  }
+  std::string text;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    text = ownedText_;
+  }
+  if (text.size() > maxPropertyBytes_)
+  {
+    return false;
+  }
+  XChangeProperty(display_, requestor, property, target == plainUtf8_ ? plainUtf8_ : utf8String_, 8, PropModeReplace,
+                  reinterpret_cast<const unsigned char *>(text.data()), int(text.size()));
+  return true;
+}
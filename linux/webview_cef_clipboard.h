@@ -0,0 +1,59 @@
+#ifndef WEBVIEW_CEF_CLIPBOARD_H_
+#define WEBVIEW_CEF_CLIPBOARD_H_
+
+#include <X11/Xlib.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Owns the X CLIPBOARD selection for text copied in this process and
+// answers requests for it on a thread of its own, over its own X connection.
+//
+// CEF runs on the GTK main thread and reads the clipboard synchronously
+// when it pastes. If GTK owned the text, CEF would wait for an answer only
+// the thread it blocks can give, and the UI would freeze until the read
+// timed out. Serving the selection from this thread keeps the GTK main loop
+// out of that exchange without handing the text to another process.
+class WebviewClipboardOwner
+{
+public:
+  WebviewClipboardOwner();
+  ~WebviewClipboardOwner();
+
+  // False without an X display, e.g. under Wayland without XWayland.
+  bool isAvailable() const { return display_ != nullptr; }
+  // Takes the clipboard with |text|. Returns at once; the thread
+  // takes ownership.
+  void own(const std::string &text);
+
+private:
+  void run();
+  void handleEvent(const XEvent &event);
+  // Stores the answer for |target| in |property| of |requestor|, or returns
+  // false if the target is not served.
+  bool answer(Window requestor, Atom property, Atom target);
+  void wake();
+
+  Display *display_ = nullptr;
+  Window window_ = 0;
+  Atom clipboard_ = 0;
+  Atom targets_ = 0;
+  Atom utf8String_ = 0;
+  Atom text_ = 0;
+  Atom plainUtf8_ = 0;
+  // Larger answers would need the INCR protocol, which is not implemented.
+  size_t maxPropertyBytes_ = 0;
+  int wakePipe_[2] = {-1, -1};
+  std::thread thread_;
+  // Only the thread touches this.
+  bool ownsClipboard_ = false;
+
+  std::mutex mutex_;
+  std::string ownedText_;
+  // Set by own() for the thread to take the clipboard.
+  bool ownPending_ = false;
+  bool stopping_ = false;
+};
+
+#endif // WEBVIEW_CEF_CLIPBOARD_H_
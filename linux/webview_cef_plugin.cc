@@ -7,6 +7,7 @@
 #include <cstring>
 #include <unordered_map>
 #include <webview_plugin.h>
+#include "webview_cef_clipboard.h"
 #include "webview_cef_keyevent.h"
 #include "webview_cef_texture.h"
 
@@ -40,18 +41,21 @@ public:
   virtual ~WebviewTextureRenderer()
   {
     fl_texture_registrar_unregister_texture(register_, FL_TEXTURE(texture));
+    g_object_unref(texture);
     register_ = nullptr;
   }
 
-  virtual void onFrame(const void *buffer, int32_t width, int32_t height) override
+  virtual void onFrame(const webview_cef::WebviewFrame &frame) override
   {
-    texture->width = width;
-    texture->height = height;
-    const auto size = width * height * 4;
-    delete texture->buffer;
-    texture->buffer = new uint8_t[size];
-    webview_cef::SwapBufferFromBgraToRgba((void *)texture->buffer, buffer, width, height);
-    fl_texture_registrar_mark_texture_frame_available(register_, FL_TEXTURE(texture));
+    if (texture->pool->produce(frame))
+    {
+      fl_texture_registrar_mark_texture_frame_available(register_, FL_TEXTURE(texture));
+    }
+  }
+
+  virtual webview_cef::WebviewFramePool *framePool() override
+  {
+    return texture->pool;
   }
   FlTextureRegistrar *register_;
   WebviewCefTexture *texture;
@@ -230,12 +234,64 @@ static void webview_cef_plugin_handle_method_call(
   webview_value_unref(encodeArgs);
 }
 
+// CEF reads the clipboard synchronously on this thread when it pastes. If
+// GTK owned text copied in Flutter, that read would wait for an answer only
+// this same thread can give, and the UI would freeze until it timed out. The
+// text is therefore moved to a WebviewClipboardOwner as soon as it is copied.
+static std::unique_ptr<WebviewClipboardOwner> clipboardOwner;
+
+static void onClipboardText(GtkClipboard *clipboard, const gchar *text, gpointer data)
+{
+  if (text != nullptr && clipboardOwner != nullptr)
+  {
+    clipboardOwner->own(text);
+  }
+}
+
+static void takeClipboardFromGtk()
+{
+  // Another process owns the clipboard, so CEF can read it directly.
+  if (clipboardOwner == nullptr || gdk_selection_owner_get(GDK_SELECTION_CLIPBOARD) == nullptr)
+  {
+    return;
+  }
+  gtk_clipboard_request_text(gtk_clipboard_get(GDK_SELECTION_CLIPBOARD), onClipboardText, nullptr);
+}
+
+static void onClipboardOwnerChange(GtkClipboard *clipboard, GdkEvent *event, gpointer data)
+{
+  takeClipboardFromGtk();
+}
+
+static void startClipboardOwner()
+{
+  if (clipboardOwner != nullptr)
+  {
+    return;
+  }
+  clipboardOwner = std::make_unique<WebviewClipboardOwner>();
+  if (!clipboardOwner->isAvailable())
+  {
+    g_warning("No X display, text copied in the app cannot be pasted into CEF");
+    clipboardOwner = nullptr;
+    return;
+  }
+  static bool connected = false;
+  if (!connected)
+  {
+    g_signal_connect(gtk_clipboard_get(GDK_SELECTION_CLIPBOARD), "owner-change", G_CALLBACK(onClipboardOwnerChange), nullptr);
+    connected = true;
+  }
+  takeClipboardFromGtk();
+}
+
 static void webview_cef_plugin_dispose(GObject *object)
 {
   webviewPlugins.erase(WEBVIEW_CEF_PLUGIN(object)->m_window);
   WEBVIEW_CEF_PLUGIN(object)->m_plugin = nullptr; 
   if(webviewPlugins.empty()){
     webview_cef::stopCEF();
+    clipboardOwner = nullptr;
   }
   G_OBJECT_CLASS(webview_cef_plugin_parent_class)->dispose(object);
 }
@@ -263,6 +319,7 @@ void webview_cef_plugin_register_with_registrar(FlPluginRegistrar *registrar)
 
   plugin->m_window = int64_t(fl_plugin_registrar_get_view(registrar));
   webviewPlugins.emplace(plugin->m_window, plugin->m_plugin);
+  startClipboardOwner();
 
   plugin->m_textureRegister = fl_plugin_registrar_get_texture_registrar(registrar);
 
@@ -324,12 +381,8 @@ FLUTTER_PLUGIN_EXPORT gboolean processKeyEventForCEF(GtkWidget *widget, GdkEvent
     }
     else if((windows_key_code == KeyboardCode::VKEY_V) && (key_event.modifiers & EVENTFLAG_CONTROL_DOWN) && (event->type == GDK_KEY_PRESS)){
       //try to fix copy request freeze process problem(flutter engine will send a copy request when ctrl+v pressed)
-      int res = 0;
-      if(system("xclip -o -sel clipboard | xclip -i -sel clipboard  &>/dev/null") == 0){
-        res = system("xclip -o -sel clipboard | xclip -i &>/dev/null");
-      }
-      // Suppress unused variable warning
-      (void)res;
+      //the text normally left GTK when it was copied, this catches a copy made before the owner started
+      takeClipboardFromGtk();
     }
     else {
       // FIXME: fix for non BMP chars
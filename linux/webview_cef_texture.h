@@ -3,12 +3,12 @@
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
+#include <webview_frame_pool.h>
 
 struct WebviewCefTexture{
     FlPixelBufferTexture parent_instance;
-    uint8_t *buffer = nullptr; // your pixel buffer.
-    uint32_t width = 0;
-    uint32_t height = 0;
+    // Filled by WebviewTextureRenderer::onFrame, drained by copy_pixels.
+    webview_cef::WebviewFramePool *pool;
 };
 
 struct WebviewCefTextureClass{
@@ -39,20 +39,39 @@ static gboolean webview_cef_texture_copy_pixels(FlPixelBufferTexture *texture,
     if(_texture == nullptr){
         return TRUE;
     }
-    *out_buffer = _texture->buffer;
-    *width = _texture->width;
-    *height = _texture->height;
+    const webview_cef::WebviewFramePool::Surface *surface = _texture->pool->consume();
+    if(surface == nullptr){
+        *out_buffer = nullptr;
+        *width = 0;
+        *height = 0;
+        return TRUE;
+    }
+    *out_buffer = surface->pixels.data();
+    *width = surface->width;
+    *height = surface->height;
     return TRUE;
 }
 static WebviewCefTexture* webview_cef_texture_new(){
     return WEBVIEW_CEF_TEXTURE(g_object_new(webview_cef_texture_get_type(), nullptr));
 }
 
+static void webview_cef_texture_finalize(GObject *object)
+{
+    WebviewCefTexture *self = WEBVIEW_CEF_TEXTURE(object);
+    delete self->pool;
+    self->pool = nullptr;
+    G_OBJECT_CLASS(webview_cef_texture_parent_class)->finalize(object);
+}
+
 static void webview_cef_texture_class_init(WebviewCefTextureClass *klass)
 {
+    G_OBJECT_CLASS(klass)->finalize = webview_cef_texture_finalize;
     FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels = webview_cef_texture_copy_pixels;
 }
-static void webview_cef_texture_init(WebviewCefTexture *self) {}
+static void webview_cef_texture_init(WebviewCefTexture *self)
+{
+    self->pool = new webview_cef::WebviewFramePool();
+}
 
 
 #endif // WEBVIEW_CEF_TEXTURE_H_
@@ -38,8 +38,8 @@ public:
         [textureRegistry unregisterTexture:textureId];
     }
 
-    virtual void onFrame(const void* buffer, int width, int height) {
-        [texture onFrame:buffer width:width height:height];
+    virtual void onFrame(const webview_cef::WebviewFrame& frame) {
+        [texture onFrame:frame.buffer width:frame.width height:frame.height];
         [textureRegistry textureFrameAvailable: textureId];
     }
 
@@ -115,6 +115,23 @@ private:
     } else if([value isKindOfClass:[NSString class]]) {
         NSString* string = (NSString*)value;
         return webview_value_new_string([string UTF8String]);
+    } else if([value isKindOfClass:[FlutterStandardTypedData class]]) {
+        FlutterStandardTypedData* typed = (FlutterStandardTypedData*)value;
+        const void* bytes = typed.data.bytes;
+        switch(typed.type) {
+            case FlutterStandardDataTypeUInt8:
+                return webview_value_new_uint8_list((const uint8_t*)bytes, typed.elementCount);
+            case FlutterStandardDataTypeInt32:
+                return webview_value_new_int32_list((const int32_t*)bytes, typed.elementCount);
+            case FlutterStandardDataTypeInt64:
+                return webview_value_new_int64_list((const int64_t*)bytes, typed.elementCount);
+            case FlutterStandardDataTypeFloat32:
+                return webview_value_new_float_list((const float*)bytes, typed.elementCount);
+            case FlutterStandardDataTypeFloat64:
+                return webview_value_new_double_list((const double*)bytes, typed.elementCount);
+            default:
+                return nil;
+        }
     } else if([value isKindOfClass:[NSData class]]) {
         NSData* data = (NSData*)value;
         return webview_value_new_int64_list((int64_t*)data.bytes, (size_t)data.length);
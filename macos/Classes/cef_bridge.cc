@@ -8,4 +8,15 @@
 #include "../../common/webview_js_handler.cc"
 #include "../../common/webview_plugin.cc"
 #include "../../common/webview_value.cc"
+#include "../../common/webview_swizzle.cc"
+#include "../../common/webview_frame_pool.cc"
+#include "../../common/webview_worker_pool.cc"
+#include "../../common/webview_texture_atlas.cc"
+#include "../../common/webview_frame_export.cc"
+#include "../../common/webview_frame_recorder.cc"
+#include "../../common/webview_image.cc"
+#include "../../common/webview_frame_capture.cc"
+#include "../../common/webview_thumbnail_cache.cc"
+#include "../../common/webview_render_stats.cc"
+#include "../../common/webview_input_log.cc"
 #endif
@@ -0,0 +1,578 @@
+// Loads each fixtures/*.html into an offscreen browser through
+// WebviewPlugin, with the method calls the Dart side makes. It waits until
+// the page has loaded and stopped painting, then compares the frame with
+// goldens/<name>.qoi through compareFrame. A differing fixture gets its
+// diff image (<name>.diff.png) and actual frame (<name>.qoi) written to the
+// output directory. --update rewrites the goldens instead.
+//
+// With --replay it is a benchmark instead: it replays an input log
+// (replayInput) into one fixture at --speed times its recorded pace and
+// prints the render stats of onInputReplayFinished. --record writes such a
+// log: it records (startInputRecording) a session of pointer sweeps, wheel
+// scrolling, a drag and page keys sent in real time through the calls the
+// Dart side makes.
+//
+//   webview_frame_harness --fixtures=DIR --goldens=DIR --out=DIR
+//                         [--update] [--tolerance=N] [CEF switches]
+//   webview_frame_harness --replay=LOG --replay-fixture=HTML [--speed=S]
+//                         [CEF switches]
+//   webview_frame_harness --record=LOG --replay-fixture=HTML
+//                         [CEF switches]
+
+#include "webview_plugin.h"
+#include "webview_image.h"
+#include "webview_input_log.h"
+#include "webview_test_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace webview_cef;
+namespace fs = std::filesystem;
+
+static const int kViewportWidth = 320;
+static const int kViewportHeight = 240;
+static const int kDefaultTolerance = 2;
+// A page is settled once it has loaded and not painted for this long.
+static const std::chrono::milliseconds kSettleTime(300);
+static const std::chrono::seconds kCallTimeout(20);
+// How often the Dart side flushes pointer input.
+static const std::chrono::milliseconds kInputFrame(16);
+
+class HarnessTexture : public WebviewTexture
+{
+public:
+	void onFrame(const WebviewFrame &) override
+	{
+		frames++;
+		lastFrame = std::chrono::steady_clock::now();
+	}
+
+	int frames = 0;
+	std::chrono::steady_clock::time_point lastFrame;
+};
+
+struct Options
+{
+	std::string fixtures;
+	std::string goldens;
+	std::string out;
+	bool update = false;
+	int tolerance = kDefaultTolerance;
+	std::string replay;
+	std::string record;
+	std::string replayFixture;
+	double speed = 1.0;
+};
+
+static bool optionValue(const char *arg, const char *name, std::string &value)
+{
+	const size_t length = strlen(name);
+	if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+	{
+		return false;
+	}
+	value = arg + length + 1;
+	return true;
+}
+
+// CEF runs on this thread (doMessageLoopWork), as in the Linux plugin.
+static bool pumpUntil(const std::function<bool()> &done, std::chrono::steady_clock::duration timeout)
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (!done())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		doMessageLoopWork();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+static WValue *newList(std::initializer_list<WValue *> items)
+{
+	WValue *list = webview_value_new_list();
+	for (WValue *item : items)
+	{
+		webview_value_append(list, item);
+		webview_value_unref(item);
+	}
+	return list;
+}
+
+// Makes a method call and waits for its result. Takes |args|; the caller
+// unrefs the returned value.
+static WValue *call(WebviewPlugin &plugin, const char *method, WValue *args)
+{
+	struct Reply
+	{
+		bool done = false;
+		int status = 0;
+		WValue *value = nullptr;
+	};
+	auto reply = std::make_shared<Reply>();
+	plugin.HandleMethodCall(method, args, [reply](int status, WValue *value)
+							{
+		reply->done = true;
+		reply->status = status;
+		reply->value = value != nullptr ? webview_value_ref(value) : nullptr; });
+	if (args != nullptr)
+	{
+		webview_value_unref(args);
+	}
+	if (!pumpUntil([&]()
+				   { return reply->done; },
+				   kCallTimeout))
+	{
+		fprintf(stderr, "%s: no result\n", method);
+		return nullptr;
+	}
+	if (reply->status != 1)
+	{
+		fprintf(stderr, "%s failed\n", method);
+		if (reply->value != nullptr)
+		{
+			webview_value_unref(reply->value);
+		}
+		return nullptr;
+	}
+	return reply->value != nullptr ? reply->value : webview_value_new_null();
+}
+
+// Makes a method call that may not reply.
+static void send(WebviewPlugin &plugin, const char *method, WValue *args)
+{
+	plugin.HandleMethodCall(method, args, [](int, WValue *) {});
+	webview_value_unref(args);
+}
+
+static bool saveBytes(WValue *bytes, const std::string &path)
+{
+	const uint8_t *data = bytes != nullptr ? webview_value_get_uint8_list(bytes) : nullptr;
+	if (data == nullptr)
+	{
+		return false;
+	}
+	return writeFile(path, std::vector<uint8_t>(data, data + webview_value_get_len(bytes)));
+}
+
+// The current viewport as QOI, written to |path|.
+static bool captureViewport(WebviewPlugin &plugin, int browserId, const std::string &path)
+{
+	WValue *qoi = call(plugin, "captureFrame", newList({webview_value_new_int(browserId), webview_value_new_string("qoi"), webview_value_new_int(0), webview_value_new_int(0), webview_value_new_int(kViewportWidth), webview_value_new_int(kViewportHeight), webview_value_new_int(kViewportWidth), webview_value_new_int(kViewportHeight), webview_value_new_bool(false)}));
+	const bool saved = saveBytes(qoi, path);
+	if (qoi != nullptr)
+	{
+		webview_value_unref(qoi);
+	}
+	return saved;
+}
+
+// Opens |fixture| in a viewport-sized browser and waits for it to settle.
+// Returns the browser id, or -1 if it was not created; |settled| tells
+// whether it loaded and stopped painting in time.
+static int openFixture(WebviewPlugin &plugin, const fs::path &fixture, std::shared_ptr<HarnessTexture> &created,
+					   const std::set<int> &loaded, bool &settled)
+{
+	const std::string url = "file://" + fs::absolute(fixture).string();
+	WValue *ids = call(plugin, "create", newList({webview_value_new_string(url.c_str())}));
+	if (ids == nullptr)
+	{
+		fprintf(stderr, "%s: browser not created\n", fixture.stem().string().c_str());
+		return -1;
+	}
+	const int browserId = int(webview_value_get_int(webview_value_get_list_value(ids, 0)));
+	webview_value_unref(ids);
+	std::shared_ptr<HarnessTexture> texture = created;
+
+	WValue *sized = call(plugin, "setSize", newList({webview_value_new_int(browserId), webview_value_new_double(1.0), webview_value_new_double(kViewportWidth), webview_value_new_double(kViewportHeight)}));
+	if (sized != nullptr)
+	{
+		webview_value_unref(sized);
+	}
+	settled = pumpUntil([&]()
+						{ return loaded.count(browserId) > 0 && texture->frames > 0 &&
+								 std::chrono::steady_clock::now() - texture->lastFrame >= kSettleTime; },
+						kCallTimeout);
+	return browserId;
+}
+
+// Returns true if the settled frame matches the golden (or the golden was
+// written).
+static bool runFixture(WebviewPlugin &plugin, const Options &options, const fs::path &fixture,
+					   std::shared_ptr<HarnessTexture> &created, const std::set<int> &loaded)
+{
+	const std::string name = fixture.stem().string();
+	bool settled = false;
+	const int browserId = openFixture(plugin, fixture, created, loaded, settled);
+	if (browserId < 0)
+	{
+		return false;
+	}
+
+	bool passed = false;
+	const std::string goldenPath = options.goldens + "/" + name + ".qoi";
+	WebviewImage golden;
+	if (!settled)
+	{
+		fprintf(stderr, "%s: did not settle\n", name.c_str());
+	}
+	else if (options.update)
+	{
+		passed = captureViewport(plugin, browserId, goldenPath);
+		printf("%s: %s\n", name.c_str(), passed ? "golden written" : "capture failed");
+	}
+	else if (!loadQoiFile(goldenPath, golden))
+	{
+		fprintf(stderr, "%s: no golden at %s, run with --update\n", name.c_str(), goldenPath.c_str());
+	}
+	else
+	{
+		WValue *diff = call(plugin, "compareFrame", newList({webview_value_new_int(browserId), webview_value_new_uint8_list(golden.pixels.data(), golden.pixels.size()), webview_value_new_int(golden.width), webview_value_new_int(golden.height), webview_value_new_int(options.tolerance), webview_value_new_bool(true)}));
+		if (diff != nullptr)
+		{
+			const bool sameSize = webview_value_get_bool(webview_value_get_by_string(diff, "sameSize"));
+			const int64_t differing = webview_value_get_int(webview_value_get_by_string(diff, "differingPixels"));
+			printf("%s: %s, %lld differing pixels, max delta %lld, mean delta %.4f\n", name.c_str(),
+				   sameSize ? "same size" : "different size", (long long)differing,
+				   (long long)webview_value_get_int(webview_value_get_by_string(diff, "maxDelta")),
+				   webview_value_get_double(webview_value_get_by_string(diff, "meanDelta")));
+			passed = sameSize && differing == 0;
+			if (!passed)
+			{
+				saveBytes(webview_value_get_by_string(diff, "diffImage"), options.out + "/" + name + ".diff.png");
+				captureViewport(plugin, browserId, options.out + "/" + name + ".qoi");
+			}
+			webview_value_unref(diff);
+		}
+	}
+	send(plugin, "close", webview_value_new_int(browserId));
+	return passed;
+}
+
+static void printHistogram(const char *label, WValue *histogram)
+{
+	if (histogram == nullptr)
+	{
+		return;
+	}
+	printf("%s: %lld samples, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n", label,
+		   (long long)webview_value_get_int(webview_value_get_by_string(histogram, "count")),
+		   webview_value_get_double(webview_value_get_by_string(histogram, "p50Ms")),
+		   webview_value_get_double(webview_value_get_by_string(histogram, "p95Ms")),
+		   webview_value_get_double(webview_value_get_by_string(histogram, "p99Ms")),
+		   webview_value_get_double(webview_value_get_by_string(histogram, "maxMs")));
+}
+
+static void pumpFor(std::chrono::steady_clock::duration duration)
+{
+	pumpUntil([]()
+			  { return false; },
+			  duration);
+}
+
+// Sends the records queued during one input frame, as the Dart side does
+// once per frame.
+static void flushInput(WebviewPlugin &plugin, int browserId, std::vector<int32_t> &records)
+{
+	if (!records.empty())
+	{
+		send(plugin, "sendInputBatch", newList({webview_value_new_int(browserId), webview_value_new_int32_list(records.data(), records.size())}));
+		records.clear();
+	}
+	pumpFor(kInputFrame);
+}
+
+static void queueInput(std::vector<int32_t> &records, int kind, int x, int y, int a = 0, int b = 0)
+{
+	records.insert(records.end(), {kind, x, y, a, b});
+}
+
+static void pressKey(WebviewPlugin &plugin, int windowsKeyCode)
+{
+	CefKeyEvent key;
+	key.windows_key_code = windowsKeyCode;
+	key.type = KEYEVENT_RAWKEYDOWN;
+	plugin.sendKeyEvent(key);
+	pumpFor(kInputFrame * 5);
+	key.type = KEYEVENT_KEYUP;
+	plugin.sendKeyEvent(key);
+	pumpFor(kInputFrame * 20);
+}
+
+// Records a session on the replay fixture once it has settled. Returns
+// true if the log was written.
+static bool runRecording(WebviewPlugin &plugin, const Options &options, std::shared_ptr<HarnessTexture> &created,
+						 const std::set<int> &loaded)
+{
+	bool settled = false;
+	const int browserId = openFixture(plugin, options.replayFixture, created, loaded, settled);
+	if (browserId < 0 || !settled)
+	{
+		fprintf(stderr, "%s: did not settle\n", options.replayFixture.c_str());
+		return false;
+	}
+	// Keys go to the focused browser.
+	WValue *focused = call(plugin, "setClientFocus", newList({webview_value_new_int(browserId), webview_value_new_bool(true)}));
+	WValue *started = call(plugin, "startInputRecording", newList({webview_value_new_int(browserId), webview_value_new_string(options.record.c_str())}));
+	if (focused != nullptr)
+	{
+		webview_value_unref(focused);
+	}
+	if (started == nullptr)
+	{
+		send(plugin, "close", webview_value_new_int(browserId));
+		return false;
+	}
+	webview_value_unref(started);
+
+	const int centerX = kViewportWidth / 2;
+	const int centerY = kViewportHeight / 2;
+	std::vector<int32_t> records;
+	// A pointer sweep, two moves a frame.
+	for (int i = 0; i < 60; i++)
+	{
+		queueInput(records, WebviewPlugin::kInputMove, i * kViewportWidth / 120, i * kViewportHeight / 120);
+		queueInput(records, WebviewPlugin::kInputMove, (2 * i + 1) * kViewportWidth / 240, (2 * i + 1) * kViewportHeight / 240);
+		flushInput(plugin, browserId, records);
+	}
+	// Wheel notches down the feed and part of the way back, each preceded
+	// by the zero delta the widget sends first.
+	for (int i = 0; i < 30; i++)
+	{
+		const int delta = i < 20 ? 100 : -100;
+		queueInput(records, WebviewPlugin::kInputScroll, centerX, centerY, 0, 0);
+		queueInput(records, WebviewPlugin::kInputScroll, centerX, centerY, 0, delta);
+		flushInput(plugin, browserId, records);
+		flushInput(plugin, browserId, records);
+		flushInput(plugin, browserId, records);
+	}
+	// A drag across the feed with the primary button.
+	queueInput(records, WebviewPlugin::kInputDown, 40, centerY, 1);
+	flushInput(plugin, browserId, records);
+	for (int i = 0; i < 40; i++)
+	{
+		queueInput(records, WebviewPlugin::kInputDrag, 40 + i * 6, centerY - i * 2);
+		flushInput(plugin, browserId, records);
+	}
+	queueInput(records, WebviewPlugin::kInputUp, 280, centerY - 80, 1);
+	flushInput(plugin, browserId, records);
+	// Page keys, down twice and up once.
+	pressKey(plugin, 0x22);
+	pressKey(plugin, 0x22);
+	pressKey(plugin, 0x21);
+
+	WValue *stats = call(plugin, "stopInputRecording", webview_value_new_int(browserId));
+	bool recorded = false;
+	if (stats != nullptr)
+	{
+		recorded = !webview_value_get_bool(webview_value_get_by_string(stats, "failed"));
+		printf("recorded %lld events, %lld bytes to %s\n",
+			   (long long)webview_value_get_int(webview_value_get_by_string(stats, "events")),
+			   (long long)webview_value_get_int(webview_value_get_by_string(stats, "bytes")), options.record.c_str());
+		webview_value_unref(stats);
+	}
+	send(plugin, "close", webview_value_new_int(browserId));
+	return recorded;
+}
+
+// Replays the log into the replay fixture once it has settled. Returns
+// true if every event was dispatched.
+static bool runReplay(WebviewPlugin &plugin, const Options &options, std::shared_ptr<HarnessTexture> &created,
+					  const std::set<int> &loaded, WValue *const &finished)
+{
+	std::vector<WebviewInputEvent> events;
+	if (!loadInputLog(options.replay, events) || events.empty())
+	{
+		fprintf(stderr, "%s: no events to replay\n", options.replay.c_str());
+		return false;
+	}
+	bool settled = false;
+	const int browserId = openFixture(plugin, options.replayFixture, created, loaded, settled);
+	if (browserId < 0 || !settled)
+	{
+		fprintf(stderr, "%s: did not settle\n", options.replayFixture.c_str());
+		return false;
+	}
+
+	WValue *count = call(plugin, "replayInput", newList({webview_value_new_int(browserId), webview_value_new_string(options.replay.c_str()), webview_value_new_double(options.speed)}));
+	if (count != nullptr)
+	{
+		webview_value_unref(count);
+	}
+	const auto logDuration = std::chrono::microseconds(events.back().micros);
+	const bool done = count != nullptr &&
+					  pumpUntil([&]()
+								{ return finished != nullptr; },
+								std::chrono::duration_cast<std::chrono::microseconds>(logDuration / std::max(options.speed, 0.01)) + kCallTimeout);
+	bool completed = false;
+	if (!done)
+	{
+		fprintf(stderr, "%s: replay did not finish\n", options.replay.c_str());
+	}
+	else
+	{
+		completed = webview_value_get_bool(webview_value_get_by_string(finished, "completed"));
+		printf("replay: %lld/%zu events in %.1f ms at %.2fx (%s)\n",
+			   (long long)webview_value_get_int(webview_value_get_by_string(finished, "events")), events.size(),
+			   webview_value_get_double(webview_value_get_by_string(finished, "durationMs")), options.speed,
+			   completed ? "completed" : "stopped");
+		WValue *stats = webview_value_get_by_string(finished, "renderStats");
+		if (stats != nullptr)
+		{
+			printf("paints: %lld at %.1f fps, %lld dirty pixels\n",
+				   (long long)webview_value_get_int(webview_value_get_by_string(stats, "paints")),
+				   webview_value_get_double(webview_value_get_by_string(stats, "paintFps")),
+				   (long long)webview_value_get_int(webview_value_get_by_string(stats, "dirtyPixels")));
+			printf("moves: %lld, coalesced %lld\n",
+				   (long long)webview_value_get_int(webview_value_get_by_string(stats, "moves")),
+				   (long long)webview_value_get_int(webview_value_get_by_string(stats, "coalescedMoves")));
+			printHistogram("paint time", webview_value_get_by_string(stats, "paintTime"));
+			printHistogram("input to paint", webview_value_get_by_string(stats, "inputToPaint"));
+		}
+	}
+	send(plugin, "close", webview_value_new_int(browserId));
+	return completed;
+}
+
+int main(int argc, char **argv)
+{
+	CefMainArgs mainArgs(argc, argv);
+	// CEF starts its helper processes from this binary; they return here
+	// when done.
+	initCEFProcesses(mainArgs);
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--type=", 7) == 0)
+		{
+			return 0;
+		}
+	}
+
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string tolerance;
+		std::string speed;
+		if (optionValue(argv[i], "--tolerance", tolerance))
+		{
+			options.tolerance = atoi(tolerance.c_str());
+		}
+		else if (optionValue(argv[i], "--speed", speed))
+		{
+			options.speed = atof(speed.c_str());
+		}
+		else if (strcmp(argv[i], "--update") == 0)
+		{
+			options.update = true;
+		}
+		else
+		{
+			optionValue(argv[i], "--fixtures", options.fixtures);
+			optionValue(argv[i], "--goldens", options.goldens);
+			optionValue(argv[i], "--out", options.out);
+			optionValue(argv[i], "--replay", options.replay);
+			optionValue(argv[i], "--record", options.record);
+			optionValue(argv[i], "--replay-fixture", options.replayFixture);
+		}
+	}
+	const bool record = !options.record.empty() && !options.replayFixture.empty();
+	const bool replay = !record && !options.replay.empty() && !options.replayFixture.empty();
+	if (!record && !replay && (options.fixtures.empty() || options.goldens.empty() || options.out.empty()))
+	{
+		fprintf(stderr, "usage: %s --fixtures=DIR --goldens=DIR --out=DIR [--update] [--tolerance=N]\n"
+						"       %s --replay=LOG --replay-fixture=HTML [--speed=S]\n"
+						"       %s --record=LOG --replay-fixture=HTML\n",
+				argv[0], argv[0], argv[0]);
+		return 2;
+	}
+
+	std::vector<fs::path> fixtures;
+	if (!record && !replay)
+	{
+		for (const fs::directory_entry &entry : fs::directory_iterator(options.fixtures))
+		{
+			if (entry.path().extension() == ".html")
+			{
+				fixtures.push_back(entry.path());
+			}
+		}
+		std::sort(fixtures.begin(), fixtures.end());
+		if (options.update)
+		{
+			fs::create_directories(options.goldens);
+		}
+	}
+
+	auto plugin = std::make_shared<WebviewPlugin>();
+	std::shared_ptr<HarnessTexture> created;
+	std::set<int> loaded;
+	WValue *finished = nullptr;
+	plugin->setCreateTextureFunc([&]()
+								 {
+		created = std::make_shared<HarnessTexture>();
+		return std::static_pointer_cast<WebviewTexture>(created); });
+	plugin->setInvokeMethodFunc([&](std::string method, WValue *args)
+								{
+		if (method == "onLoadEnd")
+		{
+			loaded.insert(int(webview_value_get_int(webview_value_get_by_string(args, "browserId"))));
+		}
+		else if (method == "onInputReplayFinished" && finished == nullptr)
+		{
+			finished = webview_value_ref(args);
+		} });
+
+	int failed = 0;
+	WValue *init = call(*plugin, "init", nullptr);
+	if (init == nullptr)
+	{
+		failed = record || replay ? 1 : (int)fixtures.size();
+	}
+	else if (record)
+	{
+		webview_value_unref(init);
+		failed = !runRecording(*plugin, options, created, loaded);
+	}
+	else if (replay)
+	{
+		webview_value_unref(init);
+		failed = !runReplay(*plugin, options, created, loaded, finished);
+	}
+	else
+	{
+		webview_value_unref(init);
+		for (const fs::path &fixture : fixtures)
+		{
+			failed += !runFixture(*plugin, options, fixture, created, loaded);
+		}
+	}
+	if (finished != nullptr)
+	{
+		webview_value_unref(finished);
+	}
+
+	plugin.reset();
+	pumpUntil([]()
+			  { return false; },
+			  std::chrono::milliseconds(200));
+	stopCEF();
+	if (!record && !replay)
+	{
+		printf("%zu fixtures, %d failed\n", fixtures.size(), failed);
+	}
+	return failed == 0 ? 0 : 1;
+}
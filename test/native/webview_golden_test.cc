@@ -0,0 +1,138 @@
+// Checks the images in the directories given after the first argument:
+// each one decodes to an opaque viewport-sized image, a change beyond the
+// tolerance is found and highlighted where it was made, and noise within
+// it is not. These are images/, frames drawn to the fixtures' layout, and
+// goldens/ once the frame harness has captured it from CEF. The
+// highlights are written to the directory given as the first argument,
+// the way the harness writes them for failing fixtures.
+
+#include "webview_image.h"
+#include "webview_test_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace webview_cef;
+namespace fs = std::filesystem;
+
+static const int kViewportWidth = 320;
+static const int kViewportHeight = 240;
+static const int kTolerance = 2;
+
+static int failures = 0;
+
+#define EXPECT(condition, ...)                                           \
+	do                                                                   \
+	{                                                                    \
+		if (!(condition))                                                \
+		{                                                                \
+			failures++;                                                  \
+			fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #condition); \
+			fprintf(stderr, __VA_ARGS__);                                \
+			fprintf(stderr, "\n");                                       \
+		}                                                                \
+	} while (0)
+
+static bool isMarked(const WebviewImage &highlight, int x, int y)
+{
+	const uint8_t *p = &highlight.pixels[((size_t)y * highlight.width + x) * 4];
+	return p[0] == 0xff && p[1] == 0 && p[2] == 0 && p[3] == 0xff;
+}
+
+static void checkGolden(const fs::path &path, const std::string &outDir)
+{
+	// images/ and goldens/ share file names.
+	const std::string name = path.parent_path().filename().string() + "_" + path.stem().string();
+	WebviewImage golden;
+	if (!loadQoiFile(path.string(), golden))
+	{
+		EXPECT(false, "%s does not decode", name.c_str());
+		return;
+	}
+	EXPECT(golden.width == kViewportWidth && golden.height == kViewportHeight, "%s is %dx%d", name.c_str(), golden.width,
+		   golden.height);
+	EXPECT(isImageOpaque(golden), "%s is not opaque", name.c_str());
+
+	// Within the tolerance: every channel one step off.
+	WebviewImage noisy = golden;
+	for (size_t i = 0; i < noisy.pixels.size(); i++)
+	{
+		noisy.pixels[i] = (uint8_t)(noisy.pixels[i] < 0xff ? noisy.pixels[i] + 1 : noisy.pixels[i] - 1);
+	}
+	const WebviewImageDiff noise = diffImages(golden, noisy, kTolerance, false);
+	EXPECT(noise.sameSize && noise.differingPixels == 0 && noise.maxDelta == 1, "%s: %llu pixels differ by noise",
+		   name.c_str(), (unsigned long long)noise.differingPixels);
+
+	// A regression: a 12x8 block inverted.
+	WebviewImage broken = golden;
+	const int left = 150, top = 110;
+	for (int y = top; y < top + 8; y++)
+	{
+		for (int x = left; x < left + 12; x++)
+		{
+			uint8_t *p = &broken.pixels[((size_t)y * broken.width + x) * 4];
+			p[0] = 0xff - p[0];
+			p[1] = 0xff - p[1];
+			p[2] = 0xff - p[2];
+		}
+	}
+	const WebviewImageDiff diff = diffImages(golden, broken, kTolerance, true);
+	EXPECT(diff.differingPixels == 96, "%s: %llu differing pixels", name.c_str(), (unsigned long long)diff.differingPixels);
+	bool marked = true;
+	for (int y = 0; y < golden.height; y++)
+	{
+		for (int x = 0; x < golden.width; x++)
+		{
+			const bool inside = x >= left && x < left + 12 && y >= top && y < top + 8;
+			marked &= isMarked(diff.highlight, x, y) == inside;
+		}
+	}
+	EXPECT(marked, "%s: the highlight does not mark the changed block", name.c_str());
+
+	const std::vector<uint8_t> png = encodePng(diff.highlight);
+	const std::string diffPath = outDir + "/" + name + ".diff.png";
+	EXPECT(writeFile(diffPath, png), "cannot write %s", diffPath.c_str());
+#ifdef WEBVIEW_TEST_ZLIB
+	WebviewImage written;
+	EXPECT(decodePng(png, written) && written.pixels == diff.highlight.pixels, "%s: diff PNG does not decode",
+		   name.c_str());
+#endif
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <output dir> <image dir>...\n", argv[0]);
+		return 2;
+	}
+	std::vector<fs::path> goldens;
+	for (int i = 2; i < argc; i++)
+	{
+		std::vector<fs::path> images;
+		for (const fs::directory_entry &entry : fs::directory_iterator(argv[i]))
+		{
+			if (entry.path().extension() == ".qoi")
+			{
+				images.push_back(entry.path());
+			}
+		}
+		std::sort(images.begin(), images.end());
+		EXPECT(!images.empty(), "no images in %s", argv[i]);
+		goldens.insert(goldens.end(), images.begin(), images.end());
+	}
+	for (const fs::path &path : goldens)
+	{
+		checkGolden(path, argv[1]);
+	}
+	if (failures > 0)
+	{
+		fprintf(stderr, "%d failures\n", failures);
+		return 1;
+	}
+	printf("%zu goldens checked\n", goldens.size());
+	return 0;
+}
@@ -0,0 +1,382 @@
+// Checks the pixel kernels against straightforward reference code, every
+// compiled-in SIMD kernel against the scalar one, and the encoders by
+// decoding what they write. Diff highlights are written as PNGs to the
+// directory given as the first argument.
+
+#include "webview_image.h"
+#include "webview_swizzle.h"
+#include "webview_test_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace webview_cef;
+
+static int failures = 0;
+
+#define EXPECT(condition, ...)                                           \
+	do                                                                   \
+	{                                                                    \
+		if (!(condition))                                                \
+		{                                                                \
+			failures++;                                                  \
+			fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #condition); \
+			fprintf(stderr, __VA_ARGS__);                                \
+			fprintf(stderr, "\n");                                       \
+		}                                                                \
+	} while (0)
+
+static std::mt19937 rng(1234);
+
+static std::vector<uint8_t> randomBytes(size_t size)
+{
+	std::vector<uint8_t> bytes(size);
+	for (uint8_t &byte : bytes)
+	{
+		byte = (uint8_t)rng();
+	}
+	return bytes;
+}
+
+// The kernels the CPU can run, scalar first.
+static std::vector<SwizzleKernel> supportedKernels()
+{
+	std::vector<SwizzleKernel> kernels;
+	for (int kernel = 0; kernel < kSwizzleKernelCount; kernel++)
+	{
+		if (getSwizzleFunc(SwizzleKernel(kernel)) != nullptr)
+		{
+			kernels.push_back(SwizzleKernel(kernel));
+		}
+	}
+	return kernels;
+}
+
+static void testSwizzle()
+{
+	for (SwizzleKernel kernel : supportedKernels())
+	{
+		SwizzleFunc swizzle = getSwizzleFunc(kernel);
+		for (size_t count : {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 1027})
+		{
+			const std::vector<uint8_t> src = randomBytes(count * 4);
+			std::vector<uint8_t> dest(count * 4);
+			swizzle(dest.data(), src.data(), count);
+			std::vector<uint8_t> inPlace = src;
+			swizzle(inPlace.data(), inPlace.data(), count);
+			for (size_t i = 0; i < count * 4; i++)
+			{
+				static const int kSource[4] = {2, 1, 0, 3};
+				const uint8_t expected = src[i / 4 * 4 + kSource[i % 4]];
+				if (dest[i] != expected || inPlace[i] != expected)
+				{
+					EXPECT(false, "%s, %zu pixels: byte %zu", getSwizzleKernelName(kernel), count, i);
+					break;
+				}
+			}
+		}
+	}
+}
+
+static void testHalveImage()
+{
+	const SwizzleKernel active = getActiveSwizzleKernel();
+	for (SwizzleKernel kernel : supportedKernels())
+	{
+		setActiveSwizzleKernel(kernel);
+		for (const auto &size : std::vector<std::pair<int, int>>{{1, 1}, {2, 2}, {3, 5}, {17, 9}, {64, 64}, {131, 37}})
+		{
+			const int width = size.first;
+			const int height = size.second;
+			const int stride = width * 4 + 12;
+			const std::vector<uint8_t> src = randomBytes((size_t)stride * height);
+			std::vector<uint8_t> dest((size_t)(width / 2) * (height / 2) * 4 + 1, 0xcd);
+			halveImage(src.data(), stride, width, height, dest.data());
+			bool same = true;
+			for (int y = 0; y < height / 2 && same; y++)
+			{
+				for (int x = 0; x < width / 2 * 4 && same; x++)
+				{
+					const uint8_t *top = &src[(size_t)y * 2 * stride];
+					const uint8_t *bottom = top + stride;
+					const int c = x % 4;
+					const int px = x / 4 * 8 + c;
+					const int left = (top[px] + bottom[px] + 1) >> 1;
+					const int right = (top[px + 4] + bottom[px + 4] + 1) >> 1;
+					same = dest[(size_t)y * (width / 2) * 4 + x] == ((left + right + 1) >> 1);
+				}
+			}
+			EXPECT(same, "%s, %dx%d", getSwizzleKernelName(kernel), width, height);
+			EXPECT(dest.back() == 0xcd, "%s, %dx%d: wrote past the image", getSwizzleKernelName(kernel), width, height);
+		}
+	}
+	setActiveSwizzleKernel(active);
+}
+
+struct I420 {
+	std::vector<uint8_t> y, u, v;
+};
+
+static I420 toI420(const std::vector<uint8_t> &src, int stride, int width, int height)
+{
+	I420 planes;
+	const size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+	planes.y.resize((size_t)width * height);
+	planes.u.resize(chroma);
+	planes.v.resize(chroma);
+	convertBgraToI420(src.data(), stride, width, height, planes.y.data(), planes.u.data(), planes.v.data());
+	return planes;
+}
+
+static void testConvertBgraToI420()
+{
+	// Known values: BT.601 limited range puts black at 16 and white at 235.
+	const std::vector<uint8_t> blackWhite = {0, 0, 0, 255, 255, 255, 255, 255};
+	const I420 known = toI420(blackWhite, 8, 2, 1);
+	EXPECT(known.y[0] == 16 && known.y[1] == 235, "luma %d %d", known.y[0], known.y[1]);
+	EXPECT(std::abs(known.u[0] - 128) <= 1 && std::abs(known.v[0] - 128) <= 1, "chroma %d %d", known.u[0], known.v[0]);
+
+	const SwizzleKernel active = getActiveSwizzleKernel();
+	for (const auto &size : std::vector<std::pair<int, int>>{{1, 1}, {3, 3}, {16, 2}, {33, 7}, {130, 41}})
+	{
+		const int width = size.first;
+		const int height = size.second;
+		const int stride = width * 4 + 8;
+		const std::vector<uint8_t> src = randomBytes((size_t)stride * height);
+
+		setActiveSwizzleKernel(kSwizzleScalar);
+		const I420 scalar = toI420(src, stride, width, height);
+		// Against the floating point definition; the integer coefficients
+		// and rounding put the result up to two steps off.
+		double worstLuma = 0;
+		double worstChroma = 0;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const uint8_t *p = &src[(size_t)y * stride + x * 4];
+				const double luma = 16 + 0.257 * p[2] + 0.504 * p[1] + 0.098 * p[0];
+				worstLuma = std::max(worstLuma, std::fabs(luma - scalar.y[(size_t)y * width + x]));
+			}
+		}
+		for (int y = 0; y < height; y += 2)
+		{
+			for (int x = 0; x < width; x += 2)
+			{
+				double b = 0, g = 0, r = 0;
+				for (int dy = 0; dy < 2; dy++)
+				{
+					for (int dx = 0; dx < 2; dx++)
+					{
+						const uint8_t *p = &src[(size_t)std::min(y + dy, height - 1) * stride + std::min(x + dx, width - 1) * 4];
+						b += p[0] / 4.0;
+						g += p[1] / 4.0;
+						r += p[2] / 4.0;
+					}
+				}
+				const size_t i = (size_t)(y / 2) * ((width + 1) / 2) + x / 2;
+				const double u = 128 - 0.148 * r - 0.291 * g + 0.439 * b;
+				const double v = 128 + 0.439 * r - 0.368 * g - 0.071 * b;
+				worstChroma = std::max(worstChroma, std::max(std::fabs(u - scalar.u[i]), std::fabs(v - scalar.v[i])));
+			}
+		}
+		EXPECT(worstLuma <= 2, "%dx%d: luma off by %.2f", width, height, worstLuma);
+		EXPECT(worstChroma <= 2, "%dx%d: chroma off by %.2f", width, height, worstChroma);
+
+		for (SwizzleKernel kernel : supportedKernels())
+		{
+			setActiveSwizzleKernel(kernel);
+			const I420 planes = toI420(src, stride, width, height);
+			EXPECT(planes.y == scalar.y && planes.u == scalar.u && planes.v == scalar.v,
+				   "%s, %dx%d: differs from scalar", getSwizzleKernelName(kernel), width, height);
+		}
+	}
+	setActiveSwizzleKernel(active);
+}
+
+static void testDiffPixels()
+{
+	const SwizzleKernel active = getActiveSwizzleKernel();
+	for (SwizzleKernel kernel : supportedKernels())
+	{
+		setActiveSwizzleKernel(kernel);
+		for (size_t count : {0, 1, 3, 4, 5, 16, 37, 1000})
+		{
+			for (int tolerance : {-1, 0, 3, 40, 255, 300})
+			{
+				const std::vector<uint8_t> expected = randomBytes(count * 4);
+				std::vector<uint8_t> actual = expected;
+				for (uint8_t &byte : actual)
+				{
+					// Mostly small differences, some large.
+					const int delta = rng() % 8 == 0 ? (int)(rng() % 511) - 255 : (int)(rng() % 9) - 4;
+					byte = (uint8_t)std::min(std::max(byte + delta, 0), 255);
+				}
+				std::vector<uint8_t> highlight(count * 4);
+				PixelDiffStats stats;
+				diffPixels(expected.data(), actual.data(), count, tolerance, highlight.data(), stats);
+
+				const int clamped = std::min(std::max(tolerance, 0), 255);
+				PixelDiffStats reference;
+				bool highlightOk = true;
+				for (size_t i = 0; i < count; i++)
+				{
+					bool differs = false;
+					for (int c = 0; c < 4; c++)
+					{
+						const int delta = std::abs(expected[i * 4 + c] - actual[i * 4 + c]);
+						reference.maxDelta = std::max(reference.maxDelta, delta);
+						reference.deltaSum += delta;
+						differs |= delta > clamped;
+					}
+					reference.differingPixels += differs;
+					for (int c = 0; c < 4; c++)
+					{
+						const int want = differs ? (c == 0 || c == 3 ? 255 : 0) : (actual[i * 4 + c] + 256) >> 1;
+						highlightOk &= highlight[i * 4 + c] == want;
+					}
+				}
+				EXPECT(stats.differingPixels == reference.differingPixels && stats.maxDelta == reference.maxDelta &&
+						   stats.deltaSum == reference.deltaSum,
+					   "%s, %zu pixels, tolerance %d: %llu/%d/%llu, expected %llu/%d/%llu", getSwizzleKernelName(kernel),
+					   count, tolerance, (unsigned long long)stats.differingPixels, stats.maxDelta,
+					   (unsigned long long)stats.deltaSum, (unsigned long long)reference.differingPixels,
+					   reference.maxDelta, (unsigned long long)reference.deltaSum);
+				EXPECT(highlightOk, "%s, %zu pixels, tolerance %d: highlight", getSwizzleKernelName(kernel), count, tolerance);
+
+				// Without a highlight, and added to existing stats.
+				PixelDiffStats twice;
+				diffPixels(expected.data(), actual.data(), count, tolerance, nullptr, twice);
+				diffPixels(expected.data(), actual.data(), count, tolerance, nullptr, twice);
+				EXPECT(twice.differingPixels == 2 * reference.differingPixels && twice.deltaSum == 2 * reference.deltaSum,
+					   "%s, %zu pixels: stats are not accumulated", getSwizzleKernelName(kernel), count);
+			}
+		}
+	}
+	setActiveSwizzleKernel(active);
+}
+
+static WebviewImage randomImage(int width, int height, bool opaque)
+{
+	WebviewImage image;
+	image.width = width;
+	image.height = height;
+	image.pixels = randomBytes((size_t)width * height * 4);
+	for (size_t i = 3; opaque && i < image.pixels.size(); i += 4)
+	{
+		image.pixels[i] = 0xff;
+	}
+	return image;
+}
+
+// Flat areas, gradients and repeats, which exercise runs, the index and
+// the LZ77 matches that noise does not.
+static WebviewImage patternImage(int width, int height, bool opaque)
+{
+	WebviewImage image;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize((size_t)width * height * 4);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			uint8_t *p = &image.pixels[((size_t)y * width + x) * 4];
+			p[0] = (uint8_t)(x < width / 3 ? 30 : x);
+			p[1] = (uint8_t)((x / 8 + y / 8) % 2 ? 200 : 20);
+			p[2] = (uint8_t)(y * 3);
+			p[3] = opaque ? 0xff : (uint8_t)(x % 3 == 0 ? 128 : 255);
+		}
+	}
+	return image;
+}
+
+static void testDiffImages(const std::string &outDir)
+{
+	WebviewImage expected = patternImage(97, 61, true);
+	WebviewImage actual = expected;
+	// A 10x5 block off by 30, and a single pixel off by 2.
+	for (int y = 20; y < 25; y++)
+	{
+		for (int x = 40; x < 50; x++)
+		{
+			uint8_t &green = actual.pixels[((size_t)y * actual.width + x) * 4 + 1];
+			green = green > 128 ? green - 30 : green + 30;
+		}
+	}
+	actual.pixels[(5 * actual.width + 5) * 4] += 2;
+
+	WebviewImageDiff same = diffImages(expected, expected, 0, false);
+	EXPECT(same.sameSize && same.differingPixels == 0 && same.maxDelta == 0 && same.meanDelta == 0, "identical images differ");
+
+	WebviewImageDiff diff = diffImages(expected, actual, 2, true);
+	EXPECT(diff.sameSize && diff.differingPixels == 50, "%llu differing pixels", (unsigned long long)diff.differingPixels);
+	EXPECT(diff.maxDelta == 30, "max delta %d", diff.maxDelta);
+	EXPECT(std::fabs(diff.meanDelta - (50 * 30 + 2) / (97.0 * 61 * 4)) < 1e-9, "mean delta %f", diff.meanDelta);
+	EXPECT(diff.highlight.width == actual.width && diff.highlight.height == actual.height, "highlight size");
+
+	const std::vector<uint8_t> png = encodePng(diff.highlight);
+	const std::string path = outDir + "/diff_images.diff.png";
+	EXPECT(writeFile(path, png), "cannot write %s", path.c_str());
+#ifdef WEBVIEW_TEST_ZLIB
+	WebviewImage written;
+	EXPECT(decodePng(png, written) && written.pixels == diff.highlight.pixels, "diff PNG does not decode to the highlight");
+#endif
+
+	WebviewImage smaller = patternImage(96, 61, true);
+	EXPECT(!diffImages(expected, smaller, 0, true).sameSize, "different sizes compared");
+}
+
+static void testEncoders()
+{
+	std::vector<WebviewImage> images;
+	for (bool opaque : {true, false})
+	{
+		images.push_back(randomImage(1, 1, opaque));
+		images.push_back(randomImage(13, 7, opaque));
+		images.push_back(patternImage(256, 100, opaque));
+		images.push_back(patternImage(1000, 3, opaque));
+		images.push_back(patternImage(3, 300, opaque));
+	}
+	for (const WebviewImage &image : images)
+	{
+		const bool opaque = isImageOpaque(image);
+		WebviewImage decoded;
+		const std::vector<uint8_t> qoi = encodeQoi(image);
+		EXPECT(qoi.size() > 12 && qoi[12] == (opaque ? 3 : 4), "%dx%d: QOI channels", image.width, image.height);
+		EXPECT(decodeQoi(qoi, decoded) && decoded.width == image.width && decoded.height == image.height &&
+				   decoded.pixels == image.pixels,
+			   "%dx%d (%s): QOI round trip", image.width, image.height, opaque ? "opaque" : "alpha");
+#ifdef WEBVIEW_TEST_ZLIB
+		decoded = WebviewImage();
+		EXPECT(decodePng(encodePng(image), decoded) && decoded.width == image.width && decoded.height == image.height &&
+				   decoded.pixels == image.pixels,
+			   "%dx%d (%s): PNG round trip", image.width, image.height, opaque ? "opaque" : "alpha");
+#endif
+	}
+	EXPECT(encodePng(WebviewImage()).empty() && encodeQoi(WebviewImage()).empty(), "empty images are encoded");
+}
+
+int main(int argc, char **argv)
+{
+	const std::string outDir = argc > 1 ? argv[1] : ".";
+	printf("Active swizzle kernel: %s\n", getSwizzleKernelName(getActiveSwizzleKernel()));
+	testSwizzle();
+	testHalveImage();
+	testConvertBgraToI420();
+	testDiffPixels();
+	testDiffImages(outDir);
+	testEncoders();
+	if (failures > 0)
+	{
+		fprintf(stderr, "%d failures\n", failures);
+		return 1;
+	}
+	printf("All image tests passed\n");
+	return 0;
+}
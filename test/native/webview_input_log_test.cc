@@ -0,0 +1,229 @@
+// Records every kind of input event with WebviewInputRecorder, reads the
+// log back with loadInputLog and checks that nothing changed on the way.
+// Also checks truncated and foreign files.
+
+#include "webview_input_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace webview_cef;
+
+static int failures = 0;
+
+#define EXPECT(condition, ...)                                           \
+	do                                                                   \
+	{                                                                    \
+		if (!(condition))                                                \
+		{                                                                \
+			failures++;                                                  \
+			fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #condition); \
+			fprintf(stderr, __VA_ARGS__);                                \
+			fprintf(stderr, "\n");                                       \
+		}                                                                \
+	} while (0)
+
+// The log stores records and key fields as they are, so the values of
+// WebviewPlugin::InputKind and of the CEF key types are spelled out here
+// instead of including the plugin and CEF.
+enum
+{
+	kInputMove = 0,
+	kInputDrag = 1,
+	kInputDown = 2,
+	kInputUp = 3,
+	kInputScroll = 4,
+	kInputTouchPressed = 5,
+	kInputTouchCancelled = 8,
+};
+enum
+{
+	kRawKeyDown = 0,
+	kKeyUp = 2,
+	kChar = 3,
+};
+static const uint32_t kShiftDown = 1 << 1;
+static const uint32_t kControlDown = 1 << 2;
+
+static WebviewInputEvent pointerEvent(int32_t kind, int32_t x, int32_t y, int32_t a, int32_t b)
+{
+	WebviewInputEvent event;
+	event.record[0] = kind;
+	event.record[1] = x;
+	event.record[2] = y;
+	event.record[3] = a;
+	event.record[4] = b;
+	return event;
+}
+
+static WebviewInputEvent keyEvent(int type, int code, char16_t character, uint32_t modifiers)
+{
+	WebviewInputEvent event;
+	event.record[0] = WebviewInputEvent::kKey;
+	event.key.type = type;
+	event.key.modifiers = modifiers;
+	event.key.windows_key_code = code;
+	event.key.native_key_code = code + 1000;
+	event.key.is_system_key = 1;
+	event.key.character = character;
+	event.key.unmodified_character = character + 1;
+	event.key.focus_on_editable_field = 1;
+	return event;
+}
+
+static WebviewInputEvent textEvent(int32_t kind, const std::string &text)
+{
+	WebviewInputEvent event;
+	event.record[0] = kind;
+	event.text = text;
+	return event;
+}
+
+static bool sameEvent(const WebviewInputEvent &a, const WebviewInputEvent &b)
+{
+	if (a.kind() != b.kind())
+	{
+		return false;
+	}
+	switch (a.kind())
+	{
+	case WebviewInputEvent::kKey:
+		return a.key.type == b.key.type && a.key.modifiers == b.key.modifiers &&
+			   a.key.windows_key_code == b.key.windows_key_code && a.key.native_key_code == b.key.native_key_code &&
+			   a.key.is_system_key == b.key.is_system_key && a.key.character == b.key.character &&
+			   a.key.unmodified_character == b.key.unmodified_character &&
+			   a.key.focus_on_editable_field == b.key.focus_on_editable_field;
+	case WebviewInputEvent::kImeComposition:
+	case WebviewInputEvent::kImeCommit:
+		return a.text == b.text;
+	default:
+		return memcmp(a.record, b.record, sizeof(a.record)) == 0;
+	}
+}
+
+static std::vector<WebviewInputEvent> sampleEvents()
+{
+	std::vector<WebviewInputEvent> events;
+	events.push_back(pointerEvent(kInputMove, 0, 0, 0, 0));
+	events.push_back(pointerEvent(kInputDown, 5, 7, 2, 0));
+	events.push_back(pointerEvent(kInputDrag, -30, -2000000000, 0, 0));
+	events.push_back(pointerEvent(kInputUp, 2147483647, 1, 1, 0));
+	events.push_back(pointerEvent(kInputScroll, 100, 200, 0, -120));
+	events.push_back(pointerEvent(kInputTouchPressed, 10, 20, 3, 1000));
+	events.push_back(pointerEvent(kInputTouchCancelled, 10, 20, 3, 0));
+	events.push_back(keyEvent(kRawKeyDown, 0x41, u'a', kShiftDown | kControlDown));
+	events.push_back(keyEvent(kChar, 0x4e2d, u'中', 0x80000000u));
+	events.push_back(keyEvent(kKeyUp, 0x41, 0, 0));
+	events.push_back(textEvent(WebviewInputEvent::kImeComposition, "zh\xc5\x8dng"));
+	events.push_back(textEvent(WebviewInputEvent::kImeCommit, "\xe4\xb8\xad\xe6\x96\x87"));
+	events.push_back(textEvent(WebviewInputEvent::kImeCommit, ""));
+	// Enough moves to go through several buffer flushes.
+	for (int i = 0; i < 3000; i++)
+	{
+		events.push_back(pointerEvent(kInputMove, i % 1920, i / 1920, 0, 0));
+	}
+	return events;
+}
+
+static long fileSize(const std::string &path)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+static void truncateFile(const std::string &path, long size)
+{
+	std::vector<char> data(size);
+	FILE *file = fopen(path.c_str(), "rb");
+	const size_t read = fread(data.data(), 1, data.size(), file);
+	fclose(file);
+	file = fopen(path.c_str(), "wb");
+	fwrite(data.data(), 1, read, file);
+	fclose(file);
+}
+
+static void testRoundTrip(const std::string &dir)
+{
+	const std::string path = dir + "/round_trip.wvinput";
+	const std::vector<WebviewInputEvent> events = sampleEvents();
+	const auto started = std::chrono::steady_clock::now();
+	{
+		WebviewInputRecorder recorder;
+		recorder.record(events[0]);
+		EXPECT(recorder.start(path), "cannot record to %s", path.c_str());
+		EXPECT(!recorder.start(path), "a recorder started twice");
+		for (const WebviewInputEvent &event : events)
+		{
+			recorder.record(event);
+		}
+		const WebviewInputRecorder::Stats stats = recorder.stop();
+		EXPECT(!stats.failed && stats.events == events.size(), "%llu events recorded", (unsigned long long)stats.events);
+		EXPECT((long)stats.bytes == fileSize(path), "%llu bytes reported, file has %ld",
+			   (unsigned long long)stats.bytes, fileSize(path));
+	}
+	const uint64_t elapsedUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+
+	std::vector<WebviewInputEvent> loaded;
+	EXPECT(loadInputLog(path, loaded), "cannot load %s", path.c_str());
+	EXPECT(loaded.size() == events.size(), "%zu of %zu events loaded", loaded.size(), events.size());
+	uint64_t previous = 0;
+	for (size_t i = 0; i < std::min(loaded.size(), events.size()); i++)
+	{
+		if (!sameEvent(events[i], loaded[i]))
+		{
+			EXPECT(false, "event %zu (kind %d) changed", i, events[i].kind());
+			break;
+		}
+		if (loaded[i].micros < previous || loaded[i].micros > elapsedUs)
+		{
+			EXPECT(false, "event %zu at %llu us, after %llu us, within %llu us", i, (unsigned long long)loaded[i].micros,
+				   (unsigned long long)previous, (unsigned long long)elapsedUs);
+			break;
+		}
+		previous = loaded[i].micros;
+	}
+
+	// A cut log yields the events before the cut.
+	truncateFile(path, fileSize(path) - 3);
+	EXPECT(loadInputLog(path, loaded), "cannot load a truncated log");
+	EXPECT(loaded.size() == events.size() - 1, "%zu events in a truncated log", loaded.size());
+	truncateFile(path, 8);
+	EXPECT(loadInputLog(path, loaded) && loaded.empty(), "%zu events in an empty log", loaded.size());
+	truncateFile(path, 5);
+	EXPECT(!loadInputLog(path, loaded), "a log without a full header loaded");
+
+	FILE *file = fopen(path.c_str(), "wb");
+	fputs("not an input log", file);
+	fclose(file);
+	EXPECT(!loadInputLog(path, loaded), "a foreign file loaded");
+	EXPECT(!loadInputLog(dir + "/missing.wvinput", loaded), "a missing file loaded");
+	remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <scratch dir>\n", argv[0]);
+		return 2;
+	}
+	testRoundTrip(argv[1]);
+	if (failures > 0)
+	{
+		fprintf(stderr, "%d failures\n", failures);
+		return 1;
+	}
+	printf("All input log tests passed\n");
+	return 0;
+}
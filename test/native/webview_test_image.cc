@@ -0,0 +1,247 @@
+#include "webview_test_image.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef WEBVIEW_TEST_ZLIB
+#include <zlib.h>
+#endif
+
+namespace webview_cef
+{
+	bool readFile(const std::string &path, std::vector<uint8_t> &data)
+	{
+		FILE *file = fopen(path.c_str(), "rb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		data.clear();
+		uint8_t chunk[4096];
+		size_t read = 0;
+		while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		{
+			data.insert(data.end(), chunk, chunk + read);
+		}
+		fclose(file);
+		return true;
+	}
+
+	bool writeFile(const std::string &path, const std::vector<uint8_t> &data)
+	{
+		FILE *file = fopen(path.c_str(), "wb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+		return fclose(file) == 0 && written;
+	}
+
+	static uint32_t getBigEndian(const uint8_t *p)
+	{
+		return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	}
+
+	bool decodeQoi(const std::vector<uint8_t> &qoi, WebviewImage &image)
+	{
+		static const uint8_t kEnd[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+		if (qoi.size() < 14 + sizeof(kEnd) || memcmp(qoi.data(), "qoif", 4) != 0 ||
+			memcmp(qoi.data() + qoi.size() - sizeof(kEnd), kEnd, sizeof(kEnd)) != 0)
+		{
+			return false;
+		}
+		image.width = (int)getBigEndian(qoi.data() + 4);
+		image.height = (int)getBigEndian(qoi.data() + 8);
+		if (image.width <= 0 || image.height <= 0 || (qoi[12] != 3 && qoi[12] != 4))
+		{
+			return false;
+		}
+		const size_t count = (size_t)image.width * image.height;
+		image.pixels.resize(count * 4);
+
+		uint8_t index[64][4];
+		memset(index, 0, sizeof(index));
+		uint8_t px[4] = {0, 0, 0, 255};
+		size_t pos = 14;
+		const size_t end = qoi.size() - sizeof(kEnd);
+		int run = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (run > 0)
+			{
+				run--;
+			}
+			else
+			{
+				if (pos >= end)
+				{
+					return false;
+				}
+				const uint8_t op = qoi[pos++];
+				if (op == 0xfe || op == 0xff)
+				{
+					const size_t channels = op == 0xfe ? 3 : 4;
+					if (end - pos < channels)
+					{
+						return false;
+					}
+					memcpy(px, &qoi[pos], channels);
+					pos += channels;
+				}
+				else if ((op & 0xc0) == 0x00)
+				{
+					memcpy(px, index[op], 4);
+				}
+				else if ((op & 0xc0) == 0x40)
+				{
+					px[0] += ((op >> 4) & 3) - 2;
+					px[1] += ((op >> 2) & 3) - 2;
+					px[2] += (op & 3) - 2;
+				}
+				else if ((op & 0xc0) == 0x80)
+				{
+					if (pos >= end)
+					{
+						return false;
+					}
+					const int dg = (op & 0x3f) - 32;
+					const uint8_t next = qoi[pos++];
+					px[0] += dg + (next >> 4) - 8;
+					px[1] += dg;
+					px[2] += dg + (next & 0x0f) - 8;
+				}
+				else
+				{
+					run = op & 0x3f;
+				}
+				memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+			}
+			memcpy(&image.pixels[i * 4], px, 4);
+		}
+		return true;
+	}
+
+	bool loadQoiFile(const std::string &path, WebviewImage &image)
+	{
+		std::vector<uint8_t> data;
+		return readFile(path, data) && decodeQoi(data, image);
+	}
+
+#ifdef WEBVIEW_TEST_ZLIB
+	static int paeth(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = std::abs(p - a);
+		const int pb = std::abs(p - b);
+		const int pc = std::abs(p - c);
+		return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+	}
+
+	bool decodePng(const std::vector<uint8_t> &png, WebviewImage &image)
+	{
+		static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		if (png.size() < sizeof(kSignature) || memcmp(png.data(), kSignature, sizeof(kSignature)) != 0)
+		{
+			return false;
+		}
+		int channels = 0;
+		std::vector<uint8_t> compressed;
+		bool ended = false;
+		for (size_t pos = sizeof(kSignature); pos + 12 <= png.size() && !ended;)
+		{
+			const uint32_t length = getBigEndian(&png[pos]);
+			if (png.size() - pos - 12 < length)
+			{
+				return false;
+			}
+			const uint8_t *type = &png[pos + 4];
+			const uint8_t *data = type + 4;
+			if (crc32(crc32(0, nullptr, 0), type, length + 4) != getBigEndian(data + length))
+			{
+				return false;
+			}
+			if (memcmp(type, "IHDR", 4) == 0 && length == 13)
+			{
+				image.width = (int)getBigEndian(data);
+				image.height = (int)getBigEndian(data + 4);
+				if (data[8] != 8 || (data[9] != 2 && data[9] != 6) || data[12] != 0)
+				{
+					return false;
+				}
+				channels = data[9] == 6 ? 4 : 3;
+			}
+			else if (memcmp(type, "IDAT", 4) == 0)
+			{
+				compressed.insert(compressed.end(), data, data + length);
+			}
+			else if (memcmp(type, "IEND", 4) == 0)
+			{
+				ended = true;
+			}
+			pos += 12 + length;
+		}
+		if (!ended || channels == 0 || image.width <= 0 || image.height <= 0)
+		{
+			return false;
+		}
+
+		const size_t rowBytes = (size_t)image.width * channels;
+		std::vector<uint8_t> filtered((rowBytes + 1) * image.height);
+		uLongf filteredSize = (uLongf)filtered.size();
+		if (uncompress(filtered.data(), &filteredSize, compressed.data(), (uLong)compressed.size()) != Z_OK ||
+			filteredSize != filtered.size())
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> raw(rowBytes * image.height);
+		for (int y = 0; y < image.height; y++)
+		{
+			const uint8_t filter = filtered[y * (rowBytes + 1)];
+			const uint8_t *in = &filtered[y * (rowBytes + 1) + 1];
+			uint8_t *out = &raw[y * rowBytes];
+			const uint8_t *up = y > 0 ? out - rowBytes : nullptr;
+			for (size_t x = 0; x < rowBytes; x++)
+			{
+				const int a = x >= (size_t)channels ? out[x - channels] : 0;
+				const int b = up != nullptr ? up[x] : 0;
+				const int c = up != nullptr && x >= (size_t)channels ? up[x - channels] : 0;
+				int predictor = 0;
+				switch (filter)
+				{
+				case 0:
+					break;
+				case 1:
+					predictor = a;
+					break;
+				case 2:
+					predictor = b;
+					break;
+				case 3:
+					predictor = (a + b) >> 1;
+					break;
+				case 4:
+					predictor = paeth(a, b, c);
+					break;
+				default:
+					return false;
+				}
+				out[x] = (uint8_t)(in[x] + predictor);
+			}
+		}
+
+		image.pixels.resize((size_t)image.width * image.height * 4);
+		for (size_t i = 0; i < (size_t)image.width * image.height; i++)
+		{
+			memcpy(&image.pixels[i * 4], &raw[i * channels], channels);
+			if (channels == 3)
+			{
+				image.pixels[i * 4 + 3] = 0xff;
+			}
+		}
+		return true;
+	}
+#endif
+}
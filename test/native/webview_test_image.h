@@ -0,0 +1,25 @@
+#ifndef WEBVIEW_TEST_IMAGE_H
+#define WEBVIEW_TEST_IMAGE_H
+
+#include "webview_image.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace webview_cef {
+    bool readFile(const std::string& path, std::vector<uint8_t>& data);
+    bool writeFile(const std::string& path, const std::vector<uint8_t>& data);
+
+    // Decodes a QOI image (the format of the goldens) into RGBA pixels.
+    bool decodeQoi(const std::vector<uint8_t>& qoi, WebviewImage& image);
+    bool loadQoiFile(const std::string& path, WebviewImage& image);
+
+#ifdef WEBVIEW_TEST_ZLIB
+    // Decodes the 8-bit RGB and RGBA PNGs encodePng writes, checking chunk
+    // CRCs and the zlib stream.
+    bool decodePng(const std::vector<uint8_t>& png, WebviewImage& image);
+#endif
+}
+
+#endif //WEBVIEW_TEST_IMAGE_H
@@ -1,5 +1,6 @@
 ﻿#include "webview_cef_plugin.h"
 #include "webview_cef_keyevent.h"
+#include "webview_frame_pool.h"
 // This must be included before many other Windows headers.
 #include <windows.h>
 
@@ -14,7 +15,6 @@
 #include <memory>
 #include <thread>
 #include <iostream>
-#include <mutex>
 
 namespace webview_cef {
 	class WebviewTextureRenderer : public WebviewTexture{
@@ -36,42 +36,39 @@ namespace webview_cef {
 		}
 
 		virtual ~WebviewTextureRenderer() {
-			std::lock_guard<std::mutex> autolock(mutex_);
 			if(registrar_){
 				// FlutterDesktopTextureRegistrarUnregisterExternalTexture(registrar_, textureId, nullptr, nullptr);
 			}
 		}
 
+		// Runs on the raster thread. The pool hands over the newest surface
+		// without blocking onFrame.
 		const FlutterDesktopPixelBuffer *CopyPixelBuffer(size_t width, size_t height) const{
-			std::lock_guard<std::mutex> autolock(mutex_);
-    		return pixel_buffer.get();
-		}
-
-		virtual void onFrame(const void* buffer, int width, int height) override{
-			const std::lock_guard<std::mutex> autolock(mutex_);
-			if (!pixel_buffer.get() || pixel_buffer.get()->width != width || pixel_buffer.get()->height != height) {
-				if (!pixel_buffer.get()) {
-					pixel_buffer = std::make_unique<FlutterDesktopPixelBuffer>();
-					pixel_buffer->release_context = nullptr;
-				}
-				pixel_buffer->width = width;
-				pixel_buffer->height = height;
-				const auto size = width * height * 4;
-				backing_pixel_buffer.reset(new uint8_t[size]);
-				pixel_buffer->buffer = backing_pixel_buffer.get();
+			const WebviewFramePool::Surface* surface = pool_.consume();
+			if (!surface) {
+				return nullptr;
 			}
+			pixel_buffer_.buffer = surface->pixels.data();
+			pixel_buffer_.width = surface->width;
+			pixel_buffer_.height = surface->height;
+			pixel_buffer_.release_context = nullptr;
+			return &pixel_buffer_;
+		}
 
-			SwapBufferFromBgraToRgba((void*)pixel_buffer->buffer, buffer, width, height);
-			if(registrar_){
+		virtual void onFrame(const WebviewFrame& frame) override{
+			if(pool_.produce(frame) && registrar_){
 				FlutterDesktopTextureRegistrarMarkExternalTextureFrameAvailable(registrar_, textureId);
 			}
 		}
 
+		virtual WebviewFramePool* framePool() override{
+			return &pool_;
+		}
+
 		FlutterDesktopTextureRegistrarRef registrar_;
 		std::unique_ptr<flutter::TextureVariant> texture;
-		mutable std::shared_ptr<FlutterDesktopPixelBuffer> pixel_buffer;
-		std::unique_ptr<uint8_t> backing_pixel_buffer;
-		mutable std::mutex mutex_;
+		mutable WebviewFramePool pool_;
+		mutable FlutterDesktopPixelBuffer pixel_buffer_ = {};
 	};
 
 	static flutter::EncodableValue encode_wvalue_to_flvalue(WValue* args) {
@@ -88,15 +85,30 @@ namespace webview_cef {
 			case Webview_Value_Type_String:
 				return flutter::EncodableValue(webview_value_get_string(args));
 			case Webview_Value_Type_Uint8_List:
-				return flutter::EncodableValue(webview_value_get_uint8_list(args));
+			{
+				const uint8_t *list = webview_value_get_uint8_list(args);
+				return flutter::EncodableValue(std::vector<uint8_t>(list, list + webview_value_get_len(args)));
+			}
 			case Webview_Value_Type_Int32_List:
-				return flutter::EncodableValue(webview_value_get_int32_list(args));
+			{
+				const int32_t *list = webview_value_get_int32_list(args);
+				return flutter::EncodableValue(std::vector<int32_t>(list, list + webview_value_get_len(args)));
+			}
 			case Webview_Value_Type_Int64_List:
-				return flutter::EncodableValue(webview_value_get_int64_list(args));
+			{
+				const int64_t *list = webview_value_get_int64_list(args);
+				return flutter::EncodableValue(std::vector<int64_t>(list, list + webview_value_get_len(args)));
+			}
 			case Webview_Value_Type_Float_List:
-				return flutter::EncodableValue(webview_value_get_float_list(args));
+			{
+				const float *list = webview_value_get_float_list(args);
+				return flutter::EncodableValue(std::vector<float>(list, list + webview_value_get_len(args)));
+			}
 			case Webview_Value_Type_Double_List:
-				return flutter::EncodableValue(webview_value_get_double_list(args));
+			{
+				const double *list = webview_value_get_double_list(args);
+				return flutter::EncodableValue(std::vector<double>(list, list + webview_value_get_len(args)));
+			}
 			case Webview_Value_Type_List:
 			{
 				flutter::EncodableList ret;
@@ -214,6 +226,12 @@ namespace webview_cef {
 			PostMessage(plugin_pointer->m_hwnd, WM_USER + 1, WPARAM(methodValue), LPARAM(args));
 			});
 
+		// CEF runs its own UI thread here, so method results produced off the
+		// platform thread come back through the window's message loop.
+		plugin->m_plugin->setPostTaskFunc([plugin_pointer = plugin.get()](std::function<void()> task) {
+			PostMessage(plugin_pointer->m_hwnd, WM_USER + 2, 0, LPARAM(new std::function<void()>(std::move(task))));
+			});
+
 		plugin->m_plugin->setCreateTextureFunc([plugin_pointer = plugin.get()]() {
 			std::shared_ptr<WebviewTextureRenderer> renderer = std::make_shared<WebviewTextureRenderer>(plugin_pointer->m_textureRegistrar);
 			return std::dynamic_pointer_cast<WebviewTexture>(renderer);
@@ -264,6 +282,17 @@ namespace webview_cef {
 			}
 			break;
 		}
+		case WM_USER + 2:
+		{
+			std::function<void()> *task = (std::function<void()> *)lparam;
+			if (webviewPlugins.find(hwnd) != webviewPlugins.end()) {
+				(*task)();
+			}
+			// A method result in a task dropped here fails its call as the
+			// task is deleted (see WebviewPlugin::postResult).
+			delete task;
+			break;
+		}
 		case WM_SYSCHAR:
 		case WM_SYSKEYDOWN:
 		case WM_SYSKEYUP: